@@ -13,6 +13,7 @@
 #pragma once
 
 #include <nanogui/widget.h>
+#include <nanogui/theme.h>
 
 NAMESPACE_BEGIN(nanogui)
 /**
@@ -90,6 +91,9 @@ protected:
     std::function<void()> mCallback;
     std::function<void(bool)> mChangeCallback;
     std::vector<Button *> mButtonGroup;
+    /// Keeps a cached image icon resident while the button shows it
+    ImageCache::Handle mIconHandle;
+    ChromeCache mChrome;
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
@@ -22,6 +22,11 @@ NAMESPACE_BEGIN(nanogui)
  * \class ColorWheel colorwheel.h nanogui/colorwheel.h
  *
  * \brief Fancy analog widget to select a color value.
+ *
+ * The hue ring and the triangle are rasterized on the CPU into a texture
+ * that is only regenerated when the size or the hue changes; the ring itself
+ * is kept separately so that changing the hue only redraws the triangle.
+ * Each frame then just draws this texture and the selection markers.
  */
 class NANOGUI_EXPORT ColorWheel : public Widget {
 public:
@@ -56,13 +61,25 @@ private:
 
     Color hue2rgb(float h) const;
     Region adjustPosition(const Vector2i &p, Region consideredRegions = Both);
+    void updateImage(NVGcontext *ctx, float pixelRatio);
 
 protected:
+    virtual ~ColorWheel();
+
     float mHue;
     float mWhite;
     float mBlack;
     Region mDragRegion;
     std::function<void(const Color &)> mCallback;
+
+    /// Cached rendering of the wheel (see \ref updateImage())
+    NVGcontext *mContext = nullptr;
+    /// Token of the image cache of \c mContext (see \ref ImageCache::token())
+    uint64_t mContextToken = 0;
+    int mImage = 0;
+    int mImageExtent = 0;
+    float mImageRatio = 0.f, mImageHue = 0.f;
+    std::vector<uint8_t> mRing, mPixels;
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
@@ -0,0 +1,92 @@
+/*
+    nanogui/commandqueue.h -- Lock-free queue used to marshal work from
+    arbitrary threads onto the GUI thread
+
+    NanoGUI was developed by Wenzel Jakob <wenzel.jakob@epfl.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+/** \file */
+
+#pragma once
+
+#include <nanogui/common.h>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \class CommandQueue commandqueue.h nanogui/commandqueue.h
+ *
+ * \brief Lock-free multiple-producer, single-consumer queue of commands.
+ *
+ * Any thread may push commands, while \ref process() must only be called by
+ * the thread that owns the widgets (usually the GLFW thread). Commands that
+ * are pushed with a target supersede all pending commands with the same
+ * target and slot, so that only the latest update of a widget is executed.
+ *
+ * Superseded commands are only discarded by \ref process(), so every push
+ * still allocates a node and stores its command until then. Producers that
+ * update a widget much faster than the frame rate should use
+ * \ref Screen::postUpdate(), which only replaces the value of a pending
+ * update.
+ */
+class NANOGUI_EXPORT CommandQueue {
+public:
+    typedef std::function<void()> Command;
+
+    CommandQueue() : mHead(nullptr) { }
+    ~CommandQueue();
+
+    /**
+     * Append a command to the queue. Thread safe.
+     *
+     * \return \c true if the queue was empty before, i.e. the consumer may
+     *         have to be woken up.
+     */
+    bool push(Command command) { return push(nullptr, 0, std::move(command)); }
+
+    /**
+     * Append a command that supersedes any pending command with the same
+     * \c target and \c slot. Thread safe.
+     *
+     * \return \c true if the queue was empty before.
+     */
+    bool push(const void *target, int slot, Command command);
+
+    /// Execute all pending commands in submission order, returns their number
+    size_t process();
+
+    /// Check if there are pending commands
+    bool empty() const { return mHead.load(std::memory_order_relaxed) == nullptr; }
+
+    CommandQueue(const CommandQueue &) = delete;
+    CommandQueue &operator=(const CommandQueue &) = delete;
+
+protected:
+    struct Node {
+        Node *next;
+        const void *target;
+        int slot;
+        Command command;
+    };
+
+    struct Key {
+        const void *target;
+        int slot;
+        size_t index;
+    };
+
+    std::atomic<Node *> mHead;
+
+    // Scratch space of the consumer, reused across calls to process().
+    std::vector<Node *> mBatch;
+    std::vector<Key> mKeys;
+};
+
+NAMESPACE_END(nanogui)
@@ -422,14 +422,20 @@ class CheckBox;
 class ColorWheel;
 class ColorPicker;
 class ComboBox;
+class CommandQueue;
+class EventRecorder;
 class GLFramebuffer;
 class GLShader;
 class GridLayout;
 class GroupLayout;
+class ImageAtlas;
+class ImageCache;
+class ImageLoader;
 class ImagePanel;
 class ImageView;
 class Label;
 class Layout;
+class LODGraph;
 class MessageDialog;
 class Object;
 class Popup;
@@ -511,6 +517,24 @@ extern NANOGUI_EXPORT void leave();
 /// Return whether or not a main loop is currently active
 extern NANOGUI_EXPORT bool active();
 
+/**
+ * \brief Draw multiple screens in parallel within \ref mainloop()
+ *
+ * Input, queued commands and window queries are still processed on the main
+ * thread, after which the OpenGL context of every visible screen is made
+ * current on a worker thread that draws its contents and widgets. The buffer
+ * swaps are then issued in sequence on the main thread. Overrides of
+ * \ref Screen::drawAll() are still called on the main thread, but the base
+ * implementation only prepares the frame in this mode, so code that follows
+ * it runs before the screen is rendered and must not draw (overrides that
+ * do are caught by an assertion in debug builds). \ref Screen::drawContents()
+ * must not depend on the calling thread.
+ */
+extern NANOGUI_EXPORT void setParallelDrawing(bool parallel);
+
+/// Return whether \ref mainloop() draws multiple screens in parallel
+extern NANOGUI_EXPORT bool parallelDrawing();
+
 /**
  * \brief Open a native file open/save dialog.
  *
@@ -549,13 +573,28 @@ extern NANOGUI_EXPORT void chdir_to_bundle_parent();
  */
 extern NANOGUI_EXPORT std::array<char, 8> utf8(int c);
 
+/// Return the paths of the PNG images (by their ".png" suffix, ignoring case) in a directory
+extern NANOGUI_EXPORT std::vector<std::string> listImageDirectory(const std::string &path);
+
 /// Load a directory of PNG images and upload them to the GPU (suitable for use with ImagePanel)
 extern NANOGUI_EXPORT std::vector<std::pair<int, std::string>>
     loadImageDirectory(NVGcontext *ctx, const std::string &path);
 
 /// Convenience function for instanting a PNG icon from the application's data segment (via bin2c)
 #define nvgImageIcon(ctx, name) nanogui::__nanogui_get_image(ctx, #name, name##_png, name##_png_size)
-/// Helper function used by nvgImageIcon
-extern NANOGUI_EXPORT int __nanogui_get_image(NVGcontext *ctx, const std::string &name, uint8_t *data, uint32_t size);
+
+/**
+ * \brief Like \ref nvgImageIcon, but packs small icons into the \ref ImageAtlas
+ * of the context
+ *
+ * Icons that share an atlas page are drawn without switching textures. The
+ * result may be an atlas icon, which must be drawn using \ref nvgIconPattern()
+ * and \ref nvgIconSize().
+ */
+#define nvgAtlasIcon(ctx, name) nanogui::__nanogui_get_image(ctx, #name, name##_png, name##_png_size, true)
+
+/// Helper function used by nvgImageIcon and nvgAtlasIcon
+extern NANOGUI_EXPORT int __nanogui_get_image(NVGcontext *ctx, const std::string &name, uint8_t *data,
+                                              uint32_t size, bool pack = false);
 
 NAMESPACE_END(nanogui)
@@ -0,0 +1,35 @@
+/*
+    nanogui/drawbatcher.h -- Merges the draw calls of a NanoVG context
+    before they reach its backend
+
+    NanoGUI was developed by Wenzel Jakob <wenzel.jakob@epfl.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+/** \file */
+
+#pragma once
+
+#include <nanogui/common.h>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Enable or disable draw call batching for a NanoVG context
+ *
+ * The first call wraps the render callbacks of the context's backend
+ * (see \c nvgInternalParams()), so it should be made right after the
+ * context is created. While batching is enabled, text and fills of
+ * rectangles that lie on the pixel grid are turned into textured triangles,
+ * clipped to the scissor on the CPU, and queued instead of being passed on.
+ * Queued triangles that share an image, a color and a blend state are sent
+ * as a single call, which may be moved ahead of earlier calls it does not
+ * overlap. Everything else is forwarded unchanged, so the rendered pixels
+ * do not change. \ref Screen enables batching for its OpenGL context.
+ */
+extern NANOGUI_EXPORT void nvgSetBatching(NVGcontext *ctx, bool enabled);
+
+NAMESPACE_END(nanogui)
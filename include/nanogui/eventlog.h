@@ -0,0 +1,108 @@
+/*
+    nanogui/eventlog.h -- Recording and deterministic replay of the raw
+    input received by a Screen
+
+    NanoGUI was developed by Wenzel Jakob <wenzel.jakob@epfl.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+/** \file */
+
+#pragma once
+
+#include <nanogui/common.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+NAMESPACE_BEGIN(nanogui)
+
+/// Types of the records stored in an event log
+enum class EventType : uint8_t {
+    CursorPos = 0,
+    MouseButton,
+    Key,
+    Char,
+    Drop,
+    Scroll,
+    Resize,
+    Frame
+};
+
+/**
+ * \class EventRecorder eventlog.h nanogui/eventlog.h
+ *
+ * \brief Serializes the timestamped raw input of a \ref Screen to a compact
+ * binary log. Attach it using \ref Screen::setEventRecorder().
+ */
+class NANOGUI_EXPORT EventRecorder {
+public:
+    /// Create a new log file, throws \c std::runtime_error on failure
+    EventRecorder(const std::string &filename);
+    ~EventRecorder();
+
+    void cursorPos(double time, double x, double y);
+    void mouseButton(double time, int button, int action, int modifiers);
+    void key(double time, int key, int scancode, int action, int mods);
+    void character(double time, unsigned int codepoint);
+    void drop(double time, int count, const char **filenames);
+    void scroll(double time, double x, double y);
+    void resize(double time, int width, int height);
+    /// Mark the end of a frame, so that the replay draws at the same points
+    void frame(double time);
+
+    /// Number of records written so far
+    size_t recordCount() const { return mRecordCount; }
+
+    EventRecorder(const EventRecorder &) = delete;
+    EventRecorder &operator=(const EventRecorder &) = delete;
+
+protected:
+    void begin(EventType type, double time);
+    template <typename T> void write(T value) { fwrite(&value, sizeof(T), 1, mFile); }
+
+    FILE *mFile;
+    double mLastTime = 0;
+    size_t mRecordCount = 0;
+};
+
+/// Timing results of \ref EventReplayer::replay()
+struct NANOGUI_EXPORT ReplayStats {
+    /// Dispatch time of every replayed input event in seconds
+    std::vector<double> eventLatency;
+    /// Time spent in \ref Screen::drawAll() for every replayed frame in seconds
+    std::vector<double> frameTime;
+    /// Wall clock time of the whole replay in seconds
+    double totalTime = 0;
+
+    /// Return a human readable summary (count, mean, 95th percentile, maximum)
+    std::string summary() const;
+};
+
+/**
+ * \class EventReplayer eventlog.h nanogui/eventlog.h
+ *
+ * \brief Drives a \ref Screen with the input stored in a log written by
+ * \ref EventRecorder. The screen runs on a virtual clock that follows the
+ * recorded timestamps, while events are dispatched as fast as possible.
+ */
+class NANOGUI_EXPORT EventReplayer {
+public:
+    /// Load a log file, throws \c std::runtime_error on failure
+    EventReplayer(const std::string &filename);
+
+    /// Replay the log, optionally drawing a frame wherever one was recorded
+    ReplayStats replay(Screen *screen, bool drawFrames = true) const;
+
+    /// Number of records in the log
+    size_t recordCount() const { return mRecordCount; }
+
+protected:
+    std::vector<uint8_t> mData;
+    size_t mRecordCount = 0;
+};
+
+NAMESPACE_END(nanogui)
@@ -386,10 +386,15 @@ public:
 class NANOGUI_EXPORT GLFramebuffer {
 public:
     /// Default constructor: unusable until you call the ``init()`` method
-    GLFramebuffer() : mFramebuffer(0), mDepth(0), mColor(0), mSamples(0) { }
+    GLFramebuffer() : mFramebuffer(0), mDepth(0), mColor(0), mTexture(0), mSamples(0) { }
 
-    /// Create a new framebuffer with the specified size and number of MSAA samples
-    void init(const Vector2i &size, int nSamples);
+    /**
+     * Create a new framebuffer with the specified size and number of MSAA
+     * samples. When \c texture is set, colors are rendered into a texture
+     * that can be sampled afterwards (see \ref texture()), which requires
+     * <tt>nSamples <= 1</tt>.
+     */
+    void init(const Vector2i &size, int nSamples, bool texture = false);
 
     /// Release all associated resources
     void free();
@@ -409,10 +414,16 @@ public:
     /// Return the number of MSAA samples
     int samples() const { return mSamples; }
 
+    /// Return the size in pixels
+    const Vector2i &size() const { return mSize; }
+
+    /// Return the color texture, or 0 if colors are stored in a renderbuffer
+    GLuint texture() const { return mTexture; }
+
     /// Quick and dirty method to write a TGA (32bpp RGBA) file of the framebuffer contents for debugging
     void downloadTGA(const std::string &filename);
 protected:
-    GLuint mFramebuffer, mDepth, mColor;
+    GLuint mFramebuffer, mDepth, mColor, mTexture;
     Vector2i mSize;
     int mSamples;
 public:
@@ -655,4 +666,14 @@ extern NANOGUI_EXPORT Matrix4f scale(const Vector3f &v);
  */
 extern NANOGUI_EXPORT Matrix4f translate(const Vector3f &v);
 
+/**
+ * \brief Wrap an existing OpenGL texture as an image of a NanoVG context
+ *
+ * The image is created by the OpenGL backend that \ref Screen uses, so
+ * \c ctx must be a screen context. Deleting the image leaves the texture
+ * intact, which remains owned by the caller.
+ */
+extern NANOGUI_EXPORT int nvgCreateImageFromTexture(NVGcontext *ctx, GLuint texture,
+                                                    int width, int height, int imageFlags);
+
 NAMESPACE_END(nanogui)
@@ -13,6 +13,9 @@
 #pragma once
 
 #include <nanogui/widget.h>
+#include <nanogui/glutil.h>
+#include <atomic>
+#include <memory>
 
 NAMESPACE_BEGIN(nanogui)
 
@@ -24,6 +27,7 @@ NAMESPACE_BEGIN(nanogui)
 class NANOGUI_EXPORT Graph : public Widget {
 public:
     Graph(Widget *parent, const std::string &caption = "Untitled");
+    ~Graph();
 
     const std::string &caption() const { return mCaption; }
     void setCaption(const std::string &caption) { mCaption = caption; }
@@ -47,15 +51,98 @@ public:
     VectorXf &values() { return mValues; }
     void setValues(const VectorXf &values) { mValues = values; }
 
+    /**
+     * Add a streaming series that shows the latest \c capacity samples and
+     * return its index. Series should be added before producers start
+     * pushing samples.
+     */
+    int addSeries(size_t capacity, const Color &color);
+
+    /// Remove all streaming series
+    void clearSeries() { mSeries.clear(); }
+
+    /// Return the number of streaming series
+    int seriesCount() const { return (int) mSeries.size(); }
+
+    /// Set the range of values that is mapped to the height of the graph (default: [0, 1])
+    void setSeriesRange(int series, float min, float max);
+
+    /// Return the number of samples currently shown by a series
+    size_t seriesSize(int series) const;
+
+    /**
+     * Append a sample to a series in O(1). Lock-free and safe to call from one
+     * producer thread per series while the graph is being drawn.
+     */
+    void push(int series, float value) {
+        Series &s = *mSeries[series];
+        uint64_t index = s.written.load(std::memory_order_relaxed);
+        s.data[index % s.bufferSize].store(value, std::memory_order_relaxed);
+        s.written.store(index + 1, std::memory_order_release);
+    }
+
+    /// Append several samples to a series, see \ref push(int, float)
+    void push(int series, const float *values, size_t count);
+
+    /// Are the values and series drawn using OpenGL shaders instead of NanoVG paths?
+    bool gpuAccelerated() const { return mGPUAccelerated; }
+
+    /**
+     * Draw the values and series using OpenGL shaders. The samples are
+     * uploaded to buffer objects (streaming series only upload new samples)
+     * and lines and areas are expanded in the vertex shader, which avoids
+     * tessellating large series on the CPU. Falls back to NanoVG paths when
+     * texture buffers are unavailable (e.g. OpenGL 2 / GLES 2 builds).
+     */
+    void setGPUAccelerated(bool gpuAccelerated) { mGPUAccelerated = gpuAccelerated; }
+
     virtual Vector2i preferredSize(NVGcontext *ctx) const override;
     virtual void draw(NVGcontext *ctx) override;
 
     virtual void save(Serializer &s) const override;
     virtual bool load(Serializer &s) override;
 protected:
+    /// Is there any data to plot? Otherwise only the background is drawn
+    virtual bool hasPlot() const { return mValues.size() >= 2 || !mSeries.empty(); }
+
+    /// Draw the plotted data between the background and the labels
+    virtual void drawPlot(NVGcontext *ctx);
+
+    /// Draw the values and series with OpenGL, returns \c false if unsupported
+    bool drawPlotGPU(NVGcontext *ctx);
+
     std::string mCaption, mHeader, mFooter;
     Color mBackgroundColor, mForegroundColor, mTextColor;
     VectorXf mValues;
+
+    /// Ring buffer of a streaming series (single producer, single consumer)
+    struct Series {
+        Series(size_t capacity, const Color &color);
+
+        /* The buffer is larger than the visible window, so that the producer
+           can keep writing while a frame reads the window */
+        size_t capacity, bufferSize;
+        std::unique_ptr<std::atomic<float>[]> data;
+        std::atomic<uint64_t> written;
+        Color color;
+        float min = 0.f, max = 1.f;
+    };
+
+    std::vector<std::unique_ptr<Series>> mSeries;
+
+    /// Texture buffer holding the samples of the values (index 0) or of a series
+    struct GPUBuffer {
+        const void *owner = nullptr;
+        GLuint buffer = 0, texture = 0;
+        size_t size = 0;
+        uint64_t uploaded = 0;
+    };
+
+    bool mGPUAccelerated = false;
+    GLShader mPlotShader;
+    /// Size limit of texture buffers, queried on first use
+    int mMaxGPUSamples = 0;
+    std::vector<GPUBuffer> mGPUBuffers;
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
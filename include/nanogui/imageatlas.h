@@ -0,0 +1,110 @@
+/*
+    nanogui/imageatlas.h -- Packs small images into shared NanoVG textures
+
+    NanoGUI was developed by Wenzel Jakob <wenzel.jakob@epfl.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+/** \file */
+
+#pragma once
+
+#include <nanogui/common.h>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \class ImageAtlas imageatlas.h nanogui/imageatlas.h
+ *
+ * \brief Packs small RGBA images into a few large textures ("pages").
+ *
+ * NanoVG starts a new draw call whenever the image of consecutive fills
+ * changes, so icons that share a page are drawn together. Every packed image
+ * is identified by a negative icon ID (see \ref nvgIsAtlasIcon()), which
+ * \ref nvgIconSize() and \ref nvgIconPattern() resolve to its page and
+ * rectangle. Images are placed with a skyline packer and surrounded by a
+ * one pixel border that repeats their edge, so that filtering never picks up
+ * a neighbor. The space of released images is reclaimed once all images of
+ * their page have been released, at which point the page is deleted.
+ *
+ * The atlas of a context is owned by its \ref ImageCache, see
+ * \ref ImageCache::atlas().
+ */
+class NANOGUI_EXPORT ImageAtlas {
+public:
+    ImageAtlas(NVGcontext *ctx, int pageSize = 1024, int maxImageSize = 256);
+    ~ImageAtlas();
+
+    /// Pack an image and return its icon ID, or 0 if it is too large
+    int add(const uint8_t *rgba, int width, int height);
+
+    /// Free the space of an image
+    void release(int icon);
+
+    /// Is the icon a live image of this atlas?
+    bool contains(int icon) const;
+
+    /// Return the page texture and pixel rectangle (x, y, width, height) of an icon
+    bool lookup(int icon, int &image, Vector4i &rect) const;
+
+    /// Upload the parts of the pages that changed since the last call
+    void flush();
+
+    int pageSize() const { return mPageSize; }
+    int maxImageSize() const { return mMaxImageSize; }
+
+    /// Return the number of allocated pages
+    size_t pageCount() const;
+
+    ImageAtlas(const ImageAtlas &) = delete;
+    ImageAtlas &operator=(const ImageAtlas &) = delete;
+
+private:
+    struct Page {
+        /// Texture of the page, or 0 if the page was deleted and its slot is unused
+        int image;
+        std::vector<uint8_t> pixels;
+        /// Skyline segments: x position, width and height
+        std::vector<Vector3i> skyline;
+        size_t liveCount = 0;
+        /// Pixel rectangle [min, max) that changed since the last upload
+        Vector2i dirtyMin, dirtyMax;
+        bool dirty = false;
+    };
+
+    struct Entry {
+        int page, x, y, width, height;
+        bool live;
+    };
+
+    bool place(Page &page, int width, int height, Vector2i &pos);
+    void reset(Page &page);
+
+    NVGcontext *mContext;
+    int mPageSize, mMaxImageSize;
+    std::vector<Page> mPages;
+    std::vector<Entry> mEntries;
+    std::vector<int> mFreeEntries;
+    bool mDirty = false;
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/// Return the size of a NanoVG image or atlas icon
+extern NANOGUI_EXPORT void nvgIconSize(NVGcontext *ctx, int icon, int *width, int *height);
+
+/**
+ * \brief Equivalent of \c nvgImagePattern() that also accepts atlas icons
+ *
+ * The icon is mapped to the rectangle <tt>(x, y, width, height)</tt>. For
+ * atlas icons, the pattern covers the rest of the page as well, hence the
+ * filled path must not extend past this rectangle.
+ */
+extern NANOGUI_EXPORT NVGpaint nvgIconPattern(NVGcontext *ctx, float x, float y,
+                                              float width, float height, float angle,
+                                              int icon, float alpha);
+
+NAMESPACE_END(nanogui)
@@ -0,0 +1,182 @@
+/*
+    nanogui/imagecache.h -- Reference counted cache of NanoVG images with
+    a least-recently-used memory budget
+
+    NanoGUI was developed by Wenzel Jakob <wenzel.jakob@epfl.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+/** \file */
+
+#pragma once
+
+#include <nanogui/common.h>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+NAMESPACE_BEGIN(nanogui)
+
+/// Usage statistics of an \ref ImageCache
+struct NANOGUI_EXPORT ImageCacheStats {
+    /// Number of resident images
+    size_t images = 0;
+    /// Number of resident images with at least one reference
+    size_t referenced = 0;
+    /// Estimated GPU memory used by the resident images in bytes
+    size_t bytes = 0;
+    /// Number of lookups that found or did not find a cached image
+    size_t hits = 0, misses = 0;
+    /// Number of unreferenced images that were deleted to meet the budget
+    size_t evictions = 0;
+};
+
+/**
+ * \class ImageCache imagecache.h nanogui/imagecache.h
+ *
+ * \brief Keyed cache of the images of one NanoVG context.
+ *
+ * Small images can be packed into the \ref ImageAtlas of the cache on
+ * request, in which case their IDs are atlas icons that must be drawn using
+ * \ref nvgIconPattern().
+ *
+ * Images are reference counted. Unreferenced images stay resident so that
+ * they can be looked up again, until the least recently used ones are
+ * deleted to keep the total size within the budget. Every \ref Screen owns
+ * the cache of its context, which is destroyed along with the context.
+ *
+ * All methods except \ref get(), \ref find() and \ref destroy() must be
+ * called on the thread that draws the context, and images are only deleted
+ * within \ref trim() and \ref purge(), i.e. while the context is current.
+ */
+class NANOGUI_EXPORT ImageCache {
+public:
+    /**
+     * \brief Reference to a cached image that is released on destruction
+     *
+     * Images that are not owned by a cache (e.g. font icons or images created
+     * directly with NanoVG) are stored without taking a reference.
+     */
+    class NANOGUI_EXPORT Handle {
+    public:
+        Handle() { }
+        /// Refer to \c image, taking a new reference unless \c retain is \c false
+        Handle(NVGcontext *ctx, int image, bool retain = true);
+        Handle(Handle &&other) noexcept;
+        Handle &operator=(Handle &&other) noexcept;
+        ~Handle() { reset(); }
+
+        int image() const { return mImage; }
+        /// Check that the image is still held in the cache of \c ctx
+        bool valid(NVGcontext *ctx) const;
+        void reset();
+
+        Handle(const Handle &) = delete;
+        Handle &operator=(const Handle &) = delete;
+    private:
+        NVGcontext *mContext = nullptr;
+        uint64_t mToken = 0;
+        int mImage = 0;
+    };
+
+    /// Return the cache of a context, creating it on first use
+    static ImageCache *get(NVGcontext *ctx);
+    /// Return the cache of a context or \c nullptr if it has none
+    static ImageCache *find(NVGcontext *ctx);
+    /// Return the cache of a context if it still has the given \ref token(), or \c nullptr
+    static ImageCache *find(NVGcontext *ctx, uint64_t token);
+    /// Delete the cache of a context along with its images
+    static void destroy(NVGcontext *ctx);
+
+    /**
+     * \brief Unique number of this cache within the process
+     *
+     * A new context may be allocated at the address of a destroyed one.
+     * Objects that hold on to images of a context store this token and pass
+     * it to \ref find() to tell whether their context is still alive.
+     */
+    uint64_t token() const { return mToken; }
+
+    /// Return the image stored under \c key with a new reference, or 0
+    int acquire(const std::string &key);
+
+    /// Like \ref acquire(), but decode the given PNG/JPEG/.. data on a miss (see \ref create())
+    int acquire(const std::string &key, const uint8_t *data, size_t size,
+                int imageFlags = 0, bool pack = false);
+
+    /**
+     * \brief Create an image that is not cached yet
+     *
+     * With \c pack set and no \c imageFlags, images of up to
+     * \ref ImageAtlas::maxImageSize() pixels are packed into the atlas.
+     * Pass the result to \ref insert() or \ref discard().
+     */
+    int create(const uint8_t *rgba, int width, int height, int imageFlags = 0,
+               bool pack = false);
+
+    /// Delete an image returned by \ref create() that was not inserted
+    void discard(int image);
+
+    /**
+     * \brief Take ownership of an image created by the caller and store it
+     * under \c key, returning it with one reference
+     *
+     * If \c key is already cached, \c image is deleted and the cached image
+     * is returned instead.
+     */
+    int insert(const std::string &key, int image, int imageFlags = 0);
+
+    /// Take another reference; returns \c false for images not in the cache
+    bool retain(int image);
+    /// Drop a reference; unreferenced images remain cached until evicted
+    void release(int image);
+
+    /// Is the image owned by this cache?
+    bool contains(int image) const { return mEntries.count(image) != 0; }
+
+    /// Memory budget in bytes (exceeded if the referenced images need more)
+    size_t budget() const { return mBudget; }
+    void setBudget(size_t budget) { mBudget = budget; }
+
+    /// Delete least recently used unreferenced images until within budget
+    void trim();
+    /// Delete all unreferenced images
+    void purge();
+
+    ImageCacheStats stats() const;
+
+    ImageAtlas &atlas() { return *mAtlas; }
+
+    ImageCache(const ImageCache &) = delete;
+    ImageCache &operator=(const ImageCache &) = delete;
+
+private:
+    struct Entry {
+        std::string key;
+        size_t bytes;
+        int refCount;
+        /// Position in \ref mUnused while unreferenced
+        std::list<int>::iterator lru;
+    };
+
+    ImageCache(NVGcontext *ctx);
+    ~ImageCache();
+    int add(const std::string &key, int image, int imageFlags);
+    void evict(int image);
+
+    NVGcontext *mContext;
+    uint64_t mToken;
+    std::unique_ptr<ImageAtlas> mAtlas;
+    std::unordered_map<int, Entry> mEntries;
+    std::unordered_map<std::string, int> mKeys;
+    /// Unreferenced images, least recently used first
+    std::list<int> mUnused;
+    size_t mBudget = 64 * 1024 * 1024;
+    size_t mBytes = 0;
+    ImageCacheStats mStats;
+};
+
+NAMESPACE_END(nanogui)
@@ -0,0 +1,76 @@
+/*
+    nanogui/imageloader.h -- Background decoding of image thumbnails with
+    an optional on-disk cache
+
+    NanoGUI was developed by Wenzel Jakob <wenzel.jakob@epfl.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+/** \file */
+
+#pragma once
+
+#include <nanogui/object.h>
+#include <functional>
+#include <memory>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \class ImageLoader imageloader.h nanogui/imageloader.h
+ *
+ * \brief Decodes image files on a pool of worker threads and downscales
+ * them to thumbnails, which the GUI thread uploads a few at a time.
+ *
+ * Thumbnails are scaled so that their shorter side matches the requested
+ * size. When a cache directory is given, they are also stored there as raw
+ * RGBA data keyed by the path and modification time of the source file, so
+ * that subsequent runs skip decoding altogether.
+ *
+ * Destroying the loader doesn't wait for the workers: they drop the queued
+ * files, discard the image they are decoding and exit on their own.
+ */
+class NANOGUI_EXPORT ImageLoader : public Object {
+public:
+    /// Create a loader; \c threadCount = 0 picks a count based on the hardware
+    ImageLoader(int thumbSize, const std::string &cacheDirectory = "",
+                int threadCount = 0);
+
+    /// Queue an image file for decoding and return its index
+    size_t enqueue(const std::string &filename);
+
+    /**
+     * \brief Upload up to \c maxImages decoded thumbnails (GUI thread only)
+     *
+     * The callback receives the index of every finished image along with its
+     * handle from \ref ImageCache::create() (possibly an atlas icon), or 0 if
+     * the file could not be decoded. Returns the number of images that were
+     * handled.
+     */
+    size_t upload(NVGcontext *ctx, const std::function<void(size_t, int)> &callback,
+                  size_t maxImages = 8);
+
+    /// Number of queued images
+    size_t size() const { return mCount; }
+    /// Have all queued images been handed to the upload callback?
+    bool done() const { return mFinished == mCount; }
+
+    int thumbSize() const { return mThumbSize; }
+    const std::string &cacheDirectory() const { return mCacheDirectory; }
+
+protected:
+    /// Queues shared with the worker threads, which may outlive the loader
+    struct Shared;
+
+    virtual ~ImageLoader();
+
+    int mThumbSize;
+    std::string mCacheDirectory;
+    size_t mCount = 0, mFinished = 0;
+    std::shared_ptr<Shared> mShared;
+};
+
+NAMESPACE_END(nanogui)
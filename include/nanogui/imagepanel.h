@@ -14,6 +14,8 @@
 #pragma once
 
 #include <nanogui/widget.h>
+#include <nanogui/imagecache.h>
+#include <nanogui/imageloader.h>
 
 NAMESPACE_BEGIN(nanogui)
 
@@ -21,6 +23,10 @@ NAMESPACE_BEGIN(nanogui)
  * \class ImagePanel imagepanel.h nanogui/imagepanel.h
  *
  * \brief Image panel widget which shows a number of square-shaped icons.
+ *
+ * Images with the handle 0 are drawn as placeholders, which is how entries
+ * that are still being decoded by \ref loadDirectory() appear. Handles may
+ * refer to atlas icons (see \ref ImageAtlas).
  */
 class NANOGUI_EXPORT ImagePanel : public Widget {
 public:
@@ -28,9 +34,22 @@ public:
 public:
     ImagePanel(Widget *parent);
 
-    void setImages(const Images &data) { mImages = data; }
+    void setImages(const Images &data);
     const Images& images() const { return mImages; }
 
+    /**
+     * \brief Show the PNG images of a directory, which are decoded in the
+     * background and appear as their thumbnails become ready
+     *
+     * Thumbnails are cached in \c cacheDirectory unless it is empty. The
+     * uploaded thumbnails are shared through the \ref ImageCache of the
+     * context, so that showing the same directory again is immediate.
+     */
+    void loadDirectory(const std::string &path, const std::string &cacheDirectory = "");
+
+    /// Is \ref loadDirectory() still decoding images?
+    bool loading() const { return mResolveFiles || (mLoader && !mLoader->done()); }
+
     std::function<void(int)> callback() const { return mCallback; }
     void setCallback(const std::function<void(int)> &callback) { mCallback = callback; }
 
@@ -41,6 +60,9 @@ public:
 protected:
     Vector2i gridSize() const;
     int indexForPosition(const Vector2i &p) const;
+    /// Look up the thumbnails of \ref loadDirectory() and upload finished ones
+    void updateThumbnails(NVGcontext *ctx);
+    std::string thumbnailKey(size_t index) const;
 protected:
     Images mImages;
     std::function<void(int)> mCallback;
@@ -48,6 +70,13 @@ protected:
     int mSpacing;
     int mMargin;
     int mMouseIndex;
+    std::vector<std::string> mFiles;
+    std::string mCacheDirectory;
+    bool mResolveFiles = false;
+    ref<ImageLoader> mLoader;
+    /// Maps the indices of \ref mLoader to the images of the panel
+    std::vector<size_t> mLoaderSlots;
+    std::vector<ImageCache::Handle> mHandles;
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
@@ -17,21 +17,145 @@
 #include <nanogui/widget.h>
 #include <nanogui/glutil.h>
 #include <functional>
+#include <memory>
+#include <vector>
 
 NAMESPACE_BEGIN(nanogui)
 
+/**
+ * \class ImageTileSource imageview.h nanogui/imageview.h
+ *
+ * \brief Source of a tiled image pyramid that is too large to be resident on
+ * the GPU. Level 0 is the full resolution image, and every further level
+ * halves the resolution until the image fits into a single tile.
+ */
+class NANOGUI_EXPORT ImageTileSource : public Object {
+public:
+    /// Size of the full resolution image in pixels
+    virtual Vector2i size() const = 0;
+
+    /// Width and height of a tile in pixels
+    virtual int tileSize() const { return 256; }
+
+    /// Number of pyramid levels
+    virtual int levelCount() const;
+
+    /// Size of a pyramid level in pixels
+    Vector2i levelSize(int level) const;
+
+    /**
+     * Decode a tile into \c rgba, which has room for <tt>tileSize()^2</tt>
+     * RGBA8 pixels in row-major order. Tiles at the right and bottom edges
+     * only fill their valid top-left region. Called concurrently from worker
+     * threads. Return \c false if the tile is unavailable.
+     */
+    virtual bool readTile(int level, const Vector2i &tile, uint8_t *rgba) const = 0;
+protected:
+    virtual ~ImageTileSource() = default;
+};
+
+/// Result of the GPU reduction of the channel displayed by an \ref ImageView
+struct NANOGUI_EXPORT ImageStatistics {
+    float minimum = 0, maximum = 0, mean = 0;
+    /// Sample counts of equally sized bins spanning <tt>[minimum, maximum]</tt>
+    std::vector<float> histogram;
+};
+
 /**
  * \class ImageView imageview.h nanogui/imageview.h
  *
  * \brief Widget used to display images.
+ *
+ * Textures may hold high dynamic range (half or float) data. The default
+ * shader applies the exposure, gamma, channel selection and false color
+ * settings while drawing, so changing them does not touch the pixel data.
  */
 class NANOGUI_EXPORT ImageView : public Widget {
 public:
+    /// Textual information and color of a single pixel
+    typedef std::pair<std::string, Color> PixelInfo;
+
+    /**
+     * Batched pixel information callback. Fills \c info, which is preallocated
+     * to <tt>extent.prod()</tt> entries in row-major order, for the block of
+     * pixels starting at \c origin.
+     */
+    typedef std::function<void(const Vector2i &origin, const Vector2i &extent,
+                               std::vector<PixelInfo> &info)> PixelInfoBatchCallback;
+
+    /// Channels that can be shown in isolation
+    enum class Channel { RGB = 0, Red, Green, Blue, Alpha, Luminance };
+
+    /// Number of bins of \ref ImageStatistics::histogram
+    static const int HistogramBins = 256;
+
     ImageView(Widget* parent, GLuint imageID);
     ~ImageView();
 
+    /// Display a texture, replacing any tile source
     void bindImage(GLuint imageId);
 
+    /**
+     * Upload pixels with 1-4 interleaved channels (gray, gray+alpha, RGB,
+     * RGBA) to a texture owned by the view and display it. \c T may be
+     * \c uint8_t, \c half_float::half or \c float.
+     */
+    template <typename T> void setImageData(const T *data, const Vector2i &size, int channels) {
+        uploadImage(data, size, channels, (GLenum) detail::type_traits<T>::type);
+    }
+
+    /// Return the exposure in stops, pixel values are scaled by <tt>2^exposure</tt>
+    float exposure() const { return mExposure; }
+    void setExposure(float exposure) { mExposure = exposure; }
+
+    /// Return the display gamma (1 leaves values unchanged)
+    float gamma() const { return mGamma; }
+    void setGamma(float gamma) { mGamma = gamma; }
+
+    Channel channel() const { return mChannel; }
+    void setChannel(Channel channel) { mChannel = channel; }
+
+    /// Map the (exposed) value of the channel to a color scale instead of applying gamma
+    bool falseColor() const { return mFalseColor; }
+    void setFalseColor(bool falseColor) { mFalseColor = falseColor; }
+
+    /**
+     * Scale values so that the mean of the displayed channel maps to 0.18
+     * (in addition to \ref exposure()). The mean is computed on the GPU and
+     * used by the shader directly, without reading it back.
+     */
+    bool autoExposure() const { return mAutoExposure; }
+    void setAutoExposure(bool autoExposure) { mAutoExposure = autoExposure; }
+
+    /**
+     * Receive the minimum, maximum, mean and histogram of the displayed
+     * channel. They are computed on the GPU whenever the image or channel
+     * changes and read back asynchronously, i.e. a few frames later.
+     * Statistics are not available for tiled images.
+     */
+    void setStatisticsCallback(const std::function<void(const ImageStatistics &)> &callback) {
+        mStatisticsCallback = callback;
+    }
+    const std::function<void(const ImageStatistics &)> &statisticsCallback() const { return mStatisticsCallback; }
+
+    /// Recompute the statistics at the next redraw
+    void requestStatistics() { mStatisticsRevision = (size_t) -1; }
+
+    /**
+     * Display a tiled image instead of the bound texture (\c nullptr reverts
+     * to the texture). Tiles of the level matching the current scale are
+     * decoded in the background, nearest to the center of the view first,
+     * and coarser resident levels are shown until they arrive.
+     */
+    void setTileSource(ImageTileSource *source);
+    ImageTileSource *tileSource() { return mTileSource; }
+    const ImageTileSource *tileSource() const { return mTileSource.get(); }
+
+    /// Return the GPU memory budget for resident tiles in bytes
+    size_t tileBudget() const { return mTileBudget; }
+    /// Set the GPU memory budget for resident tiles, least recently used tiles are evicted first
+    void setTileBudget(size_t bytes);
+
     GLShader& imageShader() { return mShader; }
 
     Vector2f positionF() const { return mPos.cast<float>(); }
@@ -70,6 +194,20 @@ public:
     }
 #endif // DOXYGEN_SHOULD_SKIP_THIS
 
+    /**
+     * Set a batched pixel information callback. Takes precedence over the
+     * per-pixel callback; its results are cached until the image is rebound
+     * or \ref invalidatePixelInfo() is called.
+     */
+    void setPixelInfoBatchCallback(const PixelInfoBatchCallback &callback) {
+        mPixelInfoBatchCallback = callback;
+        invalidatePixelInfo();
+    }
+    const PixelInfoBatchCallback &pixelInfoBatchCallback() const { return mPixelInfoBatchCallback; }
+
+    /// Discard cached pixel information and statistics, e.g. after the image contents changed
+    void invalidatePixelInfo() { ++mImageRevision; }
+
     void setFontScaleFactor(float fontScaleFactor) { mFontScaleFactor = fontScaleFactor; }
     float fontScaleFactor() const { return mFontScaleFactor; }
 
@@ -135,6 +273,9 @@ public:
 private:
     // Helper image methods.
     void updateImageParameters();
+    void uploadImage(const void *data, const Vector2i &size, int channels, GLenum type);
+    void setDisplayUniforms(GLShader &shader);
+    void computeStatistics();
 
     // Helper drawing methods.
     void drawWidgetBorder(NVGcontext* ctx) const;
@@ -143,8 +284,10 @@ private:
     static void drawPixelGrid(NVGcontext* ctx, const Vector2f& upperLeftCorner,
                               const Vector2f& lowerRightCorner, float stride);
     void drawPixelInfo(NVGcontext* ctx, float stride) const;
-    void writePixelInfo(NVGcontext* ctx, const Vector2f& cellPosition,
-                        const Vector2i& pixel, float stride, float fontSize) const;
+    void updatePixelInfo(const Vector2i& topLeft, const Vector2i& bottomRight) const;
+    void drawTiles(const Vector2f& positionInScreen, const Vector2f& screenSize);
+    void writePixelInfo(NVGcontext* ctx, const Vector2f& cellPosition, const PixelInfo& info,
+                        float stride, float fontSize, Color& currentColor) const;
 
     // Image parameters.
     GLShader mShader;
@@ -166,7 +309,38 @@ private:
 
     // Image pixel data display members.
     std::function<std::pair<std::string, Color>(const Vector2i&)> mPixelInfoCallback;
+    PixelInfoBatchCallback mPixelInfoBatchCallback;
     float mFontScaleFactor = 0.2f;
+
+    // Pixel information of the block of pixels around the visible region.
+    size_t mImageRevision = 0;
+    mutable size_t mPixelInfoRevision = (size_t) -1;
+    mutable Vector2i mPixelInfoOrigin = Vector2i::Zero();
+    mutable Vector2i mPixelInfoExtent = Vector2i::Zero();
+    mutable std::vector<PixelInfo> mPixelInfo;
+
+    // Tiled image streaming.
+    class TileCache;
+    ref<ImageTileSource> mTileSource;
+    std::unique_ptr<TileCache> mTiles;
+    GLShader mTileShader;
+    size_t mTileBudget = 256u << 20;
+    std::vector<uint64_t> mTileRequests;
+
+    // High dynamic range display.
+    GLuint mOwnedImage = 0;
+    float mExposure = 0.f;
+    float mGamma = 1.f;
+    Channel mChannel = Channel::RGB;
+    bool mFalseColor = false;
+    bool mAutoExposure = false;
+
+    // GPU reduction of the displayed channel.
+    class Reduction;
+    std::unique_ptr<Reduction> mReduction;
+    size_t mStatisticsRevision = (size_t) -1;
+    Channel mStatisticsChannel = Channel::RGB;
+    std::function<void(const ImageStatistics &)> mStatisticsCallback;
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
@@ -0,0 +1,184 @@
+/*
+    nanogui/lodgraph.h -- Graph widget for very large time series, which
+    are drawn from a multi-resolution min/max/mean pyramid
+
+    NanoGUI was developed by Wenzel Jakob <wenzel.jakob@epfl.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+/** \file */
+
+#pragma once
+
+#include <nanogui/graph.h>
+#include <nanogui/object.h>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \class SampleSource lodgraph.h nanogui/lodgraph.h
+ *
+ * \brief Random access to the samples of a time series that may grow.
+ */
+class NANOGUI_EXPORT SampleSource : public Object {
+public:
+    /// Return the number of available samples
+    virtual size_t size() const = 0;
+
+    /// Copy \c count samples starting at \c offset to \c out
+    virtual void read(size_t offset, size_t count, float *out) const = 0;
+
+    /// Check for new samples (e.g. appended to a file by another process)
+    virtual void refresh() { }
+protected:
+    virtual ~SampleSource() = default;
+};
+
+/**
+ * \class MemorySampleSource lodgraph.h nanogui/lodgraph.h
+ *
+ * \brief Time series stored in memory.
+ */
+class NANOGUI_EXPORT MemorySampleSource : public SampleSource {
+public:
+    MemorySampleSource() { }
+    MemorySampleSource(std::vector<float> samples) : mSamples(std::move(samples)) { }
+
+    void append(float value) { mSamples.push_back(value); }
+    void append(const float *values, size_t count) { mSamples.insert(mSamples.end(), values, values + count); }
+
+    const std::vector<float> &samples() const { return mSamples; }
+
+    virtual size_t size() const override { return mSamples.size(); }
+    virtual void read(size_t offset, size_t count, float *out) const override;
+protected:
+    std::vector<float> mSamples;
+};
+
+/**
+ * \class MappedSampleSource lodgraph.h nanogui/lodgraph.h
+ *
+ * \brief Time series stored as raw native-endian 32-bit floats in a file,
+ * which is memory mapped. \ref refresh() picks up data appended to the file.
+ * The mapping reserves room for growth, so that appending only rarely
+ * requires a new mapping.
+ */
+class NANOGUI_EXPORT MappedSampleSource : public SampleSource {
+public:
+    /// Map a file, throws \c std::runtime_error on failure
+    MappedSampleSource(const std::string &filename);
+
+    virtual size_t size() const override { return mSize; }
+    virtual void read(size_t offset, size_t count, float *out) const override;
+    virtual void refresh() override;
+protected:
+    virtual ~MappedSampleSource();
+    void unmap();
+
+    std::string mFilename;
+    const float *mData = nullptr;
+    size_t mSize = 0;
+    /// Number of samples covered by the mapping, which may exceed the file size
+    size_t mMapped = 0;
+#if defined(_WIN32)
+    void *mFile = nullptr, *mMapping = nullptr;
+#else
+    int mFile = -1;
+#endif
+};
+
+/**
+ * \class LODGraph lodgraph.h nanogui/lodgraph.h
+ *
+ * \brief Graph of a time series with up to billions of samples.
+ *
+ * The widget keeps a pyramid of per-block minimum, maximum and mean values
+ * of the series, which is extended incrementally as samples are appended.
+ * Every frame reads only the level that matches the number of samples per
+ * pixel, so that drawing takes O(width) time regardless of the data size.
+ * Scrolling zooms around the mouse cursor and dragging pans the view.
+ */
+class NANOGUI_EXPORT LODGraph : public Graph {
+public:
+    /// Number of samples summarized by the bins of the finest pyramid level
+    static const size_t BaseBlockSize = 64;
+    /// Number of bins of a pyramid level that make up one bin of the next level
+    static const size_t LevelFactor = 4;
+    /// Maximum number of samples that a call to \ref update() adds to the pyramid
+    static const size_t UpdateBudget = 1 << 22;
+
+    LODGraph(Widget *parent, const std::string &caption = "Untitled");
+
+    SampleSource *source() { return mSource; }
+    const SampleSource *source() const { return mSource.get(); }
+    void setSource(SampleSource *source);
+
+    /// Return the range of values that is mapped to the height of the graph
+    std::pair<float, float> range() const { return { mMin, mMax }; }
+    void setRange(float min, float max) { mMin = min; mMax = max; }
+
+    /// Return the visible range of samples
+    std::pair<double, double> view() const { return { mViewStart, mViewEnd }; }
+
+    /// Show the samples in <tt>[start, end)</tt> and stop following appended data
+    void setView(double start, double end);
+
+    /// Show all samples and keep following appended data
+    void resetView() { mFitView = true; }
+
+    /// Does the view scroll along when samples are appended?
+    bool follow() const { return mFollow; }
+    void setFollow(bool follow) { mFollow = follow; }
+
+    /**
+     * Extend the pyramid with newly appended samples (called when the source
+     * is set and before drawing). At most \ref UpdateBudget samples are read
+     * per call, so large sources are covered over several frames.
+     */
+    void update();
+
+    /// Have all samples of the source been added to the pyramid?
+    bool complete() const { return mBuiltSamples == mSourceSize; }
+
+    /// Return the number of pyramid levels
+    size_t levelCount() const { return mLevels.size(); }
+
+    virtual bool mouseButtonEvent(const Vector2i &p, int button, bool down, int modifiers) override;
+    virtual bool mouseDragEvent(const Vector2i &p, const Vector2i &rel, int button, int modifiers) override;
+    virtual bool scrollEvent(const Vector2i &p, const Vector2f &rel) override;
+
+protected:
+    struct Bin {
+        float min, max, mean;
+    };
+
+    virtual void drawPlot(NVGcontext *ctx) override;
+
+    /// The source is plotted even if the values and series of the base class are empty
+    virtual bool hasPlot() const override { return mSource || Graph::hasPlot(); }
+
+    /// Number of samples summarized by a bin of the given level
+    static size_t binSize(size_t level);
+
+    void clampView();
+
+    ref<SampleSource> mSource;
+    std::vector<std::vector<Bin>> mLevels;
+    size_t mBuiltSamples = 0;
+    /// Size of the source at the last \ref update()
+    size_t mSourceSize = 0;
+    float mMin = 0.f, mMax = 1.f;
+    double mViewStart = 0, mViewEnd = 0;
+    bool mFitView = true, mFollow = true;
+
+    // Scratch space reused across updates and frames
+    std::vector<float> mSamples;
+    std::vector<Bin> mColumns;
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+NAMESPACE_END(nanogui)
@@ -14,6 +14,8 @@
 #include <nanogui/common.h>
 #include <nanogui/widget.h>
 #include <nanogui/screen.h>
+#include <nanogui/commandqueue.h>
+#include <nanogui/eventlog.h>
 #include <nanogui/theme.h>
 #include <nanogui/window.h>
 #include <nanogui/layout.h>
@@ -29,13 +31,19 @@
 #include <nanogui/messagedialog.h>
 #include <nanogui/textbox.h>
 #include <nanogui/slider.h>
+#include <nanogui/imageatlas.h>
+#include <nanogui/imagecache.h>
+#include <nanogui/imageloader.h>
 #include <nanogui/imagepanel.h>
 #include <nanogui/imageview.h>
 #include <nanogui/vscrollpanel.h>
 #include <nanogui/colorwheel.h>
 #include <nanogui/graph.h>
+#include <nanogui/lodgraph.h>
 #include <nanogui/formhelper.h>
 #include <nanogui/stackedwidget.h>
 #include <nanogui/tabheader.h>
 #include <nanogui/tabwidget.h>
 #include <nanogui/glcanvas.h>
+#include <nanogui/softwarerenderer.h>
+#include <nanogui/drawbatcher.h>
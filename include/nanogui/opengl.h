@@ -49,6 +49,9 @@ NAMESPACE_BEGIN(nanogui)
 /// Determine whether an icon ID is a texture loaded via nvgImageIcon
 inline bool nvgIsImageIcon(int value) { return value < 1024; }
 
+/// Determine whether an icon ID refers to an image packed into an ImageAtlas
+inline bool nvgIsAtlasIcon(int value) { return value < -1; }
+
 /// Determine whether an icon ID is a font-based icon (e.g. from the entypo.ttf font)
 inline bool nvgIsFontIcon(int value) { return value >= 1024; }
 
@@ -63,6 +63,12 @@ public:
     /// Draw the popup window
     virtual void draw(NVGcontext* ctx) override;
 
+    /**
+     * Popups are never culled: \ref draw() also follows the parent window and
+     * hides disposable popups, and the arrow reaches over to the parent button.
+     */
+    virtual void drawBounds(Vector2i &min, Vector2i &max) const override;
+
     virtual void save(Serializer &s) const override;
     virtual bool load(Serializer &s) override;
 protected:
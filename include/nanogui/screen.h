@@ -15,6 +15,11 @@
 #pragma once
 
 #include <nanogui/widget.h>
+#include <nanogui/commandqueue.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #if defined(NANOVG_GL2_IMPLEMENTATION) || defined(NANOVG_GLES2_IMPLEMENTATION)
     #define NANOGUI_CURSOR_DISABLED
@@ -108,9 +113,42 @@ public:
     /// Set window size
     void setSize(const Vector2i& size);
 
-    /// Draw the Screen contents
+    /**
+     * Draw the Screen contents. When \ref mainloop() draws screens in
+     * parallel (see \ref setParallelDrawing()), this only runs
+     * \ref prepareFrame(), and the other two phases follow on a worker thread
+     * and on the main thread once all screens have been prepared. Overrides
+     * must therefore not draw anything after calling the base implementation
+     * (this is asserted in debug builds); draw in \ref drawContents() instead.
+     */
     virtual void drawAll();
 
+    /**
+     * First phase of \ref drawAll(): execute queued commands and input and
+     * query the window size. Must be called on the main thread.
+     */
+    void prepareFrame();
+
+    /**
+     * Second phase of \ref drawAll(): make the OpenGL context current and
+     * draw the contents and widgets. May run on any thread while no other
+     * thread uses this screen.
+     */
+    void renderFrame();
+
+    /// Last phase of \ref drawAll(): swap the buffers and reclaim removed widgets
+    void presentFrame();
+
+    /// Return the requested swap interval (number of vertical blanks per buffer swap)
+    int swapInterval() const { return mSwapInterval; }
+
+    /**
+     * Set the swap interval, which is applied during the next buffer swap.
+     * When \ref mainloop() draws several screens, only the last one of them
+     * waits for the vertical blank, so that they don't wait in turn.
+     */
+    void setSwapInterval(int swapInterval) { mSwapInterval = swapInterval; }
+
     /// Draw the window contents --- put your OpenGL draw calls here
     virtual void drawContents() { /* To be overridden */ }
 
@@ -129,6 +167,25 @@ public:
     /// Window resize event handler
     virtual bool resizeEvent(const Vector2i& size);
 
+    /**
+     * Register a global keyboard shortcut that fires on key press and repeat
+     * before the focused widgets see the event, unless a focused widget takes
+     * text input (see \ref Widget::textInput()) and consumes the key itself.
+     * The character produced by the key is not delivered. Only the shift,
+     * control, alt and super modifiers are considered. An empty callback
+     * removes the shortcut.
+     */
+    void setShortcut(int key, int modifiers, const std::function<void()> &callback);
+
+    /// Remove a shortcut registered with \ref setShortcut()
+    void removeShortcut(int key, int modifiers) { setShortcut(key, modifiers, nullptr); }
+
+    /// Remove all shortcuts
+    void clearShortcuts() { mShortcuts.clear(); }
+
+    /// Check if a shortcut is registered for the given key combination
+    bool hasShortcut(int key, int modifiers) const { return mShortcuts.count(shortcutKey(key, modifiers)) != 0; }
+
     /// Set the resize callback
     std::function<void(Vector2i)> resizeCallback() const { return mResizeCallback; }
     void setResizeCallback(const std::function<void(Vector2i)> &callback) { mResizeCallback = callback; }
@@ -142,12 +199,101 @@ public:
     /// Return a pointer to the underlying GLFW window data structure
     GLFWwindow *glfwWindow() { return mGLFWWindow; }
 
-    /// Return a pointer to the underlying nanoVG draw context
-    NVGcontext *nvgContext() { return mNVGContext; }
+    /// Return a pointer to the nanoVG context that the widgets are drawn with
+    NVGcontext *nvgContext() { return mSoftwareContext ? mSoftwareContext : mNVGContext; }
+
+    /// Are the widgets rasterized on the CPU?
+    bool softwareRendering() const { return mSoftwareContext != nullptr; }
+
+    /**
+     * Rasterize the widgets on the CPU with \ref nvgCreateSoftware() and
+     * upload the result as a single texture per frame, e.g. for drivers with
+     * slow or incorrect path rendering. \ref nvgContext() then returns the
+     * software context, so images must be created after enabling this mode.
+     * Layered windows are drawn directly, and widgets that issue their own
+     * OpenGL draw calls (\ref GLCanvas, \ref ImageView) are hidden by the
+     * widgets drawn over them. \ref drawContents() still uses OpenGL.
+     */
+    void setSoftwareRendering(bool software);
 
     void setShutdownGLFWOnDestruct(bool v) { mShutdownGLFWOnDestruct = v; }
     bool shutdownGLFWOnDestruct() { return mShutdownGLFWOnDestruct; }
 
+    /**
+     * Queue a command for execution on the GUI thread before the next frame
+     * is drawn, and wake up the main loop. Thread safe.
+     */
+    void post(CommandQueue::Command command);
+
+    /**
+     * Queue an update of \c target for execution before the next frame. Any
+     * pending update with the same target and slot is dropped. The target is
+     * kept alive until the update has run, and the update is skipped if the
+     * target has been removed from its parent by then. Thread safe.
+     */
+    void post(const Widget *target, int slot, CommandQueue::Command command);
+
+    /**
+     * Queue a call of the setter of a widget, see \ref post(const Widget *, int, CommandQueue::Command).
+     * While an update of the same target and slot is pending, only its value
+     * is replaced, so producers may call this at any rate without queueing a
+     * command each time. Thread safe.
+     */
+    template <typename T, typename Arg, typename Value>
+    void postUpdate(T *target, void (T::*setter)(Arg), Value &&value, int slot = 0) {
+        typedef PendingSetter<T, Arg> Pending;
+        {
+            std::lock_guard<std::mutex> guard(mUpdateMutex);
+            std::unique_ptr<PendingUpdate> &entry = mPendingUpdates[std::make_pair((const Widget *) target, slot)];
+            Pending *pending = dynamic_cast<Pending *>(entry.get());
+            if (pending) {
+                pending->setter = setter;
+                pending->value = std::forward<Value>(value);
+                return;
+            }
+            entry.reset(new Pending(target, setter, std::forward<Value>(value)));
+        }
+        pushUpdate(target, slot);
+    }
+
+    /**
+     * Run \c task on the GUI thread once the next frame has been presented,
+     * so that work which isn't needed for that frame doesn't delay it. Wakes
+     * up the main loop. GUI thread only.
+     */
+    void postAfterFrame(CommandQueue::Command task);
+
+    /// Execute all queued commands (called by \ref drawAll())
+    size_t processCommands() { return mCommands.process(); }
+
+    /// Is mouse motion and scroll input queued and merged until the next frame?
+    bool eventCoalescing() const { return mEventCoalescing; }
+
+    /**
+     * Queue mouse motion and scroll input, merging consecutive events of the
+     * same kind. The queue is dispatched before every frame and before any
+     * other input event, so the order relative to button presses is kept.
+     */
+    void setEventCoalescing(bool eventCoalescing);
+
+    /// Dispatch queued mouse motion and scroll input (called by \ref drawAll())
+    void processPendingEvents();
+
+    /// Current time in seconds, which is the virtual time during a replay
+    double time() const;
+
+    /// Virtual time in seconds, or a negative value when the real clock is used
+    double virtualTime() const { return mVirtualTime; }
+
+    /// Override the clock used for animations and double clicks (negative: real clock)
+    void setVirtualTime(double virtualTime) { mVirtualTime = virtualTime; }
+
+    /// Return the recorder that logs the raw input of this screen (if any)
+    EventRecorder *eventRecorder() const { return mEventRecorder; }
+
+    /// Log the raw input and frame boundaries of this screen (not owned, may be \c nullptr)
+    void setEventRecorder(EventRecorder *recorder) { mEventRecorder = recorder; }
+
     using Widget::performLayout;
 
     /// Compute the layout of all widgets
@@ -193,19 +339,59 @@ public:
     void centerWindow(Window *window);
     void moveWindowToFront(Window *window);
     void drawWidgets();
+    /// Re-render the layers of all layered windows, e.g. after a theme change
+    void markLayersDirty();
 
 protected:
     void deinitialize();
+    bool processCursorPos(double x, double y);
+    bool processScroll(double x, double y);
+
+    void updateFrameSize();
+    bool processShortcut(int key, int action, int modifiers);
+    static uint64_t shortcutKey(int key, int modifiers);
+
+    /// Value of a \ref postUpdate() call that hasn't been applied yet
+    struct PendingUpdate {
+        virtual ~PendingUpdate() = default;
+        virtual void apply() = 0;
+    };
+
+    template <typename T, typename Arg> struct PendingSetter : PendingUpdate {
+        template <typename Value>
+        PendingSetter(T *target, void (T::*setter)(Arg), Value &&value)
+            : target(target), setter(setter), value(std::forward<Value>(value)) { }
+        void apply() override { (target->*setter)(value); }
+
+        T *target;
+        void (T::*setter)(Arg);
+        typename std::decay<Arg>::type value;
+    };
+
+    /// Queue the command that applies the pending update of \c target and \c slot
+    void pushUpdate(const Widget *target, int slot);
+
+    /// Mouse motion or scroll input waiting for \ref processPendingEvents()
+    struct PendingEvent {
+        bool scroll;
+        double x, y;
+    };
 
 protected:
     GLFWwindow *mGLFWWindow;
     NVGcontext *mNVGContext;
+    /* CPU rasterizer of setSoftwareRendering() and the texture that its
+       pixels are uploaded to */
+    NVGcontext *mSoftwareContext = nullptr;
+    int mSoftwareImage = 0;
+    Vector2i mSoftwareImageSize = Vector2i::Zero();
 #if !defined(NANOGUI_CURSOR_DISABLED)
     GLFWcursor *mCursors[(int) Cursor::CursorCount];
     Cursor mCursor;
 #endif
-    std::vector<Widget *> mFocusPath;
-    std::vector<Widget *> mMouseFocusPath;
+    std::vector<Widget *> mFocusPath, mOldFocusPath;
+    std::vector<Widget *> mMouseFocusPath, mOldMouseFocusPath;
+    size_t mFocusGeneration = 0, mMouseFocusGeneration = 0;
     Vector2i mFBSize;
     float mPixelRatio;
     int mMouseState, mModifiers;
@@ -221,6 +407,35 @@ protected:
     bool mFullscreen;
     std::function<void(Vector2i)> mResizeCallback;
     float mFPS;
+    CommandQueue mCommands;
+    std::vector<CommandQueue::Command> mAfterFrame;
+    /* Latest values of postUpdate() calls, each with one queued command */
+    std::mutex mUpdateMutex;
+    std::map<std::pair<const Widget *, int>, std::unique_ptr<PendingUpdate>> mPendingUpdates;
+    bool mEventCoalescing = false;
+    std::vector<PendingEvent> mPendingEvents;
+    double mVirtualTime = -1;
+    EventRecorder *mEventRecorder = nullptr;
+    std::unordered_map<uint64_t, std::function<void()>> mShortcuts;
+    /* Widget that consumed the last key press, valid while the focus
+       generation is unchanged. Key repeats and the characters they produce
+       are delivered to it directly. */
+    Widget *mKeyConsumer = nullptr;
+    int mKeyConsumerKey = -1;
+    size_t mKeyConsumerGeneration = 0;
+    bool mKeyRepeating = false;
+    /* Set when a shortcut consumed the last key press or repeat, whose
+       character event is dropped */
+    bool mSuppressCharacter = false;
+    double mFrameStartTime = 0;
+    bool mFrameSizeValid = false;
+    int mSwapInterval = 0, mAppliedSwapInterval = 0;
+    /* Swap interval enforced by mainloop() for the current frame, or -1 */
+    int mFrameSwapInterval = -1;
+    /* Set by mainloop() while drawAll() should leave rendering and
+       presenting to it, and by drawAll() once it has done so */
+    bool mDeferFrame = false, mFrameDeferred = false;
+    friend void mainloop(int refresh);
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
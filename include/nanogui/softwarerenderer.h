@@ -0,0 +1,51 @@
+/*
+    nanogui/softwarerenderer.h -- NanoVG backend that rasterizes on the CPU
+
+    NanoGUI was developed by Wenzel Jakob <wenzel.jakob@epfl.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+/** \file */
+
+#pragma once
+
+#include <nanogui/common.h>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Create a NanoVG context that renders into a pixel buffer in memory
+ *
+ * NanoVG flattens paths as usual, and the backend scan converts them with
+ * exact area coverage instead of the stencil passes of the OpenGL backends,
+ * so no OpenGL context is required. Drawing commands are queued until
+ * \c nvgEndFrame(), which renders horizontal bands of the buffer on
+ * \c threadCount threads (0 picks a count based on the hardware). The
+ * threads are started on first use and kept until the context is deleted.
+ * The buffer takes on the size passed to \c nvgBeginFrame() times the pixel
+ * ratio and holds premultiplied RGBA pixels, top row first.
+ *
+ * A \ref Screen draws its widgets with this backend when
+ * \ref Screen::setSoftwareRendering() is enabled, but there is no headless
+ * screen. Plain NanoVG drawing (including that of most widgets) works in a
+ * software context, but layered windows, \ref ImageView and \ref GLCanvas
+ * issue OpenGL calls and must not be drawn into one.
+ */
+extern NANOGUI_EXPORT NVGcontext *nvgCreateSoftware(int threadCount = 0);
+
+/// Check if a context was created by \ref nvgCreateSoftware()
+extern NANOGUI_EXPORT bool nvgIsSoftware(NVGcontext *ctx);
+
+/// Destroy a context created by \ref nvgCreateSoftware()
+extern NANOGUI_EXPORT void nvgDeleteSoftware(NVGcontext *ctx);
+
+/// Fill the pixel buffer of a software context with a (non-premultiplied) color
+extern NANOGUI_EXPORT void nvgSoftwareClear(NVGcontext *ctx, const Color &color);
+
+/// Return the pixel buffer of a software context along with its size
+extern NANOGUI_EXPORT const uint8_t *nvgSoftwarePixels(NVGcontext *ctx, int *width, int *height);
+
+NAMESPACE_END(nanogui)
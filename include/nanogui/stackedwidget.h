@@ -31,12 +31,39 @@ public:
     void setSelectedIndex(int index);
     int selectedIndex() const;
 
+    /// Return whether hidden pages are only laid out once they are selected
+    bool lazyLayout() const { return mLazyLayout; }
+    /// Set whether hidden pages are only laid out once they are selected
+    void setLazyLayout(bool lazyLayout) { mLazyLayout = lazyLayout; }
+
+    /// Return whether the pages next to the selected one are laid out ahead of time
+    bool prelayout() const { return mPrelayout; }
+    /**
+     * Set whether the pages next to the selected one are laid out ahead of
+     * time, one per frame after the selected page has been shown, so that
+     * switching to them doesn't stall on their layout
+     */
+    void setPrelayout(bool prelayout) { mPrelayout = prelayout; }
+
+    /// Return whether the page at the given index needs to be laid out
+    bool layoutStale(int index) const;
+
     virtual void performLayout(NVGcontext* ctx) override;
     virtual Vector2i preferredSize(NVGcontext* ctx) const override;
     virtual void addChild(int index, Widget* widget) override;
+    using Widget::removeChild;
+    virtual void removeChild(const Widget *widget) override;
 
 private:
+    void layoutPage(int index);
+    void schedulePrelayout();
+
     int mSelectedIndex = -1;
+    bool mLazyLayout = true;
+    bool mPrelayout = false;
+    bool mPrelayoutScheduled = false;
+    NVGcontext *mLayoutContext = nullptr;
+    std::vector<const Widget *> mStalePages;
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
@@ -87,6 +87,15 @@ public:
     const Widget* tab(const std::string &label) const;
     Widget* tab(const std::string &label);
 
+    /// Return whether the tabs next to the active one are laid out ahead of time
+    bool prelayout() const;
+
+    /**
+     * Set whether the tabs next to the active one are laid out before the next
+     * frame. Inactive tabs are otherwise only laid out once they are selected.
+     */
+    void setPrelayout(bool prelayout);
+
     virtual void performLayout(NVGcontext* ctx) override;
     virtual Vector2i preferredSize(NVGcontext* ctx) const override;
     virtual void draw(NVGcontext* ctx) override;
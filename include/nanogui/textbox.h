@@ -17,6 +17,7 @@
 
 #include <nanogui/compat.h>
 #include <nanogui/widget.h>
+#include <nanogui/theme.h>
 #include <sstream>
 
 NAMESPACE_BEGIN(nanogui)
@@ -77,6 +78,7 @@ public:
     virtual bool focusEvent(bool focused) override;
     virtual bool keyboardEvent(int key, int scancode, int action, int modifiers) override;
     virtual bool keyboardCharacterEvent(unsigned int codepoint) override;
+    virtual bool textInput() const override { return mEditable; }
 
     virtual Vector2i preferredSize(NVGcontext *ctx) const override;
     virtual void draw(NVGcontext* ctx) override;
@@ -121,6 +123,7 @@ protected:
     int mMouseDownModifier;
     float mTextOffset;
     double mLastClick;
+    ChromeCache mChrome;
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
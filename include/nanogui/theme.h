@@ -16,10 +16,44 @@
 
 #include <nanogui/common.h>
 #include <nanogui/object.h>
+#include <nanogui/imagecache.h>
 #include <json/json.hpp>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
 
 NAMESPACE_BEGIN(nanogui)
 
+/// Specifies how the glyphs of a font face are rasterized into NanoVG's font atlas
+enum class GlyphMode {
+    Exact = 0, ///< Rasterize glyphs at exactly the requested size
+    Quantized  ///< Snap sizes to 1/8 octave steps so that zooming reuses cached glyphs
+};
+
+/**
+ * \class ChromeCache theme.h nanogui/theme.h
+ *
+ * \brief Image of a piece of chrome, kept by the widget that draws it with
+ * \ref Theme::drawChrome().
+ *
+ * The parameters of the last draw are compared on every frame, and the cache
+ * key is only built and looked up in the \ref ImageCache when they change.
+ */
+class NANOGUI_EXPORT ChromeCache {
+public:
+    /// Drop the reference to the image
+    void reset() { mHandle.reset(); }
+
+private:
+    friend class Theme;
+    const char *mName = nullptr;
+    /// Components of the colors, followed by the values
+    std::vector<float> mParams;
+    Vector2i mExtent = Vector2i::Zero();
+    float mPixelRatio = 0.f;
+    ImageCache::Handle mHandle;
+};
+
 /**
  * \class Theme theme.h nanogui/theme.h
  *
@@ -58,9 +92,110 @@ public:
      */
     void update(const json& j);
 
+    /**
+     * Register a font face that is stored in memory and set its glyph mode.
+     * The data is not copied and must outlive all NanoVG contexts using it.
+     */
+    void addFont(const std::string &name, const unsigned char *data, size_t size,
+                 GlyphMode mode = GlyphMode::Exact);
+
+    /**
+     * Register a font face for all themes of the process. The data is not
+     * copied, and a NanoVG context only receives it when the face is first
+     * selected there (the default faces are registered when a \ref Theme is
+     * created). Registering a face again replaces it in all contexts. Data
+     * that NanoVG can't load is reported once, and the face falls back to
+     * "sans".
+     */
+    static void registerFont(const std::string &name, const unsigned char *data, size_t size);
+
+    /**
+     * Load a font file and register it for all themes of the process. With
+     * \c background set, the file is read on a separate thread, and the face
+     * falls back to "sans" until it is available. If the background load
+     * fails, the error is printed once and the face keeps falling back.
+     */
+    static void loadFont(const std::string &name, const std::string &filename,
+                         bool background = false);
+
+    /// Return the glyph mode of a font face
+    GlyphMode glyphMode(const std::string &face) const;
+    /// Set the glyph mode of a font face
+    void setGlyphMode(const std::string &face, GlyphMode mode) { mGlyphModes[face] = mode; }
+
+    /// Select a font face and size in \c ctx, taking the glyph mode of the face into account
+    void setFont(NVGcontext *ctx, const std::string &face, float size) const;
+
+    /**
+     * \brief Draw a piece of widget chrome from a cached nine-slice image
+     *
+     * \c render draws the chrome into a rectangle of the given size at the
+     * origin, based on nothing but \c colors and \c values. It runs once per
+     * \c name, parameters, template size and pixel ratio on a software context
+     * (see \ref nvgCreateSoftware()), and the result is kept in the
+     * \ref ImageCache of \c ctx and referenced by \c cache. Along an axis with
+     * a nonzero \c margin, the template is <tt>2 * margin + 1</tt> units long
+     * and its center unit is stretched, so the margin must cover everything
+     * that varies along that axis. Other axes are rendered at their full size.
+     * The image is drawn as up to nine quads, leaving out the center one if
+     * \c hollow is set.
+     */
+    template <typename Render>
+    void drawChrome(NVGcontext *ctx, ChromeCache &cache, const char *name,
+                    std::initializer_list<Color> colors, std::initializer_list<float> values,
+                    const Vector2i &pos, const Vector2i &size, const Vector2i &margin,
+                    float pixelRatio, const Render &render, bool hollow = false) const {
+        /* Wrapping a reference doesn't allocate, unlike a capturing lambda */
+        drawChrome(ctx, cache, name, colors, values, pos, size, margin, pixelRatio,
+                   ChromeRender(std::cref(render)), hollow);
+    }
+
+    /// Build the \ref ImageCache key of a kind of chrome and its parameters
+    static std::string chromeKey(const std::string &name, std::initializer_list<Color> colors,
+                                 std::initializer_list<float> values = {});
+
+    /// Draw the drop shadow around a rounded rectangle using \ref drawChrome()
+    void drawShadow(NVGcontext *ctx, ChromeCache &cache, const Vector2i &pos,
+                    const Vector2i &size, int cornerRadius, int shadowSize,
+                    float pixelRatio) const;
+
+protected:
+    typedef std::function<void(NVGcontext *, const Vector2i &)> ChromeRender;
+
+    void drawChrome(NVGcontext *ctx, ChromeCache &cache, const char *name,
+                    std::initializer_list<Color> colors, std::initializer_list<float> values,
+                    const Vector2i &pos, const Vector2i &size, const Vector2i &margin,
+                    float pixelRatio, const ChromeRender &render, bool hollow) const;
+
+    /**
+     * Return the id of a font face in \c ctx, registering it on first use and
+     * again whenever the face is replaced. Faces that are still loading or
+     * failed to load fall back to "sans".
+     */
+    int fontId(NVGcontext *ctx, const std::string &face) const;
+
+    /// Font id created in a context from a version of a registered face
+    struct FontSlot {
+        int id;
+        /// Version of the face in the registry
+        size_t version;
+        /// Registry generation at which the version was last checked
+        size_t generation;
+    };
+
+    /// Font ids of a context, reset when the context is replaced (see \ref ImageCache::token())
+    struct ContextFonts {
+        uint64_t token = 0;
+        std::unordered_map<std::string, FontSlot> faces;
+    };
+
 protected:
     json mProperties;
     NVGcontext *mCtx;
+    std::unordered_map<std::string, GlyphMode> mGlyphModes;
+    /* Screens sharing a theme may be drawn in parallel, see setParallelDrawing() */
+    mutable std::mutex mFontMutex;
+    mutable std::unordered_map<NVGcontext *, ContextFonts> mFontIds;
 
 protected:
     virtual ~Theme() = default;
@@ -147,7 +147,7 @@ public:
     void removeChild(int index);
 
     /// Remove a child widget by value
-    void removeChild(const Widget *widget);
+    virtual void removeChild(const Widget *widget);
 
     /// Retrieves the child at the specific position
     const Widget* childAt(int index) const { return mChildren[index]; }
@@ -256,6 +256,9 @@ public:
     /// Handle text input (UTF-32 format) (default implementation: do nothing)
     virtual bool keyboardCharacterEvent(unsigned int codepoint);
 
+    /// Does the widget take text input while focused? It then sees key presses before shortcuts
+    virtual bool textInput() const { return false; }
+
     /// Compute the preferred size of the widget
     virtual Vector2i preferredSize(NVGcontext *ctx) const;
 
@@ -265,13 +268,72 @@ public:
     /// Draw the widget (and all child widgets)
     virtual void draw(NVGcontext *ctx);
 
+    /**
+     * Return the rectangle (relative to the parent) that \ref draw() may touch,
+     * which the parent tests against the visible region before drawing the
+     * widget. The default is the widget's own bounds; widgets that draw past
+     * them enlarge it.
+     */
+    virtual void drawBounds(Vector2i &min, Vector2i &max) const;
+
+    /// Request that the layer of the enclosing window is re-rendered, see \ref Window::setLayered()
+    void markDirty();
+
     /// Save the state of the widget into the given \ref Serializer instance
     virtual void save(Serializer &s) const;
 
     /// Restore the state of the widget from the given \ref Serializer instance
     virtual bool load(Serializer &s);
 
+    /// Return whether the widget or one of its ancestors was removed from its parent and not added again
+    bool removed() const { return mRemoved; }
+
+    /**
+     * Defer the release of removed widgets to \ref reclaimRemoved(), which
+     * \ref Screen::drawAll() calls between frames. This is always the case
+     * while \ref setParallelDrawing() is enabled, so that widgets removed on
+     * a drawing thread are destroyed on the main thread.
+     */
+    static void setDeferredDestruction(bool deferred);
+    /// Return whether the release of removed widgets is deferred
+    static bool deferredDestruction();
+
+    /**
+     * Keep removed widgets alive indefinitely and report when they are still
+     * drawn, receive events or request the focus (implies deferred destruction)
+     */
+    static void setRemovalChecks(bool checks);
+    /// Return whether uses of removed widgets are reported
+    static bool removalChecks();
+
+    /// Release widgets whose removal was deferred; call on the main thread, outside of any traversal
+    static void reclaimRemoved();
+
+    /**
+     * Set the region of the current NanoVG frame outside of which \ref draw()
+     * skips children without touching the NanoVG state, along with the pixel
+     * ratio of the frame (called by \ref Screen on the drawing thread). A zero
+     * size disables culling.
+     */
+    static void setDrawClip(const Vector2i &size, float pixelRatio = 1.f);
+
+    /**
+     * Return the pixel ratio of the frame being drawn on this thread (see
+     * \ref setDrawClip()), which widgets pass to cached renderings instead of
+     * looking up their screen. It is 1 outside of a frame.
+     */
+    static float drawPixelRatio();
+
+    /// Return the size of the frame being drawn on this thread, or zero outside of a frame
+    static Vector2i drawFrameSize();
+
 protected:
+    /// Report the use of a removed widget if removal checks are enabled
+    void checkRemoved(const char *operation) const;
+
+    /// Set the removal flag of the widget and all of its descendants
+    void setRemoved(bool removed);
+
     /// Free all resources used by the widget and any children
     virtual ~Widget();
 
@@ -288,6 +350,7 @@ protected:
     std::string mTooltip;
     int mFontSize;
     Cursor mCursor;
+    bool mRemoved;
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
@@ -13,6 +13,8 @@
 #pragma once
 
 #include <nanogui/widget.h>
+#include <nanogui/theme.h>
+#include <memory>
 
 NAMESPACE_BEGIN(nanogui)
 
@@ -29,7 +31,7 @@ public:
     /// Return the window title
     const std::string &title() const { return mTitle; }
     /// Set the window title
-    void setTitle(const std::string &title) { mTitle = title; }
+    void setTitle(const std::string &title) { mTitle = title; markDirty(); }
 
     /// Is this a model dialog?
     bool modal() const { return mModal; }
@@ -49,8 +51,41 @@ public:
     /// Center the window in the current \ref Screen
     void center();
 
+    /// Is the window rendered into a cached offscreen layer?
+    bool layered() const { return mLayered; }
+
+    /**
+     * \brief Render the window and its children into an offscreen layer
+     *
+     * The layer is only re-rendered when the window is marked dirty (see
+     * \ref Widget::markDirty()), which happens automatically for input,
+     * focus changes, layout and commands queued with \ref Screen::post()
+     * (only the window of the target, if one is given). The \ref Screen
+     * composites layers as textured quads, hence moving, raising and stacking
+     * layered windows costs next to nothing. Widgets that change without any
+     * of these (e.g. a progress bar driven by a timer) must call
+     * \ref Widget::markDirty() themselves, and children that issue their own
+     * OpenGL draw calls (\ref GLCanvas and \ref ImageView) are not
+     * supported. Popups are never layered.
+     */
+    void setLayered(bool layered) { mLayered = layered; mLayerDirty = true; }
+
+    /// Does the layer need to be re-rendered before it is composited again?
+    bool layerDirty() const { return mLayerDirty; }
+
+    /**
+     * Re-render the layer if needed, or free it if the window is no longer
+     * layered. Called by \ref Screen before the widgets are drawn.
+     */
+    void updateLayer(NVGcontext *ctx, float pixelRatio);
+
+    /// Release the offscreen layer (requires a current OpenGL context)
+    void releaseLayer();
+
     /// Draw the window
     virtual void draw(NVGcontext *ctx) override;
+    /// Include the drop shadow in the drawn rectangle
+    virtual void drawBounds(Vector2i &min, Vector2i &max) const override;
     /// Handle window drag events
     virtual bool mouseDragEvent(const Vector2i &p, const Vector2i &rel, int button, int modifiers) override;
     /// Handle mouse motion events.
@@ -66,16 +101,26 @@ public:
     virtual void save(Serializer &s) const override;
     virtual bool load(Serializer &s) override;
 protected:
+    virtual ~Window();
     /// Internal helper function to maintain nested window position values; overridden in \ref Popup
     virtual void refreshRelativePlacement();
     /// Force window to remain at least partially on-screen. 
     void fixPosition();
 protected:
+    friend class Widget;
+    class Layer;
+
     std::string mTitle;
     Widget *mButtonPanel;
     bool mModal;
     bool mDrag;
     bool mIsBackgroundWindow;
+    bool mLayered = false;
+    bool mLayerDirty = true;
+    /// Set while \ref draw() renders into the layer rather than compositing it
+    bool mRenderingLayer = false;
+    std::unique_ptr<Layer> mLayer;
+    ChromeCache mShadowChrome, mHeaderChrome;
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
@@ -212,6 +212,7 @@ PYBIND11_PLUGIN(nanogui) {
         m.def("chdir_to_bundle_parent", &nanogui::chdir_to_bundle_parent);
     #endif
     m.def("utf8", [](int c) { return std::string(utf8(c).data()); }, D(utf8));
+    m.def("listImageDirectory", &nanogui::listImageDirectory);
     m.def("loadImageDirectory", &nanogui::loadImageDirectory, D(loadImageDirectory));
 
     py::enum_<Cursor>(m, "Cursor", D(Cursor))
@@ -5,6 +5,7 @@
 DECLARE_WIDGET(ColorWheel);
 DECLARE_WIDGET(ColorPicker);
 DECLARE_WIDGET(Graph);
+DECLARE_WIDGET(LODGraph);
 DECLARE_WIDGET(ImageView);
 DECLARE_WIDGET(ImagePanel);
 
@@ -34,6 +35,14 @@ void register_misc(py::module &m) {
         .def("setHeader", &Graph::setHeader, D(Graph, setHeader))
         .def("footer", &Graph::footer, D(Graph, footer))
         .def("setFooter", &Graph::setFooter, D(Graph, setFooter))
+        .def("addSeries", &Graph::addSeries, py::arg("capacity"), py::arg("color"))
+        .def("clearSeries", &Graph::clearSeries)
+        .def("seriesCount", &Graph::seriesCount)
+        .def("setSeriesRange", &Graph::setSeriesRange, py::arg("series"), py::arg("min"), py::arg("max"))
+        .def("seriesSize", &Graph::seriesSize, py::arg("series"))
+        .def("push", (void (Graph::*)(int, float)) &Graph::push, py::arg("series"), py::arg("value"))
+        .def("gpuAccelerated", &Graph::gpuAccelerated)
+        .def("setGPUAccelerated", &Graph::setGPUAccelerated)
         .def("backgroundColor", &Graph::backgroundColor, D(Graph, backgroundColor))
         .def("setBackgroundColor", &Graph::setBackgroundColor, D(Graph, setBackgroundColor))
         .def("foregroundColor", &Graph::foregroundColor, D(Graph, foregroundColor))
@@ -43,7 +52,41 @@ void register_misc(py::module &m) {
         .def("values", (VectorXf &(Graph::*)(void)) &Graph::values, D(Graph, values))
         .def("setValues", &Graph::setValues, D(Graph, setValues));
 
-    py::class_<ImageView, Widget, ref<ImageView>, PyImageView>(m, "ImageView", D(ImageView))
+    py::class_<SampleSource, ref<SampleSource>>(m, "SampleSource")
+        .def("size", &SampleSource::size)
+        .def("refresh", &SampleSource::refresh);
+
+    py::class_<MemorySampleSource, SampleSource, ref<MemorySampleSource>>(m, "MemorySampleSource")
+        .def(py::init<>())
+        .def(py::init<std::vector<float>>(), py::arg("samples"))
+        .def("append", (void (MemorySampleSource::*)(float)) &MemorySampleSource::append,
+             py::arg("value"))
+        .def("append", [](MemorySampleSource &source, const std::vector<float> &values) {
+            source.append(values.data(), values.size());
+        }, py::arg("values"))
+        .def("samples", &MemorySampleSource::samples);
+
+    py::class_<MappedSampleSource, SampleSource, ref<MappedSampleSource>>(m, "MappedSampleSource")
+        .def(py::init<const std::string &>(), py::arg("filename"));
+
+    py::class_<LODGraph, Graph, ref<LODGraph>, PyLODGraph>(m, "LODGraph")
+        .def(py::init<Widget *, const std::string &>(), py::arg("parent"),
+             py::arg("caption") = std::string("Untitled"))
+        .def("source", (SampleSource *(LODGraph::*)(void)) &LODGraph::source)
+        .def("setSource", &LODGraph::setSource)
+        .def("range", &LODGraph::range)
+        .def("setRange", &LODGraph::setRange, py::arg("min"), py::arg("max"))
+        .def("view", &LODGraph::view)
+        .def("setView", &LODGraph::setView, py::arg("start"), py::arg("end"))
+        .def("resetView", &LODGraph::resetView)
+        .def("follow", &LODGraph::follow)
+        .def("setFollow", &LODGraph::setFollow)
+        .def("update", &LODGraph::update)
+        .def("complete", &LODGraph::complete)
+        .def("levelCount", &LODGraph::levelCount);
+
+    py::class_<ImageView, Widget, ref<ImageView>, PyImageView> imageView(m, "ImageView", D(ImageView));
+    imageView
         .def(py::init<Widget *, GLuint>(), D(ImageView, ImageView))
         .def("bindImage", &ImageView::bindImage, D(ImageView, bindImage))
         .def("imageShader", &ImageView::imageShader, D(ImageView, imageShader))
@@ -76,12 +119,42 @@ void register_misc(py::module &m) {
         .def("zoom", &ImageView::zoom, D(ImageView, zoom))
         .def("gridVisible", &ImageView::gridVisible, D(ImageView, gridVisible))
         .def("pixelInfoVisible", &ImageView::pixelInfoVisible, D(ImageView, pixelInfoVisible))
-        .def("helpersVisible", &ImageView::helpersVisible, D(ImageView, helpersVisible));
+        .def("helpersVisible", &ImageView::helpersVisible, D(ImageView, helpersVisible))
+        .def("exposure", &ImageView::exposure)
+        .def("setExposure", &ImageView::setExposure)
+        .def("gamma", &ImageView::gamma)
+        .def("setGamma", &ImageView::setGamma)
+        .def("channel", &ImageView::channel)
+        .def("setChannel", &ImageView::setChannel)
+        .def("falseColor", &ImageView::falseColor)
+        .def("setFalseColor", &ImageView::setFalseColor)
+        .def("autoExposure", &ImageView::autoExposure)
+        .def("setAutoExposure", &ImageView::setAutoExposure)
+        .def("setStatisticsCallback", &ImageView::setStatisticsCallback)
+        .def("statisticsCallback", &ImageView::statisticsCallback)
+        .def("requestStatistics", &ImageView::requestStatistics);
+
+    py::enum_<ImageView::Channel>(imageView, "Channel")
+        .value("RGB", ImageView::Channel::RGB)
+        .value("Red", ImageView::Channel::Red)
+        .value("Green", ImageView::Channel::Green)
+        .value("Blue", ImageView::Channel::Blue)
+        .value("Alpha", ImageView::Channel::Alpha)
+        .value("Luminance", ImageView::Channel::Luminance);
+
+    py::class_<ImageStatistics>(m, "ImageStatistics")
+        .def_readonly("minimum", &ImageStatistics::minimum)
+        .def_readonly("maximum", &ImageStatistics::maximum)
+        .def_readonly("mean", &ImageStatistics::mean)
+        .def_readonly("histogram", &ImageStatistics::histogram);
 
     py::class_<ImagePanel, Widget, ref<ImagePanel>, PyImagePanel>(m, "ImagePanel", D(ImagePanel))
         .def(py::init<Widget *>(), py::arg("parent"), D(ImagePanel, ImagePanel))
         .def("images", &ImagePanel::images, D(ImagePanel, images))
         .def("setImages", &ImagePanel::setImages, D(ImagePanel, setImages))
+        .def("loadDirectory", &ImagePanel::loadDirectory, py::arg("path"),
+             py::arg("cacheDirectory") = std::string())
+        .def("loading", &ImagePanel::loading)
         .def("callback", &ImagePanel::callback, D(ImagePanel, callback))
         .def("setCallback", &ImagePanel::setCallback, D(ImagePanel, setCallback));
 }
@@ -55,6 +55,7 @@ void register_widget(py::module &m) {
         .def("focused", &Widget::focused, D(Widget, focused))
         .def("setFocused", &Widget::setFocused, D(Widget, setFocused))
         .def("requestFocus", &Widget::requestFocus, D(Widget, requestFocus))
+        .def("markDirty", &Widget::markDirty)
         .def("tooltip", &Widget::tooltip, D(Widget, tooltip))
         .def("setTooltip", &Widget::setTooltip, D(Widget, setTooltip))
         .def("fontSize", &Widget::fontSize, D(Widget, fontSize))
@@ -92,7 +93,9 @@ void register_widget(py::module &m) {
         .def("setModal", &Window::setModal, D(Window, setModal))
         .def("dispose", &Window::dispose, D(Window, dispose))
         .def("buttonPanel", &Window::buttonPanel, D(Window, buttonPanel))
-        .def("center", &Window::center, D(Window, center));
+        .def("center", &Window::center, D(Window, center))
+        .def("layered", &Window::layered)
+        .def("setLayered", &Window::setLayered);
 
     py::class_<Screen, Widget, ref<Screen>, PyScreen>(m, "Screen", D(Screen))
         .def(py::init<const Vector2i &, const std::string &, bool, bool, int, int, int, int, int, unsigned int, unsigned int>(),
@@ -107,10 +110,14 @@ void register_widget(py::module &m) {
         .def("setSize", &Screen::setSize, D(Screen, setSize))
         .def("performLayout", (void(Screen::*)(void)) &Screen::performLayout, D(Screen, performLayout))
         .def("drawAll", &Screen::drawAll, D(Screen, drawAll))
+        .def("markLayersDirty", &Screen::markLayersDirty)
         .def("drawContents", &Screen::drawContents, D(Screen, drawContents))
         .def("resizeEvent", &Screen::resizeEvent, py::arg("size"), D(Screen, resizeEvent))
         .def("resizeCallback", &Screen::resizeCallback)
         .def("setResizeCallback", &Screen::setResizeCallback)
+        .def("setShortcut", &Screen::setShortcut, py::arg("key"), py::arg("modifiers"), py::arg("callback"))
+        .def("removeShortcut", &Screen::removeShortcut, py::arg("key"), py::arg("modifiers"))
+        .def("clearShortcuts", &Screen::clearShortcuts)
         .def("dropEvent", &Screen::dropEvent, D(Screen, dropEvent))
         .def("mousePos", &Screen::mousePos, D(Screen, mousePos))
         .def("pixelRatio", &Screen::pixelRatio, D(Screen, pixelRatio))
@@ -10,7 +10,9 @@
 */
 
 #include <nanogui/button.h>
+#include <nanogui/screen.h>
 #include <nanogui/theme.h>
+#include <nanogui/imageatlas.h>
 #include <nanogui/opengl.h>
 #include <nanogui/serializer/core.h>
 
@@ -24,22 +26,20 @@ Button::Button(Widget *parent, const std::string &caption, int icon)
 
 Vector2i Button::preferredSize(NVGcontext *ctx) const {
     int fontSize = mFontSize == -1 ? mTheme->prop("/button/text-size") : mFontSize;
-    nvgFontSize(ctx, fontSize);
-    nvgFontFace(ctx, "sans-bold");
+    mTheme->setFont(ctx, "sans-bold", fontSize);
     float tw = nvgTextBounds(ctx, 0,0, mCaption.c_str(), nullptr, nullptr);
     float iw = 0.0f, ih = fontSize;
 
     if (mIcon) {
         if (nvgIsFontIcon(mIcon)) {
             ih *= 1.5f;
-            nvgFontFace(ctx, "icons");
-            nvgFontSize(ctx, ih);
+            mTheme->setFont(ctx, "icons", ih);
             iw = nvgTextBounds(ctx, 0, 0, utf8(mIcon).data(), nullptr, nullptr)
                 + mSize.y() * 0.15f;
         } else {
             int w, h;
             ih *= 0.9f;
-            nvgImageSize(ctx, mIcon, &w, &h);
+            nvgIconSize(ctx, mIcon, &w, &h);
             iw = w * ih / h;
         }
     }
@@ -117,14 +117,9 @@ void Button::draw(NVGcontext *ctx) {
         gradBot = mTheme->get<Color>("/button/focused/grad-bot");
     }
 
-    nvgBeginPath(ctx);
-
-    nvgRoundedRect(ctx, mPos.x() + 1, mPos.y() + 1.0f, mSize.x() - 2,
-                   mSize.y() - 2, mTheme->get<int>("/button/corner-radius") - 1);
-
+    /* The background color is only drawn if it isn't transparent */
+    Color background(mBackgroundColor.head<3>(), mBackgroundColor.w() != 0 ? 1.f : 0.f);
     if (mBackgroundColor.w() != 0) {
-        nvgFillColor(ctx, Color(mBackgroundColor.head<3>(), 1.f));
-        nvgFill(ctx);
         if (mPushed) {
             gradTop.a = gradBot.a = 0.8f;
         } else {
@@ -133,28 +128,44 @@ void Button::draw(NVGcontext *ctx) {
         }
     }
 
-    NVGpaint bg = nvgLinearGradient(ctx, mPos.x(), mPos.y(), mPos.x(),
-                                    mPos.y() + mSize.y(), gradTop, gradBot);
+    int cr = mTheme->get<int>("/button/corner-radius");
+    Color borderLight = mTheme->get<Color>("/border/light");
+    Color borderDark = mTheme->get<Color>("/border/dark");
+    bool pushed = mPushed;
 
-    nvgFillPaint(ctx, bg);
-    nvgFill(ctx);
+    mTheme->drawChrome(ctx, mChrome, "button", { gradTop, gradBot, background, borderLight, borderDark },
+                       { (float) cr, (float) pushed }, mPos, mSize, Vector2i(cr + 2, 0),
+                       drawPixelRatio(),
+                       [=](NVGcontext *ctx, const Vector2i &size) {
+        nvgBeginPath(ctx);
 
-    nvgBeginPath(ctx);
-    nvgStrokeWidth(ctx, 1.0f);
-    nvgRoundedRect(ctx, mPos.x() + 0.5f, mPos.y() + (mPushed ? 0.5f : 1.5f), mSize.x() - 1,
-                   mSize.y() - 1 - (mPushed ? 0.0f : 1.0f), mTheme->get<int>("/button/corner-radius"));
-    nvgStrokeColor(ctx, mTheme->get<Color>("/border/light"));
-    nvgStroke(ctx);
+        nvgRoundedRect(ctx, 1, 1.0f, size.x() - 2, size.y() - 2, cr - 1);
+
+        if (background.w() != 0) {
+            nvgFillColor(ctx, background);
+            nvgFill(ctx);
+        }
 
-    nvgBeginPath(ctx);
-    nvgRoundedRect(ctx, mPos.x() + 0.5f, mPos.y() + 0.5f, mSize.x() - 1,
-                   mSize.y() - 2, mTheme->get<int>("/button/corner-radius"));
-    nvgStrokeColor(ctx, mTheme->get<Color>("/border/dark"));
-    nvgStroke(ctx);
+        NVGpaint bg = nvgLinearGradient(ctx, 0, 0, 0, size.y(), gradTop, gradBot);
+
+        nvgFillPaint(ctx, bg);
+        nvgFill(ctx);
+
+        nvgBeginPath(ctx);
+        nvgStrokeWidth(ctx, 1.0f);
+        nvgRoundedRect(ctx, 0.5f, pushed ? 0.5f : 1.5f, size.x() - 1,
+                       size.y() - 1 - (pushed ? 0.0f : 1.0f), cr);
+        nvgStrokeColor(ctx, borderLight);
+        nvgStroke(ctx);
+
+        nvgBeginPath(ctx);
+        nvgRoundedRect(ctx, 0.5f, 0.5f, size.x() - 1, size.y() - 2, cr);
+        nvgStrokeColor(ctx, borderDark);
+        nvgStroke(ctx);
+    });
 
     int fontSize = mFontSize == -1 ? mTheme->get<int>("/button/text-size") : mFontSize;
-    nvgFontSize(ctx, fontSize);
-    nvgFontFace(ctx, "sans-bold");
+    mTheme->setFont(ctx, "sans-bold", fontSize);
     float tw = nvgTextBounds(ctx, 0,0, mCaption.c_str(), nullptr, nullptr);
 
     Vector2f center = mPos.cast<float>() + mSize.cast<float>() * 0.5f;
@@ -164,19 +175,24 @@ void Button::draw(NVGcontext *ctx) {
     if (!mEnabled)
         textColor = mTheme->get<Color>("/disabled-text-color");
 
+    /* Release the image of a previous icon */
+    if (!mIcon || nvgIsFontIcon(mIcon))
+        mIconHandle.reset();
+
     if (mIcon) {
         auto icon = utf8(mIcon);
 
         float iw, ih = fontSize;
         if (nvgIsFontIcon(mIcon)) {
             ih *= 1.5f;
-            nvgFontSize(ctx, ih);
-            nvgFontFace(ctx, "icons");
+            mTheme->setFont(ctx, "icons", ih);
             iw = nvgTextBounds(ctx, 0, 0, icon.data(), nullptr, nullptr);
         } else {
+            if (mIconHandle.image() != mIcon)
+                mIconHandle = ImageCache::Handle(ctx, mIcon);
             int w, h;
             ih *= 0.9f;
-            nvgImageSize(ctx, mIcon, &w, &h);
+            nvgIconSize(ctx, mIcon, &w, &h);
             iw = w * ih / h;
         }
         if (mCaption != "")
@@ -201,16 +217,18 @@ void Button::draw(NVGcontext *ctx) {
         if (nvgIsFontIcon(mIcon)) {
             nvgText(ctx, iconPos.x(), iconPos.y()+1, icon.data(), nullptr);
         } else {
-            NVGpaint imgPaint = nvgImagePattern(ctx,
+            NVGpaint imgPaint = nvgIconPattern(ctx,
                     iconPos.x(), iconPos.y() - ih/2, iw, ih, 0, mIcon, mEnabled ? 0.5f : 0.25f);
 
+            /* Atlas icons share their texture, so only fill the icon's own rectangle */
+            nvgBeginPath(ctx);
+            nvgRect(ctx, iconPos.x(), iconPos.y() - ih/2, iw, ih);
             nvgFillPaint(ctx, imgPaint);
             nvgFill(ctx);
         }
     }
 
-    nvgFontSize(ctx, fontSize);
-    nvgFontFace(ctx, "sans-bold");
+    mTheme->setFont(ctx, "sans-bold", fontSize);
     nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_MIDDLE);
     nvgFillColor(ctx, mTheme->get<Color>("/shadow"));
     nvgText(ctx, textPos.x(), textPos.y(), mCaption.c_str(), nullptr);
@@ -47,8 +47,7 @@ bool CheckBox::mouseButtonEvent(const Vector2i &p, int button, bool down,
 Vector2i CheckBox::preferredSize(NVGcontext *ctx) const {
     if (mFixedSize != Vector2i::Zero())
         return mFixedSize;
-    nvgFontSize(ctx, fontSize());
-    nvgFontFace(ctx, "sans");
+    mTheme->setFont(ctx, "sans", fontSize());
     return Vector2i(
         nvgTextBounds(ctx, 0, 0, mCaption.c_str(), nullptr, nullptr) +
             1.8f * fontSize(),
@@ -58,8 +57,7 @@ Vector2i CheckBox::preferredSize(NVGcontext *ctx) const {
 void CheckBox::draw(NVGcontext *ctx) {
     Widget::draw(ctx);
 
-    nvgFontSize(ctx, fontSize());
-    nvgFontFace(ctx, "sans");
+    mTheme->setFont(ctx, "sans", fontSize());
     nvgFillColor(ctx,
                  mEnabled ? mTheme->get<Color>("/text-color") : mTheme->get<Color>("/disabled-text-color"));
     nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_MIDDLE);
@@ -78,8 +76,7 @@ void CheckBox::draw(NVGcontext *ctx) {
     nvgFill(ctx);
 
     if (mChecked) {
-        nvgFontSize(ctx, 1.8 * mSize.y());
-        nvgFontFace(ctx, "icons");
+        mTheme->setFont(ctx, "icons", 1.8 * mSize.y());
         nvgFillColor(ctx, mEnabled ? mTheme->get<Color>("/icon-color")
                                    : mTheme->get<Color>("/disabled-text-color"));
         nvgTextAlign(ctx, NVG_ALIGN_CENTER | NVG_ALIGN_MIDDLE);
@@ -12,29 +12,156 @@
 */
 
 #include <nanogui/colorwheel.h>
+#include <nanogui/imagecache.h>
+#include <nanogui/screen.h>
 #include <nanogui/theme.h>
 #include <nanogui/opengl.h>
 #include <nanogui/serializer/core.h>
-#include <Eigen/QR>
-#include <Eigen/Geometry>
+#include <limits>
 
 NAMESPACE_BEGIN(nanogui)
 
+namespace {
+    /// Antialiased coverage of a pixel whose center lies \c d pixels inside an edge
+    float coverage(float d) {
+        return std::min(std::max(d + 0.5f, 0.f), 1.f);
+    }
+
+    /// Composite a non-premultiplied color over an RGBA pixel
+    void blend(uint8_t *dst, float r, float g, float b, float a) {
+        float da = dst[3] / 255.f, oa = a + da * (1 - a);
+        if (oa <= 0)
+            return;
+        float src[3] = { r, g, b };
+        for (int i = 0; i < 3; ++i)
+            dst[i] = (uint8_t) std::round(
+                (src[i] * a + dst[i] / 255.f * da * (1 - a)) / oa * 255.f);
+        dst[3] = (uint8_t) std::round(oa * 255.f);
+    }
+}
+
 ColorWheel::ColorWheel(Widget *parent, const Color& rgb)
     : Widget(parent), mDragRegion(None) {
     setColor(rgb);
 }
 
+ColorWheel::~ColorWheel() {
+    /* The image went away along with its context if that is gone already */
+    if (mImage && ImageCache::find(mContext, mContextToken))
+        nvgDeleteImage(mContext, mImage);
+}
+
 Vector2i ColorWheel::preferredSize(NVGcontext *) const {
     return { 200., 200. };
 }
 
+void ColorWheel::updateImage(NVGcontext *ctx, float pixelRatio) {
+    int extent = std::min(mSize.x(), mSize.y());
+    int n = (int) std::ceil(extent * pixelRatio);
+    if (n <= 0)
+        return;
+    bool ringChanged = extent != mImageExtent || pixelRatio != mImageRatio;
+    if (mImage && !ringChanged && mHue == mImageHue)
+        return;
+
+    float c = extent * 0.5f, scale = 1.f / pixelRatio;
+    float r1 = c - 5.0f;
+    float r0 = r1 * .75f;
+
+    if (ringChanged) {
+        mRing.assign((size_t) n * n * 4, 0);
+        for (int y = 0; y < n; ++y) {
+            for (int x = 0; x < n; ++x) {
+                float px = (x + 0.5f) * scale - c, py = (y + 0.5f) * scale - c;
+                float mr = std::sqrt(px*px + py*py);
+                uint8_t *dst = mRing.data() + ((size_t) y * n + x) * 4;
+
+                float ring = coverage((mr - r0) * pixelRatio) *
+                             coverage((r1 - mr) * pixelRatio);
+                if (ring > 0) {
+                    NVGcolor hue = nvgHSLA(std::atan2(py, px) / (NVG_PI * 2),
+                                           1.0f, 0.55f, 255);
+                    blend(dst, hue.r, hue.g, hue.b, ring);
+                }
+
+                /* One pixel wide outline just outside of both edges */
+                float edge = std::min(std::abs(mr - (r0 - 0.5f)),
+                                      std::abs(mr - (r1 + 0.5f)));
+                float outline = coverage((0.5f - edge) * pixelRatio);
+                if (outline > 0)
+                    blend(dst, 0.f, 0.f, 0.f, outline * (64 / 255.f));
+            }
+        }
+    }
+
+    /* Triangle vertices: full hue, white and black, rotated by the hue */
+    float r = r0 - 6, angle = mHue * 2 * NVG_PI;
+    float cs = std::cos(angle), sn = std::sin(angle);
+    Vector2f v[3];
+    for (int i = 0; i < 3; ++i) {
+        float a = i * 120.0f / 180.0f * NVG_PI;
+        Vector2f p(std::cos(a) * r, std::sin(a) * r);
+        v[i] = Vector2f(cs * p.x() - sn * p.y(), sn * p.x() + cs * p.y());
+    }
+    Vector2f e[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+    float area = e[0].x() * (v[2] - v[0]).y() - e[0].y() * (v[2] - v[0]).x();
+    float orient = area < 0 ? -1.f : 1.f;
+    float len[3] = { e[0].norm(), e[1].norm(), e[2].norm() };
+    Color hueColor = hue2rgb(mHue);
+
+    mPixels = mRing;
+    int lo = std::max((int) std::floor((c - r - 1) * pixelRatio), 0),
+        hi = std::min((int) std::ceil((c + r + 1) * pixelRatio), n);
+    for (int y = lo; y < hi; ++y) {
+        for (int x = lo; x < hi; ++x) {
+            Vector2f p((x + 0.5f) * scale - c, (y + 0.5f) * scale - c);
+            float dist = std::numeric_limits<float>::infinity(), w[3];
+            for (int i = 0; i < 3; ++i) {
+                Vector2f d = p - v[i];
+                w[i] = orient * (e[i].x() * d.y() - e[i].y() * d.x());
+                dist = std::min(dist, w[i] / len[i]);
+            }
+            uint8_t *dst = mPixels.data() + ((size_t) y * n + x) * 4;
+
+            float inside = coverage(dist * pixelRatio);
+            if (inside > 0) {
+                /* Barycentric weights: edge i is opposite of vertex i + 2 */
+                float hueWeight = std::max(w[1], 0.f) / std::abs(area),
+                      white = std::max(w[2], 0.f) / std::abs(area);
+                hueWeight = std::min(hueWeight, 1.f);
+                white = std::min(white, 1.f - hueWeight);
+                Color rgb = hueColor * hueWeight + Color(1.f, 1.f, 1.f, 1.f) * white;
+                blend(dst, rgb.r(), rgb.g(), rgb.b(), inside);
+            }
+            float outline = coverage((0.5f - std::abs(dist)) * pixelRatio);
+            if (outline > 0)
+                blend(dst, 0.f, 0.f, 0.f, outline * (64 / 255.f));
+        }
+    }
+
+    bool alive = mImage && ImageCache::find(mContext, mContextToken);
+    if (alive && mContext == ctx && !ringChanged) {
+        nvgUpdateImage(ctx, mImage, mPixels.data());
+    } else {
+        if (alive)
+            nvgDeleteImage(mContext, mImage);
+        mContext = ctx;
+        mContextToken = ImageCache::get(ctx)->token();
+        mImage = nvgCreateImageRGBA(ctx, n, n, 0, mPixels.data());
+    }
+    mImageExtent = extent;
+    mImageRatio = pixelRatio;
+    mImageHue = mHue;
+}
+
 void ColorWheel::draw(NVGcontext *ctx) {
     Widget::draw(ctx);
 
     if (!mVisible)
         return;
 
+    updateImage(ctx, drawPixelRatio());
+
     float x = mPos.x(),
           y = mPos.y(),
           w = mSize.x(),
@@ -42,8 +169,7 @@ void ColorWheel::draw(NVGcontext *ctx) {
 
     NVGcontext* vg = ctx;
 
-    int i;
-    float r0, r1, ax,ay, bx,by, cx,cy, aeps, r;
+    float r0, r1, ax,ay, bx,by, cx,cy, r;
     float hue = mHue;
     NVGpaint paint;
 
@@ -54,32 +180,13 @@ void ColorWheel::draw(NVGcontext *ctx) {
     r1 = (w < h ? w : h) * 0.5f - 5.0f;
     r0 = r1 * .75f;
 
-    aeps = 0.5f / r1;   // half a pixel arc length in radians (2pi cancels out).
-
-    for (i = 0; i < 6; i++) {
-        float a0 = (float)i / 6.0f * NVG_PI * 2.0f - aeps;
-        float a1 = (float)(i+1.0f) / 6.0f * NVG_PI * 2.0f + aeps;
-        nvgBeginPath(vg);
-        nvgArc(vg, cx,cy, r0, a0, a1, NVG_CW);
-        nvgArc(vg, cx,cy, r1, a1, a0, NVG_CCW);
-        nvgClosePath(vg);
-        ax = cx + cosf(a0) * (r0+r1)*0.5f;
-        ay = cy + sinf(a0) * (r0+r1)*0.5f;
-        bx = cx + cosf(a1) * (r0+r1)*0.5f;
-        by = cy + sinf(a1) * (r0+r1)*0.5f;
-        paint = nvgLinearGradient(vg, ax, ay, bx, by,
-                                  nvgHSLA(a0 / (NVG_PI * 2), 1.0f, 0.55f, 255),
-                                  nvgHSLA(a1 / (NVG_PI * 2), 1.0f, 0.55f, 255));
-        nvgFillPaint(vg, paint);
-        nvgFill(vg);
-    }
-
+    // Cached ring and triangle
+    float extent = (float) mImageExtent;
     nvgBeginPath(vg);
-    nvgCircle(vg, cx,cy, r0-0.5f);
-    nvgCircle(vg, cx,cy, r1+0.5f);
-    nvgStrokeColor(vg, nvgRGBA(0,0,0,64));
-    nvgStrokeWidth(vg, 1.0f);
-    nvgStroke(vg);
+    nvgRect(vg, cx - extent*0.5f, cy - extent*0.5f, extent, extent);
+    nvgFillPaint(vg, nvgImagePattern(vg, cx - extent*0.5f, cy - extent*0.5f,
+                                     extent, extent, 0.f, mImage, 1.f));
+    nvgFill(vg);
 
     // Selector
     nvgSave(vg);
@@ -103,29 +210,12 @@ void ColorWheel::draw(NVGcontext *ctx) {
     nvgFillPaint(vg, paint);
     nvgFill(vg);
 
-    // Center triangle
+    // Select circle on triangle
     r = r0 - 6;
     ax = cosf(120.0f/180.0f*NVG_PI) * r;
     ay = sinf(120.0f/180.0f*NVG_PI) * r;
     bx = cosf(-120.0f/180.0f*NVG_PI) * r;
     by = sinf(-120.0f/180.0f*NVG_PI) * r;
-    nvgBeginPath(vg);
-    nvgMoveTo(vg, r,0);
-    nvgLineTo(vg, ax, ay);
-    nvgLineTo(vg, bx, by);
-    nvgClosePath(vg);
-    paint = nvgLinearGradient(vg, r, 0, ax, ay, nvgHSLA(hue, 1.0f, 0.5f, 255),
-                              nvgRGBA(255, 255, 255, 255));
-    nvgFillPaint(vg, paint);
-    nvgFill(vg);
-    paint = nvgLinearGradient(vg, (r + ax) * 0.5f, (0 + ay) * 0.5f, bx, by,
-                              nvgRGBA(0, 0, 0, 0), nvgRGBA(0, 0, 0, 255));
-    nvgFillPaint(vg, paint);
-    nvgFill(vg);
-    nvgStrokeColor(vg, nvgRGBA(0, 0, 0, 64));
-    nvgStroke(vg);
-
-    // Select circle on triangle
     float sx = r*(1 - mWhite - mBlack) + ax*mWhite + bx*mBlack;
     float sy =                           ay*mWhite + by*mBlack;
 
@@ -180,10 +270,10 @@ ColorWheel::Region ColorWheel::adjustPosition(const Vector2i &p, Region consider
         ((mr >= r0 && mr <= r1) || (consideredRegions == OuterCircle))) {
         if (!(consideredRegions & OuterCircle))
             return None;
-        mHue = std::atan(y / x);
-        if (x < 0)
-            mHue += NVG_PI;
-        mHue /= 2*NVG_PI;
+        /* Keep the hue in [-1/4, 3/4), which ColorPicker relies upon */
+        mHue = std::atan2(y, x) / (2*NVG_PI);
+        if (mHue < -0.25f)
+            mHue += 1.f;
 
         if (mCallback)
             mCallback(color());
@@ -191,27 +281,22 @@ ColorWheel::Region ColorWheel::adjustPosition(const Vector2i &p, Region consider
         return OuterCircle;
     }
 
+    /* Barycentric coordinates with respect to the white and black vertices
+       of the rotated triangle, whose hue vertex lies at (r, 0) */
     float r = r0 - 6;
-
-    float ax = std::cos( 120.0f/180.0f*NVG_PI) * r;
+    float angle = mHue * 2 * NVG_PI;
+    float cs = std::cos(angle), sn = std::sin(angle);
+    float px =  cs * x + sn * y - r,
+          py = -sn * x + cs * y;
+    float ax = std::cos( 120.0f/180.0f*NVG_PI) * r - r;
     float ay = std::sin( 120.0f/180.0f*NVG_PI) * r;
-    float bx = std::cos(-120.0f/180.0f*NVG_PI) * r;
+    float bx = std::cos(-120.0f/180.0f*NVG_PI) * r - r;
     float by = std::sin(-120.0f/180.0f*NVG_PI) * r;
+    float det = ax * by - bx * ay;
 
-    typedef Eigen::Matrix<float,2,2>        Matrix2f;
-
-    Eigen::Matrix<float, 2, 3> triangle;
-    triangle << ax,bx,r,
-                ay,by,0;
-    triangle = Eigen::Rotation2D<float>(mHue * 2 * NVG_PI).matrix() * triangle;
-
-    Matrix2f T;
-    T << triangle(0,0) - triangle(0,2), triangle(0,1) - triangle(0,2),
-         triangle(1,0) - triangle(1,2), triangle(1,1) - triangle(1,2);
-    Vector2f pos { x - triangle(0,2), y - triangle(1,2) };
-
-    Vector2f bary = T.colPivHouseholderQr().solve(pos);
-    float l0 = bary[0], l1 = bary[1], l2 = 1 - l0 - l1;
+    float l0 = (by * px - bx * py) / det,
+          l1 = (ax * py - ay * px) / det,
+          l2 = 1 - l0 - l1;
     bool triangleTest = l0 >= 0 && l0 <= 1.f && l1 >= 0.f && l1 <= 1.f &&
                         l2 >= 0.f && l2 <= 1.f;
 
@@ -289,17 +374,16 @@ void ColorWheel::setColor(const Color &rgb) {
 
         mHue = h;
 
-        Eigen::Matrix<float, 4, 3> M;
-        M.topLeftCorner<3, 1>() = hue2rgb(h).head<3>();
-        M(3, 0) = 1.;
-        M.col(1) = Vector4f{ 0., 0., 0., 1. };
-        M.col(2) = Vector4f{ 1., 1., 1., 1. };
-
-        Vector4f rgb4{ rgb[0], rgb[1], rgb[2], 1. };
-        Vector3f bary = M.colPivHouseholderQr().solve(rgb4);
+        /* Least-squares weights of the hue and white corners (black is zero),
+           the black weight makes all three sum up to one */
+        Vector3f hue = hue2rgb(h).head<3>(), c = rgb.head<3>();
+        float hh = hue.dot(hue), h1 = hue.sum(), hc = hue.dot(c), c1 = c.sum();
+        float det = 3 * hh - h1 * h1;
+        float hueWeight = (3 * hc - h1 * c1) / det,
+              white = (hh * c1 - h1 * hc) / det;
 
-        mBlack = bary[1];
-        mWhite = bary[2];
+        mBlack = 1 - hueWeight - white;
+        mWhite = white;
     }
 }
 
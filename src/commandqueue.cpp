@@ -0,0 +1,84 @@
+/*
+    src/commandqueue.cpp -- Lock-free queue used to marshal work from
+    arbitrary threads onto the GUI thread
+
+    NanoGUI was developed by Wenzel Jakob <wenzel.jakob@epfl.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/commandqueue.h>
+#include <algorithm>
+#include <iostream>
+
+NAMESPACE_BEGIN(nanogui)
+
+CommandQueue::~CommandQueue() {
+    Node *node = mHead.exchange(nullptr, std::memory_order_acquire);
+    while (node) {
+        Node *next = node->next;
+        delete node;
+        node = next;
+    }
+}
+
+bool CommandQueue::push(const void *target, int slot, Command command) {
+    Node *node = new Node { mHead.load(std::memory_order_relaxed), target, slot,
+                            std::move(command) };
+    while (!mHead.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                        std::memory_order_relaxed))
+        ;
+    return node->next == nullptr;
+}
+
+size_t CommandQueue::process() {
+    /* Detach all pending commands at once. They are linked newest first. */
+    Node *node = mHead.exchange(nullptr, std::memory_order_acquire);
+    if (!node)
+        return 0;
+
+    mBatch.clear();
+    mKeys.clear();
+    for (; node; node = node->next)
+        mBatch.push_back(node);
+    std::reverse(mBatch.begin(), mBatch.end());
+
+    /* Only the latest command of every target/slot pair survives */
+    for (size_t i = 0; i < mBatch.size(); ++i) {
+        if (mBatch[i]->target)
+            mKeys.push_back(Key { mBatch[i]->target, mBatch[i]->slot, i });
+    }
+    if (mKeys.size() > 1) {
+        std::sort(mKeys.begin(), mKeys.end(), [](const Key &a, const Key &b) {
+            if (a.target != b.target)
+                return std::less<const void *>()(a.target, b.target);
+            if (a.slot != b.slot)
+                return a.slot < b.slot;
+            return a.index < b.index;
+        });
+        for (size_t i = 0; i + 1 < mKeys.size(); ++i) {
+            if (mKeys[i].target == mKeys[i + 1].target && mKeys[i].slot == mKeys[i + 1].slot)
+                mBatch[mKeys[i].index]->command = nullptr;
+        }
+    }
+
+    size_t count = 0;
+    for (Node *n : mBatch) {
+        if (n->command) {
+            try {
+                n->command();
+            } catch (const std::exception &e) {
+                std::cerr << "Caught exception in queued command: " << e.what() << std::endl;
+            }
+            count++;
+        }
+        delete n;
+    }
+    mBatch.clear();
+    return count;
+}
+
+NAMESPACE_END(nanogui)
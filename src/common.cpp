@@ -10,6 +10,7 @@
 */
 
 #include <nanogui/screen.h>
+#include <nanogui/imagecache.h>
 
 #if defined(_WIN32)
 #include <windows.h>
@@ -19,7 +20,16 @@
 #include <map>
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cctype>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
 #include <iostream>
+#include <memory>
+#include <mutex>
 
 #if !defined(_WIN32)
     #include <locale.h>
@@ -60,6 +70,102 @@ void init() {
 }
 
 static bool mainloop_active = false;
+/* Read by drawing threads when widgets are removed */
+static std::atomic<bool> parallel_drawing(false);
+
+namespace {
+    /// Releases the OpenGL context of the calling thread, even if drawing fails
+    struct ContextRelease {
+        ~ContextRelease() { glfwMakeContextCurrent(nullptr); }
+    };
+
+    /// Threads that render screens in parallel, with the calling thread helping out
+    class FramePool {
+    public:
+        ~FramePool() {
+            {
+                std::lock_guard<std::mutex> guard(mMutex);
+                mShutdown = true;
+            }
+            mWake.notify_all();
+            for (auto &thread : mThreads)
+                thread.join();
+        }
+
+        /// Call \c func for all indices in <tt>[0, count)</tt> and wait for completion
+        void run(size_t count, const std::function<void(size_t)> &func) {
+            size_t workers = std::min(count, (size_t) std::max(1u, std::thread::hardware_concurrency())) - 1;
+            while (mThreads.size() < workers)
+                mThreads.emplace_back([this]() { workerLoop(); });
+
+            {
+                std::lock_guard<std::mutex> guard(mMutex);
+                mFunc = &func;
+                mCount = count;
+                mNext = 0;
+                mPending = count;
+                mError = nullptr;
+                mJob++;
+            }
+            mWake.notify_all();
+            work();
+
+            std::unique_lock<std::mutex> lock(mMutex);
+            mDone.wait(lock, [this]() { return mPending == 0; });
+            mFunc = nullptr;
+            if (mError)
+                std::rethrow_exception(mError);
+        }
+
+    private:
+        void workerLoop() {
+            size_t job = 0;
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(mMutex);
+                    mWake.wait(lock, [&]() { return mShutdown || mJob != job; });
+                    if (mShutdown)
+                        return;
+                    job = mJob;
+                }
+                work();
+            }
+        }
+
+        void work() {
+            while (true) {
+                size_t index;
+                const std::function<void(size_t)> *func;
+                {
+                    std::lock_guard<std::mutex> guard(mMutex);
+                    if (mNext >= mCount)
+                        return;
+                    index = mNext++;
+                    func = mFunc;
+                }
+                std::exception_ptr error;
+                try {
+                    (*func)(index);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                std::lock_guard<std::mutex> guard(mMutex);
+                if (error && !mError)
+                    mError = error;
+                if (--mPending == 0)
+                    mDone.notify_all();
+            }
+        }
+
+        std::vector<std::thread> mThreads;
+        std::mutex mMutex;
+        std::condition_variable mWake, mDone;
+        const std::function<void(size_t)> *mFunc = nullptr;
+        size_t mCount = 0, mNext = 0, mPending = 0, mJob = 0;
+        std::exception_ptr mError;
+        bool mShutdown = false;
+    };
+}
 
 void mainloop(int refresh) {
     if (mainloop_active)
@@ -86,9 +192,18 @@ void mainloop(int refresh) {
         );
     }
 
+    std::unique_ptr<FramePool> pool;
+    std::vector<Screen *> screens, deferred;
+    std::function<void(size_t)> render = [&deferred](size_t i) {
+        /* Release the context so that the main thread can swap */
+        ContextRelease release;
+        deferred[i]->renderFrame();
+    };
+
     try {
         while (mainloop_active) {
-            int numScreens = 0;
+            screens.clear();
+            int swapInterval = 0;
             for (auto kv : __nanogui_screens) {
                 Screen *screen = kv.second;
                 if (!screen->visible()) {
@@ -97,11 +212,46 @@ void mainloop(int refresh) {
                     screen->setVisible(false);
                     continue;
                 }
-                screen->drawAll();
-                numScreens++;
+                screens.push_back(screen);
+                swapInterval = std::max(swapInterval, screen->swapInterval());
             }
 
-            if (numScreens == 0) {
+            /* Only the last buffer swap of every iteration waits for the
+               vertical blank, instead of one wait per screen */
+            for (size_t i = 0; i < screens.size(); ++i)
+                screens[i]->mFrameSwapInterval = i + 1 == screens.size() ? swapInterval : 0;
+
+            if (parallel_drawing && screens.size() > 1) {
+                if (!pool)
+                    pool.reset(new FramePool());
+                /* Overrides of drawAll() still run; screens whose override
+                   doesn't reach Screen::drawAll() are drawn by it directly */
+                deferred.clear();
+                for (Screen *screen : screens) {
+                    screen->mDeferFrame = true;
+                    screen->mFrameDeferred = false;
+                    screen->drawAll();
+                    screen->mDeferFrame = false;
+                    /* Screen::drawAll() released the context, an override
+                       that draws after calling it would use it again */
+                    assert(!screen->mFrameDeferred || !glfwGetCurrentContext());
+                    if (screen->mFrameDeferred)
+                        deferred.push_back(screen);
+                }
+                glfwMakeContextCurrent(nullptr);
+                if (!deferred.empty())
+                    pool->run(deferred.size(), render);
+                for (Screen *screen : deferred)
+                    screen->presentFrame();
+            } else {
+                for (Screen *screen : screens)
+                    screen->drawAll();
+            }
+
+            for (Screen *screen : screens)
+                screen->mFrameSwapInterval = -1;
+
+            if (screens.empty()) {
                 /* Give up if there was nothing to draw */
                 mainloop_active = false;
                 break;
@@ -114,6 +264,8 @@ void mainloop(int refresh) {
         /* Process events once more */
         glfwPollEvents();
     } catch (const std::exception &e) {
+        for (Screen *screen : screens)
+            screen->mDeferFrame = false;
         std::cerr << "Caught exception in main loop: " << e.what() << std::endl;
         leave();
     }
@@ -122,6 +274,14 @@ void mainloop(int refresh) {
         refresh_thread.join();
 }
 
+void setParallelDrawing(bool parallel) {
+    parallel_drawing = parallel;
+}
+
+bool parallelDrawing() {
+    return parallel_drawing;
+}
+
 void leave() {
     mainloop_active = false;
 }
@@ -155,21 +315,21 @@ std::array<char, 8> utf8(int c) {
     return seq;
 }
 
-int __nanogui_get_image(NVGcontext *ctx, const std::string &name, uint8_t *data, uint32_t size) {
-    static std::map<std::string, int> iconCache;
-    auto it = iconCache.find(name);
-    if (it != iconCache.end())
-        return it->second;
-    int iconID = nvgCreateImageMem(ctx, 0, data, size);
-    if (iconID == 0)
-        throw std::runtime_error("Unable to load resource data.");
-    iconCache[name] = iconID;
-    return iconID;
+int __nanogui_get_image(NVGcontext *ctx, const std::string &name, uint8_t *data, uint32_t size, bool pack) {
+    /* The first lookup keeps a reference, so icons stay resident for the
+       lifetime of the context without accumulating further references */
+    ImageCache *cache = ImageCache::get(ctx);
+    std::string key = (pack ? "atlas-icon:" : "icon:") + name;
+    int iconID = cache->acquire(key);
+    if (iconID) {
+        cache->release(iconID);
+        return iconID;
+    }
+    return cache->acquire(key, data, size, 0, pack);
 }
 
-std::vector<std::pair<int, std::string>>
-loadImageDirectory(NVGcontext *ctx, const std::string &path) {
-    std::vector<std::pair<int, std::string> > result;
+std::vector<std::string> listImageDirectory(const std::string &path) {
+    std::vector<std::string> result;
 #if !defined(_WIN32)
     DIR *dp = opendir(path.c_str());
     if (!dp)
@@ -186,14 +346,13 @@ loadImageDirectory(NVGcontext *ctx, const std::string &path) {
     do {
         const char *fname = ffd.cFileName;
 #endif
-        if (strstr(fname, "png") == nullptr)
+        size_t length = strlen(fname);
+        if (length <= 4 || fname[length - 4] != '.' ||
+            tolower((unsigned char) fname[length - 3]) != 'p' ||
+            tolower((unsigned char) fname[length - 2]) != 'n' ||
+            tolower((unsigned char) fname[length - 1]) != 'g')
             continue;
-        std::string fullName = path + "/" + std::string(fname);
-        int img = nvgCreateImage(ctx, fullName.c_str(), 0);
-        if (img == 0)
-            throw std::runtime_error("Could not open image data!");
-        result.push_back(
-            std::make_pair(img, fullName.substr(0, fullName.length() - 4)));
+        result.push_back(path + "/" + std::string(fname));
 #if !defined(_WIN32)
     }
     closedir(dp);
@@ -204,6 +363,19 @@ loadImageDirectory(NVGcontext *ctx, const std::string &path) {
     return result;
 }
 
+std::vector<std::pair<int, std::string>>
+loadImageDirectory(NVGcontext *ctx, const std::string &path) {
+    std::vector<std::pair<int, std::string> > result;
+    for (const std::string &fullName : listImageDirectory(path)) {
+        int img = nvgCreateImage(ctx, fullName.c_str(), 0);
+        if (img == 0)
+            throw std::runtime_error("Could not open image data!");
+        result.push_back(
+            std::make_pair(img, fullName.substr(0, fullName.length() - 4)));
+    }
+    return result;
+}
+
 #if !defined(__APPLE__)
 std::string file_dialog(const std::vector<std::pair<std::string, std::string>> &filetypes, bool save) {
 #define FILE_DIALOG_MAX_BUFFER 1024
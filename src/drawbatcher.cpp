@@ -0,0 +1,496 @@
+/*
+    src/drawbatcher.cpp -- Merges the draw calls of a NanoVG context
+    before they reach its backend
+
+    NanoGUI was developed by Wenzel Jakob <wenzel.jakob@epfl.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/drawbatcher.h>
+#include <nanovg.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+NAMESPACE_BEGIN(nanogui)
+
+namespace {
+    /// Size of the cells (in logical pixels) used to find overlapping calls
+    const float cellSize = 32.f;
+
+    /// Queued triangles are merged when they share all of these
+    struct BatchKey {
+        int image;
+        NVGcolor color;
+        NVGcompositeOperationState composite;
+
+        bool operator==(const BatchKey &other) const {
+            return memcmp(this, &other, sizeof(BatchKey)) == 0;
+        }
+    };
+
+    struct Batch {
+        BatchKey key;
+        std::vector<NVGvertex> verts;
+    };
+
+    /// Area covered by a queued call
+    struct Item {
+        float bounds[4];
+        int batch;
+    };
+
+    struct Cell {
+        uint32_t epoch = 0;
+        /// Queued items that touch this cell
+        std::vector<int> items;
+    };
+
+    bool onPixelGrid(float value, float pixelRatio) {
+        float scaled = value * pixelRatio;
+        return std::abs(scaled - std::round(scaled)) < 1e-3f;
+    }
+
+    NVGvertex lerp(const NVGvertex &a, const NVGvertex &b, float t) {
+        return NVGvertex { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t,
+                           a.u + (b.u - a.u) * t, a.v + (b.v - a.v) * t };
+    }
+
+    /// Clip a triangle against an axis-aligned rectangle and append the result
+    void clipTriangle(const NVGvertex *tri, const float *rect, std::vector<NVGvertex> &out) {
+        float minX = std::min({ tri[0].x, tri[1].x, tri[2].x }),
+              maxX = std::max({ tri[0].x, tri[1].x, tri[2].x }),
+              minY = std::min({ tri[0].y, tri[1].y, tri[2].y }),
+              maxY = std::max({ tri[0].y, tri[1].y, tri[2].y });
+        if (minX >= rect[2] || maxX <= rect[0] || minY >= rect[3] || maxY <= rect[1])
+            return;
+        if (minX >= rect[0] && maxX <= rect[2] && minY >= rect[1] && maxY <= rect[3]) {
+            out.insert(out.end(), tri, tri + 3);
+            return;
+        }
+
+        /* Sutherland-Hodgman against the four edges; each one adds at most a vertex */
+        NVGvertex buf[2][7];
+        int count = 3;
+        std::copy(tri, tri + 3, buf[0]);
+        for (int edge = 0; edge < 4 && count > 0; ++edge) {
+            const NVGvertex *in = buf[edge % 2];
+            NVGvertex *result = buf[(edge + 1) % 2];
+            int axis = edge % 2;
+            float bound = rect[edge], sign = edge < 2 ? 1.f : -1.f;
+            auto distance = [&](const NVGvertex &p) {
+                return ((axis == 0 ? p.x : p.y) - bound) * sign;
+            };
+            int n = 0;
+            for (int i = 0; i < count; ++i) {
+                const NVGvertex &a = in[i], &b = in[(i + 1) % count];
+                float da = distance(a), db = distance(b);
+                if (da >= 0)
+                    result[n++] = a;
+                if ((da >= 0) != (db >= 0))
+                    result[n++] = lerp(a, b, da / (da - db));
+            }
+            count = n;
+        }
+        const NVGvertex *poly = buf[0];
+        for (int i = 1; i + 1 < count; ++i) {
+            out.push_back(poly[0]);
+            out.push_back(poly[i]);
+            out.push_back(poly[i + 1]);
+        }
+    }
+
+    struct DrawBatcher {
+        /// Callbacks of the wrapped backend
+        NVGparams params;
+        bool enabled = true;
+        float pixelRatio = 1.f;
+        int gridWidth = 0, gridHeight = 0;
+        std::vector<Cell> grid;
+        /// Cells written before the last flush are stale
+        uint32_t epoch = 1;
+        std::vector<Item> items;
+        /// Queued batches in drawing order; only the first \c batchCount are in use
+        std::vector<Batch> batches;
+        size_t batchCount = 0;
+        /// Flags of the textures created through the wrapped backend
+        std::unordered_map<int, int> imageFlags;
+        /// Opaque white texel for drawing solid colors as textured triangles
+        int whiteImage = 0;
+        std::vector<NVGvertex> scratch;
+
+        void cellRange(const float *bounds, int *range) const {
+            float maxX = (float) (gridWidth - 1), maxY = (float) (gridHeight - 1);
+            range[0] = (int) std::min(std::max(std::floor(bounds[0] / cellSize), 0.f), maxX);
+            range[1] = (int) std::min(std::max(std::floor(bounds[1] / cellSize), 0.f), maxY);
+            range[2] = (int) std::min(std::max(std::floor(bounds[2] / cellSize), 0.f), maxX);
+            range[3] = (int) std::min(std::max(std::floor(bounds[3] / cellSize), 0.f), maxY);
+        }
+
+        /// Index of the last queued batch that may draw into \c bounds, or -1
+        int lastOverlap(const float *bounds) const {
+            if (batchCount == 0 || bounds[0] > bounds[2] || bounds[1] > bounds[3])
+                return -1;
+            int range[4], result = -1;
+            cellRange(bounds, range);
+            for (int y = range[1]; y <= range[3]; ++y) {
+                for (int x = range[0]; x <= range[2]; ++x) {
+                    const Cell &cell = grid[y * gridWidth + x];
+                    if (cell.epoch != epoch)
+                        continue;
+                    for (int index : cell.items) {
+                        const Item &item = items[index];
+                        if (item.batch > result &&
+                            item.bounds[0] < bounds[2] && bounds[0] < item.bounds[2] &&
+                            item.bounds[1] < bounds[3] && bounds[1] < item.bounds[3])
+                            result = item.batch;
+                    }
+                }
+            }
+            return result;
+        }
+
+        /// Queue the triangles in \c scratch, which cover \c bounds
+        void queue(const BatchKey &key, const float *bounds) {
+            if (scratch.empty())
+                return;
+            int first = std::max(lastOverlap(bounds), 0), target = -1;
+            for (int i = (int) batchCount - 1; i >= first; --i) {
+                if (batches[i].key == key) {
+                    target = i;
+                    break;
+                }
+            }
+            if (target < 0) {
+                if (batchCount == batches.size())
+                    batches.emplace_back();
+                target = (int) batchCount++;
+                batches[target].key = key;
+                batches[target].verts.clear();
+            }
+            std::vector<NVGvertex> &verts = batches[target].verts;
+            verts.insert(verts.end(), scratch.begin(), scratch.end());
+
+            int range[4], index = (int) items.size();
+            items.push_back(Item { { bounds[0], bounds[1], bounds[2], bounds[3] }, target });
+            cellRange(bounds, range);
+            for (int y = range[1]; y <= range[3]; ++y) {
+                for (int x = range[0]; x <= range[2]; ++x) {
+                    Cell &cell = grid[y * gridWidth + x];
+                    if (cell.epoch != epoch) {
+                        cell.items.clear();
+                        cell.epoch = epoch;
+                    }
+                    cell.items.push_back(index);
+                }
+            }
+        }
+
+        /// Pass the queued batches on to the backend
+        void flush() {
+            NVGscissor scissor;
+            memset(&scissor, 0, sizeof(NVGscissor));
+            scissor.extent[0] = scissor.extent[1] = -1.f;
+            for (size_t i = 0; i < batchCount; ++i) {
+                const Batch &batch = batches[i];
+                NVGpaint paint;
+                memset(&paint, 0, sizeof(NVGpaint));
+                nvgTransformIdentity(paint.xform);
+                paint.extent[0] = paint.extent[1] = 1.f;
+                paint.feather = 1.f;
+                paint.innerColor = paint.outerColor = batch.key.color;
+                paint.image = batch.key.image;
+                params.renderTriangles(params.userPtr, &paint, batch.key.composite, &scissor,
+                                       batch.verts.data(), (int) batch.verts.size());
+            }
+            discard();
+        }
+
+        void discard() {
+            batchCount = 0;
+            items.clear();
+            ++epoch;
+        }
+
+        /// Flush first if a call that cannot be queued would draw over queued batches
+        void barrier(const float *bounds) {
+            if (lastOverlap(bounds) >= 0)
+                flush();
+        }
+
+        /// Scissor rectangle in logical pixels if it can be applied on the CPU
+        bool clipRect(const NVGscissor *scissor, float *rect) const {
+            if (scissor->extent[0] < -0.5f) {
+                rect[0] = rect[1] = -std::numeric_limits<float>::max();
+                rect[2] = rect[3] = std::numeric_limits<float>::max();
+                return true;
+            }
+            const float *xf = scissor->xform;
+            if (xf[1] != 0.f || xf[2] != 0.f)
+                return false;
+            float hx = scissor->extent[0] * std::abs(xf[0]),
+                  hy = scissor->extent[1] * std::abs(xf[3]);
+            rect[0] = xf[4] - hx; rect[1] = xf[5] - hy;
+            rect[2] = xf[4] + hx; rect[3] = xf[5] + hy;
+            /* The shader fades the scissor out over a pixel; on pixel
+               boundaries this is the same as a hard clip */
+            for (int i = 0; i < 4; ++i)
+                if (!onPixelGrid(rect[i], pixelRatio))
+                    return false;
+            return true;
+        }
+
+        /// Queue a fill of a rectangle with a solid color or an image, if possible
+        bool fillRect(const NVGpaint *paint, NVGcompositeOperationState composite,
+                      const NVGscissor *scissor, float fringe, const NVGpath *paths, int npaths) {
+            if (npaths != 1 || !paths[0].convex || paths[0].nfill != 4)
+                return false;
+
+            int image = paint->image, flags = 0;
+            if (image == 0) {
+                if (memcmp(&paint->innerColor, &paint->outerColor, sizeof(NVGcolor)) != 0)
+                    return false;
+                if (whiteImage == 0) {
+                    const unsigned char white[4] = { 255, 255, 255, 255 };
+                    whiteImage = params.renderCreateTexture(params.userPtr, NVG_TEXTURE_RGBA, 1, 1,
+                                                            NVG_IMAGE_PREMULTIPLIED, white);
+                    if (whiteImage == 0)
+                        return false;
+                }
+            } else {
+                auto it = imageFlags.find(image);
+                if (it == imageFlags.end())
+                    return false;
+                flags = it->second;
+            }
+
+            const NVGvertex *v = paths[0].fill;
+            float rect[4] = { v[0].x, v[0].y, v[0].x, v[0].y };
+            for (int i = 1; i < 4; ++i) {
+                rect[0] = std::min(rect[0], v[i].x); rect[1] = std::min(rect[1], v[i].y);
+                rect[2] = std::max(rect[2], v[i].x); rect[3] = std::max(rect[3], v[i].y);
+            }
+            for (int i = 0; i < 4; ++i) {
+                bool cornerX = std::abs(v[i].x - rect[0]) < 1e-4f || std::abs(v[i].x - rect[2]) < 1e-4f,
+                     cornerY = std::abs(v[i].y - rect[1]) < 1e-4f || std::abs(v[i].y - rect[3]) < 1e-4f;
+                if (!cornerX || !cornerY)
+                    return false;
+            }
+            if (paths[0].nstroke > 0) {
+                /* Antialiased fill: the interior is inset by half the fringe,
+                   which fades out to nothing across the pixel boundary */
+                float inset = fringe * 0.5f;
+                rect[0] -= inset; rect[1] -= inset;
+                rect[2] += inset; rect[3] += inset;
+                for (int i = 0; i < 4; ++i)
+                    if (!onPixelGrid(rect[i], pixelRatio))
+                        return false;
+            }
+
+            float clip[4];
+            if (!clipRect(scissor, clip))
+                return false;
+            rect[0] = std::max(rect[0], clip[0]); rect[1] = std::max(rect[1], clip[1]);
+            rect[2] = std::min(rect[2], clip[2]); rect[3] = std::min(rect[3], clip[3]);
+            if (rect[0] >= rect[2] || rect[1] >= rect[3])
+                return true;
+
+            float inv[6];
+            nvgTransformInverse(inv, paint->xform);
+            auto vertex = [&](float x, float y) {
+                NVGvertex result { x, y, 0.5f, 0.5f };
+                if (image != 0) {
+                    result.u = (inv[0] * x + inv[2] * y + inv[4]) / paint->extent[0];
+                    result.v = (inv[1] * x + inv[3] * y + inv[5]) / paint->extent[1];
+                    if (flags & NVG_IMAGE_FLIPY)
+                        result.v = 1.f - result.v;
+                }
+                return result;
+            };
+            NVGvertex tl = vertex(rect[0], rect[1]), tr = vertex(rect[2], rect[1]),
+                      bl = vertex(rect[0], rect[3]), br = vertex(rect[2], rect[3]);
+            /* Same winding as the glyph quads of NanoVG */
+            scratch.assign({ tl, br, tr, tl, bl, br });
+            queue(BatchKey { image != 0 ? image : whiteImage, paint->innerColor, composite }, rect);
+            return true;
+        }
+
+        /// Queue triangles that sample an image (i.e. text), if possible
+        bool triangles(const NVGpaint *paint, NVGcompositeOperationState composite,
+                       const NVGscissor *scissor, const NVGvertex *verts, int nverts) {
+            float clip[4];
+            if (paint->image == 0 || nverts < 3 || !clipRect(scissor, clip))
+                return false;
+            scratch.clear();
+            for (int i = 0; i + 2 < nverts; i += 3)
+                clipTriangle(verts + i, clip, scratch);
+            float bounds[4] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                                -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+            for (const NVGvertex &vertex : scratch) {
+                bounds[0] = std::min(bounds[0], vertex.x); bounds[1] = std::min(bounds[1], vertex.y);
+                bounds[2] = std::max(bounds[2], vertex.x); bounds[3] = std::max(bounds[3], vertex.y);
+            }
+            queue(BatchKey { paint->image, paint->innerColor, composite }, bounds);
+            return true;
+        }
+    };
+
+    std::mutex registryMutex;
+    /// Installed batchers, keyed by the user pointer of the wrapped backend
+    std::unordered_map<void *, DrawBatcher *> registry;
+    std::atomic<uint64_t> registryVersion(1);
+
+    DrawBatcher *lookup(void *uptr) {
+        thread_local void *cachedPtr = nullptr;
+        thread_local DrawBatcher *cached = nullptr;
+        thread_local uint64_t cachedVersion = 0;
+        uint64_t version = registryVersion.load(std::memory_order_acquire);
+        if (uptr != cachedPtr || version != cachedVersion) {
+            std::lock_guard<std::mutex> guard(registryMutex);
+            cached = registry.at(uptr);
+            cachedPtr = uptr;
+            cachedVersion = registryVersion.load(std::memory_order_relaxed);
+        }
+        return cached;
+    }
+
+    void bounds(const NVGvertex *verts, int nverts, float *result) {
+        for (int i = 0; i < nverts; ++i) {
+            result[0] = std::min(result[0], verts[i].x); result[1] = std::min(result[1], verts[i].y);
+            result[2] = std::max(result[2], verts[i].x); result[3] = std::max(result[3], verts[i].y);
+        }
+    }
+
+    int batchCreateTexture(void *uptr, int type, int w, int h, int imageFlags, const unsigned char *data) {
+        DrawBatcher *batcher = lookup(uptr);
+        int image = batcher->params.renderCreateTexture(uptr, type, w, h, imageFlags, data);
+        if (image != 0)
+            batcher->imageFlags[image] = imageFlags;
+        return image;
+    }
+
+    int batchDeleteTexture(void *uptr, int image) {
+        DrawBatcher *batcher = lookup(uptr);
+        batcher->imageFlags.erase(image);
+        return batcher->params.renderDeleteTexture(uptr, image);
+    }
+
+    void batchViewport(void *uptr, float width, float height, float devicePixelRatio) {
+        DrawBatcher *batcher = lookup(uptr);
+        batcher->discard();
+        batcher->pixelRatio = devicePixelRatio;
+        batcher->gridWidth = std::max(1, (int) std::ceil(width / cellSize));
+        batcher->gridHeight = std::max(1, (int) std::ceil(height / cellSize));
+        if (batcher->grid.size() < (size_t) (batcher->gridWidth * batcher->gridHeight))
+            batcher->grid.resize(batcher->gridWidth * batcher->gridHeight);
+        batcher->params.renderViewport(uptr, width, height, devicePixelRatio);
+    }
+
+    void batchCancel(void *uptr) {
+        DrawBatcher *batcher = lookup(uptr);
+        batcher->discard();
+        batcher->params.renderCancel(uptr);
+    }
+
+    void batchFlush(void *uptr) {
+        DrawBatcher *batcher = lookup(uptr);
+        batcher->flush();
+        batcher->params.renderFlush(uptr);
+    }
+
+    void batchFill(void *uptr, NVGpaint *paint, NVGcompositeOperationState compositeOperation,
+                   NVGscissor *scissor, float fringe, const float *bounds, const NVGpath *paths, int npaths) {
+        DrawBatcher *batcher = lookup(uptr);
+        if (batcher->enabled) {
+            if (batcher->fillRect(paint, compositeOperation, scissor, fringe, paths, npaths))
+                return;
+            float area[4] = { bounds[0] - fringe, bounds[1] - fringe,
+                              bounds[2] + fringe, bounds[3] + fringe };
+            batcher->barrier(area);
+        }
+        batcher->params.renderFill(uptr, paint, compositeOperation, scissor, fringe, bounds, paths, npaths);
+    }
+
+    void batchStroke(void *uptr, NVGpaint *paint, NVGcompositeOperationState compositeOperation,
+                     NVGscissor *scissor, float fringe, float strokeWidth, const NVGpath *paths, int npaths) {
+        DrawBatcher *batcher = lookup(uptr);
+        if (batcher->enabled) {
+            float area[4] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                              -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+            for (int i = 0; i < npaths; ++i)
+                bounds(paths[i].stroke, paths[i].nstroke, area);
+            batcher->barrier(area);
+        }
+        batcher->params.renderStroke(uptr, paint, compositeOperation, scissor, fringe, strokeWidth, paths, npaths);
+    }
+
+    void batchTriangles(void *uptr, NVGpaint *paint, NVGcompositeOperationState compositeOperation,
+                        NVGscissor *scissor, const NVGvertex *verts, int nverts) {
+        DrawBatcher *batcher = lookup(uptr);
+        if (batcher->enabled) {
+            if (batcher->triangles(paint, compositeOperation, scissor, verts, nverts))
+                return;
+            float area[4] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                              -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+            bounds(verts, nverts, area);
+            batcher->barrier(area);
+        }
+        batcher->params.renderTriangles(uptr, paint, compositeOperation, scissor, verts, nverts);
+    }
+
+    void batchDelete(void *uptr) {
+        DrawBatcher *batcher = lookup(uptr);
+        NVGparams params = batcher->params;
+        if (batcher->whiteImage != 0)
+            params.renderDeleteTexture(uptr, batcher->whiteImage);
+        {
+            std::lock_guard<std::mutex> guard(registryMutex);
+            registry.erase(uptr);
+            ++registryVersion;
+        }
+        delete batcher;
+        params.renderDelete(uptr);
+    }
+}
+
+void nvgSetBatching(NVGcontext *ctx, bool enabled) {
+    NVGparams *params = nvgInternalParams(ctx);
+    DrawBatcher *batcher = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(registryMutex);
+        auto it = registry.find(params->userPtr);
+        if (it == registry.end()) {
+            if (!enabled)
+                return;
+            batcher = new DrawBatcher();
+            batcher->params = *params;
+            registry[params->userPtr] = batcher;
+            ++registryVersion;
+            params->renderCreateTexture = batchCreateTexture;
+            params->renderDeleteTexture = batchDeleteTexture;
+            params->renderViewport = batchViewport;
+            params->renderCancel = batchCancel;
+            params->renderFlush = batchFlush;
+            params->renderFill = batchFill;
+            params->renderStroke = batchStroke;
+            params->renderTriangles = batchTriangles;
+            params->renderDelete = batchDelete;
+            return;
+        }
+        batcher = it->second;
+    }
+    if (!enabled)
+        batcher->flush();
+    batcher->enabled = enabled;
+}
+
+NAMESPACE_END(nanogui)
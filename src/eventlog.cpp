@@ -0,0 +1,279 @@
+/*
+    src/eventlog.cpp -- Recording and deterministic replay of the raw
+    input received by a Screen
+
+    NanoGUI was developed by Wenzel Jakob <wenzel.jakob@epfl.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/eventlog.h>
+#include <nanogui/screen.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+NAMESPACE_BEGIN(nanogui)
+
+/* Log layout: the magic string and format version, followed by records made
+   of a type byte, the time since the previous record as a float and a fixed
+   payload per type. Values are stored in native byte order. */
+static const char eventLogMagic[8] = { 'N', 'G', 'E', 'V', 'L', 'O', 'G', '\0' };
+static const uint32_t eventLogVersion = 1;
+
+EventRecorder::EventRecorder(const std::string &filename) {
+    mFile = fopen(filename.c_str(), "wb");
+    if (!mFile)
+        throw std::runtime_error("EventRecorder: could not open \"" + filename + "\"!");
+    fwrite(eventLogMagic, sizeof(eventLogMagic), 1, mFile);
+    write(eventLogVersion);
+}
+
+EventRecorder::~EventRecorder() {
+    fclose(mFile);
+}
+
+void EventRecorder::begin(EventType type, double time) {
+    if (mRecordCount == 0)
+        mLastTime = time;
+    write((uint8_t) type);
+    write((float) (time - mLastTime));
+    mLastTime = time;
+    mRecordCount++;
+}
+
+void EventRecorder::cursorPos(double time, double x, double y) {
+    begin(EventType::CursorPos, time);
+    write((float) x); write((float) y);
+}
+
+void EventRecorder::mouseButton(double time, int button, int action, int modifiers) {
+    begin(EventType::MouseButton, time);
+    write((int8_t) button); write((int8_t) action); write((int16_t) modifiers);
+}
+
+void EventRecorder::key(double time, int key, int scancode, int action, int mods) {
+    begin(EventType::Key, time);
+    write((int32_t) key); write((int32_t) scancode);
+    write((int8_t) action); write((int16_t) mods);
+}
+
+void EventRecorder::character(double time, unsigned int codepoint) {
+    begin(EventType::Char, time);
+    write((uint32_t) codepoint);
+}
+
+void EventRecorder::drop(double time, int count, const char **filenames) {
+    begin(EventType::Drop, time);
+    write((uint32_t) count);
+    for (int i = 0; i < count; ++i) {
+        uint32_t length = (uint32_t) strlen(filenames[i]);
+        write(length);
+        fwrite(filenames[i], 1, length, mFile);
+    }
+}
+
+void EventRecorder::scroll(double time, double x, double y) {
+    begin(EventType::Scroll, time);
+    write((float) x); write((float) y);
+}
+
+void EventRecorder::resize(double time, int width, int height) {
+    begin(EventType::Resize, time);
+    write((int32_t) width); write((int32_t) height);
+}
+
+void EventRecorder::frame(double time) {
+    begin(EventType::Frame, time);
+}
+
+namespace {
+    class LogReader {
+    public:
+        LogReader(const std::vector<uint8_t> &data) : mData(data), mPos(0) { }
+
+        bool done() const { return mPos == mData.size(); }
+
+        template <typename T> T read() {
+            T value;
+            readBytes(&value, sizeof(T));
+            return value;
+        }
+
+        void readBytes(void *target, size_t size) {
+            if (mData.size() - mPos < size)
+                throw std::runtime_error("EventReplayer: truncated event log!");
+            memcpy(target, mData.data() + mPos, size);
+            mPos += size;
+        }
+
+    private:
+        const std::vector<uint8_t> &mData;
+        size_t mPos;
+    };
+
+    double percentile(std::vector<double> values, double p) {
+        if (values.empty())
+            return 0;
+        size_t index = std::min(values.size() - 1, (size_t) (p * values.size()));
+        std::nth_element(values.begin(), values.begin() + index, values.end());
+        return values[index];
+    }
+
+    void summarize(std::ostringstream &os, const char *name, const std::vector<double> &values) {
+        double total = 0, maximum = 0;
+        for (double v : values) {
+            total += v;
+            maximum = std::max(maximum, v);
+        }
+        os << name << ": " << values.size() << ", mean "
+           << (values.empty() ? 0.0 : total / values.size()) * 1000 << " ms, p95 "
+           << percentile(values, 0.95) * 1000 << " ms, max " << maximum * 1000 << " ms\n";
+    }
+}
+
+std::string ReplayStats::summary() const {
+    std::ostringstream os;
+    summarize(os, "Events", eventLatency);
+    summarize(os, "Frames", frameTime);
+    os << "Total: " << totalTime * 1000 << " ms";
+    return os.str();
+}
+
+EventReplayer::EventReplayer(const std::string &filename) {
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (!file)
+        throw std::runtime_error("EventReplayer: could not open \"" + filename + "\"!");
+    uint8_t buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        mData.insert(mData.end(), buffer, buffer + count);
+    fclose(file);
+
+    LogReader reader(mData);
+    char magic[sizeof(eventLogMagic)];
+    reader.readBytes(magic, sizeof(magic));
+    if (memcmp(magic, eventLogMagic, sizeof(magic)) != 0 ||
+        reader.read<uint32_t>() != eventLogVersion)
+        throw std::runtime_error("EventReplayer: \"" + filename + "\" is not a supported event log!");
+
+    /* Validate the records once, so that replay() doesn't fail halfway */
+    while (!reader.done()) {
+        EventType type = (EventType) reader.read<uint8_t>();
+        reader.read<float>();
+        switch (type) {
+            case EventType::CursorPos:
+            case EventType::Scroll: reader.read<float>(); reader.read<float>(); break;
+            case EventType::MouseButton: reader.read<int8_t>(); reader.read<int8_t>(); reader.read<int16_t>(); break;
+            case EventType::Key: reader.read<int32_t>(); reader.read<int32_t>(); reader.read<int8_t>(); reader.read<int16_t>(); break;
+            case EventType::Char: reader.read<uint32_t>(); break;
+            case EventType::Drop: {
+                    uint32_t files = reader.read<uint32_t>();
+                    for (uint32_t i = 0; i < files; ++i) {
+                        std::string name(reader.read<uint32_t>(), '\0');
+                        reader.readBytes(&name[0], name.size());
+                    }
+                }
+                break;
+            case EventType::Resize: reader.read<int32_t>(); reader.read<int32_t>(); break;
+            case EventType::Frame: break;
+            default:
+                throw std::runtime_error("EventReplayer: invalid record in \"" + filename + "\"!");
+        }
+        mRecordCount++;
+    }
+}
+
+ReplayStats EventReplayer::replay(Screen *screen, bool drawFrames) const {
+    typedef std::chrono::high_resolution_clock clock;
+    auto seconds = [](clock::duration d) { return std::chrono::duration<double>(d).count(); };
+
+    ReplayStats stats;
+    EventRecorder *recorder = screen->eventRecorder();
+    screen->setEventRecorder(nullptr);
+    double previousTime = screen->virtualTime();
+    double time = 0;
+    screen->setVirtualTime(time);
+
+    LogReader reader(mData);
+    char magic[sizeof(eventLogMagic)];
+    reader.readBytes(magic, sizeof(magic));
+    reader.read<uint32_t>();
+
+    std::vector<std::string> filenames;
+    std::vector<const char *> filenamePtrs;
+    auto replayStart = clock::now();
+    try {
+        while (!reader.done()) {
+            EventType type = (EventType) reader.read<uint8_t>();
+            time += reader.read<float>();
+            screen->setVirtualTime(time);
+
+            auto start = clock::now();
+            switch (type) {
+                case EventType::CursorPos: {
+                        float x = reader.read<float>(), y = reader.read<float>();
+                        screen->cursorPosCallbackEvent(x, y);
+                    }
+                    break;
+                case EventType::MouseButton: {
+                        int button = reader.read<int8_t>(), action = reader.read<int8_t>();
+                        screen->mouseButtonCallbackEvent(button, action, reader.read<int16_t>());
+                    }
+                    break;
+                case EventType::Key: {
+                        int key = reader.read<int32_t>(), scancode = reader.read<int32_t>();
+                        int action = reader.read<int8_t>();
+                        screen->keyCallbackEvent(key, scancode, action, reader.read<int16_t>());
+                    }
+                    break;
+                case EventType::Char:
+                    screen->charCallbackEvent(reader.read<uint32_t>());
+                    break;
+                case EventType::Drop: {
+                        filenames.resize(reader.read<uint32_t>());
+                        filenamePtrs.clear();
+                        for (auto &name : filenames) {
+                            name.resize(reader.read<uint32_t>());
+                            reader.readBytes(&name[0], name.size());
+                            filenamePtrs.push_back(name.c_str());
+                        }
+                        screen->dropCallbackEvent((int) filenames.size(), filenamePtrs.data());
+                    }
+                    break;
+                case EventType::Scroll: {
+                        float x = reader.read<float>(), y = reader.read<float>();
+                        screen->scrollCallbackEvent(x, y);
+                    }
+                    break;
+                case EventType::Resize: {
+                        int width = reader.read<int32_t>(), height = reader.read<int32_t>();
+                        screen->resizeCallbackEvent(width, height);
+                    }
+                    break;
+                case EventType::Frame:
+                    if (drawFrames) {
+                        screen->drawAll();
+                        stats.frameTime.push_back(seconds(clock::now() - start));
+                    }
+                    continue;
+            }
+            stats.eventLatency.push_back(seconds(clock::now() - start));
+        }
+    } catch (...) {
+        screen->setVirtualTime(previousTime);
+        screen->setEventRecorder(recorder);
+        throw;
+    }
+    stats.totalTime = seconds(clock::now() - replayStart);
+
+    screen->setVirtualTime(previousTime);
+    screen->setEventRecorder(recorder);
+    return stats;
+}
+
+NAMESPACE_END(nanogui)
@@ -324,17 +324,31 @@ void GLUniformBuffer::update(const std::vector<uint8_t> &data) {
 
 //  ----------------------------------------------------
 
-void GLFramebuffer::init(const Vector2i &size, int nSamples) {
+void GLFramebuffer::init(const Vector2i &size, int nSamples, bool texture) {
+    if (texture && nSamples > 1)
+        throw std::runtime_error("GLFramebuffer::init(): texture attachments can't be multisampled!");
     mSize = size;
     mSamples = nSamples;
 
-    glGenRenderbuffers(1, &mColor);
-    glBindRenderbuffer(GL_RENDERBUFFER, mColor);
+    if (texture) {
+        glGenTextures(1, &mTexture);
+        glBindTexture(GL_TEXTURE_2D, mTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.x(), size.y(), 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    } else {
+        glGenRenderbuffers(1, &mColor);
+        glBindRenderbuffer(GL_RENDERBUFFER, mColor);
 
-    if (nSamples <= 1)
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.x(), size.y());
-    else
-        glRenderbufferStorageMultisample(GL_RENDERBUFFER, nSamples, GL_RGBA8, size.x(), size.y());
+        if (nSamples <= 1)
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.x(), size.y());
+        else
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, nSamples, GL_RGBA8, size.x(), size.y());
+    }
 
     glGenRenderbuffers(1, &mDepth);
     glBindRenderbuffer(GL_RENDERBUFFER, mDepth);
@@ -347,7 +361,10 @@ void GLFramebuffer::init(const Vector2i &size, int nSamples) {
     glGenFramebuffers(1, &mFramebuffer);
     glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
 
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mColor);
+    if (texture)
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mTexture, 0);
+    else
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mColor);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mDepth);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_RENDERBUFFER, mDepth);
 
@@ -362,9 +379,11 @@ void GLFramebuffer::init(const Vector2i &size, int nSamples) {
 }
 
 void GLFramebuffer::free() {
+    glDeleteFramebuffers(1, &mFramebuffer);
     glDeleteRenderbuffers(1, &mColor);
     glDeleteRenderbuffers(1, &mDepth);
-    mColor = mDepth = 0;
+    glDeleteTextures(1, &mTexture);
+    mFramebuffer = mColor = mDepth = mTexture = 0;
 }
 
 void GLFramebuffer::bind() {
@@ -10,12 +10,128 @@
 */
 
 #include <nanogui/graph.h>
+#include <nanogui/screen.h>
+#include <nanogui/softwarerenderer.h>
 #include <nanogui/theme.h>
 #include <nanogui/opengl.h>
 #include <nanogui/serializer/core.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
 
 NAMESPACE_BEGIN(nanogui)
 
+namespace {
+    /* Samples are fetched from a texture buffer, and every sample expands to
+       two vertices of a triangle strip: the area below the curve is spanned
+       down to the bottom edge, while lines are offset along their normal. */
+    constexpr char const *const graphVertexShader =
+        R"(#version 330
+        uniform samplerBuffer samples;
+        uniform int offset;
+        uniform int bufferSize;
+        uniform int count;
+        uniform vec2 origin;
+        uniform vec2 extent;
+        uniform vec2 screenSize;
+        uniform vec2 range;
+        uniform float halfWidth;
+
+        vec2 point(int i) {
+            i = clamp(i, 0, count - 1);
+            int j = offset + i;
+            if (j >= bufferSize)
+                j -= bufferSize;
+            float value = (texelFetch(samples, j).r - range.x) / (range.y - range.x);
+            return origin + extent * vec2(float(i) / float(count - 1), 1.0 - value);
+        }
+
+        void main() {
+            int i = gl_VertexID / 2;
+            bool upper = (gl_VertexID & 1) == 1;
+            vec2 p = point(i);
+            if (halfWidth < 0.0) {
+                if (!upper)
+                    p.y = origin.y + extent.y;
+            } else {
+                vec2 t = point(i + 1) - point(i - 1);
+                if (dot(t, t) < 1e-12)
+                    t = vec2(1.0, 0.0);
+                p += normalize(vec2(-t.y, t.x)) * (upper ? halfWidth : -halfWidth);
+            }
+            gl_Position = vec4(2.0 * p.x / screenSize.x - 1.0,
+                               1.0 - 2.0 * p.y / screenSize.y, 0.0, 1.0);
+        })";
+
+    constexpr char const *const graphFragmentShader =
+        R"(#version 330
+        uniform vec4 color;
+        out vec4 fragColor;
+        void main() {
+            fragColor = color;
+        })";
+
+    /* Add line segments through the samples value(0) .. value(count-1), which
+       are spread evenly across the horizontal extent of the graph. Samples
+       that fall into the same pixel column are reduced to their minimum and
+       maximum, so the path never has more than two vertices per column. */
+    template <typename Func>
+    void addSamplePath(NVGcontext *ctx, size_t count, const Vector2i &pos, const Vector2i &size,
+                       float min, float max, bool moveTo, const Func &value) {
+        float xScale = size.x() / (float) (count - 1);
+        float yScale = size.y() / (max - min);
+        float yBase = pos.y() + size.y() + min * yScale;
+        auto vertex = [&](size_t i, float v) {
+            float vx = pos.x() + i * xScale, vy = yBase - v * yScale;
+            if (moveTo) {
+                nvgMoveTo(ctx, vx, vy);
+                moveTo = false;
+            } else {
+                nvgLineTo(ctx, vx, vy);
+            }
+        };
+
+        size_t columns = (size_t) std::max(1, size.x());
+        if (count <= 2 * columns) {
+            for (size_t i = 0; i < count; ++i)
+                vertex(i, value(i));
+            return;
+        }
+
+        size_t begin = 0;
+        for (size_t c = 0; c < columns; ++c) {
+            size_t end = (c + 1) * count / columns;
+            size_t minIndex = begin, maxIndex = begin;
+            float minValue = value(begin), maxValue = minValue;
+            for (size_t i = begin + 1; i < end; ++i) {
+                float v = value(i);
+                if (v < minValue) {
+                    minValue = v;
+                    minIndex = i;
+                } else if (v > maxValue) {
+                    maxValue = v;
+                    maxIndex = i;
+                }
+            }
+            if (minIndex < maxIndex) {
+                vertex(minIndex, minValue);
+                vertex(maxIndex, maxValue);
+            } else if (minIndex > maxIndex) {
+                vertex(maxIndex, maxValue);
+                vertex(minIndex, minValue);
+            } else {
+                vertex(minIndex, minValue);
+            }
+            begin = end;
+        }
+    }
+}
+
+Graph::Series::Series(size_t capacity, const Color &color)
+    : capacity(capacity), bufferSize(capacity + capacity / 2 + 64),
+      data(new std::atomic<float>[bufferSize]), written(0),
+      color(color) { }
+
 Graph::Graph(Widget *parent, const std::string &caption)
     : Widget(parent), mCaption(caption) {
     mBackgroundColor = Color(20, 128);
@@ -23,10 +139,45 @@ Graph::Graph(Widget *parent, const std::string &caption)
     mTextColor = Color(240, 192);
 }
 
+Graph::~Graph() {
+#if !defined(NANOVG_GL2_IMPLEMENTATION) && !defined(NANOVG_GLES2_IMPLEMENTATION)
+    for (auto &buffer : mGPUBuffers) {
+        glDeleteTextures(1, &buffer.texture);
+        glDeleteBuffers(1, &buffer.buffer);
+    }
+#endif
+    mPlotShader.free();
+}
+
 Vector2i Graph::preferredSize(NVGcontext *) const {
     return Vector2i(180, 45);
 }
 
+int Graph::addSeries(size_t capacity, const Color &color) {
+    if (capacity < 2)
+        throw std::runtime_error("Graph::addSeries(): capacity must be at least 2!");
+    mSeries.emplace_back(new Series(capacity, color));
+    return (int) mSeries.size() - 1;
+}
+
+void Graph::setSeriesRange(int series, float min, float max) {
+    mSeries[series]->min = min;
+    mSeries[series]->max = max;
+}
+
+size_t Graph::seriesSize(int series) const {
+    const Series &s = *mSeries[series];
+    return (size_t) std::min<uint64_t>(s.written.load(std::memory_order_acquire), s.capacity);
+}
+
+void Graph::push(int series, const float *values, size_t count) {
+    Series &s = *mSeries[series];
+    uint64_t index = s.written.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; ++i)
+        s.data[(index + i) % s.bufferSize].store(values[i], std::memory_order_relaxed);
+    s.written.store(index + count, std::memory_order_release);
+}
+
 void Graph::draw(NVGcontext *ctx) {
     Widget::draw(ctx);
 
@@ -35,42 +186,27 @@ void Graph::draw(NVGcontext *ctx) {
     nvgFillColor(ctx, mBackgroundColor);
     nvgFill(ctx);
 
-    if (mValues.size() < 2)
+    if (!hasPlot())
         return;
 
-    nvgBeginPath(ctx);
-    nvgMoveTo(ctx, mPos.x(), mPos.y()+mSize.y());
-    for (size_t i = 0; i < (size_t) mValues.size(); i++) {
-        float value = mValues[i];
-        float vx = mPos.x() + i * mSize.x() / (float) (mValues.size() - 1);
-        float vy = mPos.y() + (1-value) * mSize.y();
-        nvgLineTo(ctx, vx, vy);
-    }
-
-    nvgLineTo(ctx, mPos.x() + mSize.x(), mPos.y() + mSize.y());
-    nvgStrokeColor(ctx, Color(100, 255));
-    nvgStroke(ctx);
-    nvgFillColor(ctx, mForegroundColor);
-    nvgFill(ctx);
-
-    nvgFontFace(ctx, "sans");
+    drawPlot(ctx);
 
     if (!mCaption.empty()) {
-        nvgFontSize(ctx, 14.0f);
+        mTheme->setFont(ctx, "sans", 14.0f);
         nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
         nvgFillColor(ctx, mTextColor);
         nvgText(ctx, mPos.x() + 3, mPos.y() + 1, mCaption.c_str(), NULL);
     }
 
     if (!mHeader.empty()) {
-        nvgFontSize(ctx, 18.0f);
+        mTheme->setFont(ctx, "sans", 18.0f);
         nvgTextAlign(ctx, NVG_ALIGN_RIGHT | NVG_ALIGN_TOP);
         nvgFillColor(ctx, mTextColor);
         nvgText(ctx, mPos.x() + mSize.x() - 3, mPos.y() + 1, mHeader.c_str(), NULL);
     }
 
     if (!mFooter.empty()) {
-        nvgFontSize(ctx, 15.0f);
+        mTheme->setFont(ctx, "sans", 15.0f);
         nvgTextAlign(ctx, NVG_ALIGN_RIGHT | NVG_ALIGN_BOTTOM);
         nvgFillColor(ctx, mTextColor);
         nvgText(ctx, mPos.x() + mSize.x() - 3, mPos.y() + mSize.y() - 1, mFooter.c_str(), NULL);
@@ -82,6 +218,196 @@ void Graph::draw(NVGcontext *ctx) {
     nvgStroke(ctx);
 }
 
+void Graph::drawPlot(NVGcontext *ctx) {
+    if (mGPUAccelerated && drawPlotGPU(ctx))
+        return;
+
+    if (mValues.size() >= 2) {
+        nvgBeginPath(ctx);
+        nvgMoveTo(ctx, mPos.x(), mPos.y()+mSize.y());
+        const float *values = mValues.data();
+        addSamplePath(ctx, (size_t) mValues.size(), mPos, mSize, 0.f, 1.f, false,
+                      [values](size_t i) { return values[i]; });
+        nvgLineTo(ctx, mPos.x() + mSize.x(), mPos.y() + mSize.y());
+        nvgStrokeColor(ctx, Color(100, 255));
+        nvgStroke(ctx);
+        nvgFillColor(ctx, mForegroundColor);
+        nvgFill(ctx);
+    }
+
+    for (const auto &series : mSeries) {
+        const Series &s = *series;
+        uint64_t written = s.written.load(std::memory_order_acquire);
+        size_t count = (size_t) std::min<uint64_t>(written, s.capacity);
+        if (count < 2 || s.max == s.min)
+            continue;
+
+        /* The window [written - count, written) is split into at most two
+           contiguous ranges of the ring buffer */
+        size_t first = (size_t) ((written - count) % s.bufferSize);
+        size_t wrap = s.bufferSize - first;
+        const std::atomic<float> *data = s.data.get();
+        nvgBeginPath(ctx);
+        addSamplePath(ctx, count, mPos, mSize, s.min, s.max, true,
+            [data, first, wrap](size_t i) {
+                return data[i < wrap ? first + i : i - wrap].load(std::memory_order_relaxed);
+            });
+        nvgStrokeColor(ctx, s.color);
+        nvgStroke(ctx);
+    }
+}
+
+bool Graph::drawPlotGPU(NVGcontext *ctx) {
+#if !defined(NANOVG_GL2_IMPLEMENTATION) && !defined(NANOVG_GLES2_IMPLEMENTATION)
+    static_assert(sizeof(std::atomic<float>) == sizeof(float),
+                  "Series samples are uploaded as plain floats");
+
+    /* Software contexts don't draw into the OpenGL framebuffer */
+    if (nvgIsSoftware(ctx))
+        return false;
+
+    /* Every buffer must fit into a texture buffer, otherwise use NanoVG */
+    if (mMaxGPUSamples == 0) {
+        GLint maxSamples = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxSamples);
+        mMaxGPUSamples = std::max(maxSamples, 1);
+    }
+    if ((size_t) mValues.size() > (size_t) mMaxGPUSamples)
+        return false;
+    for (const auto &series : mSeries)
+        if (series->bufferSize > (size_t) mMaxGPUSamples)
+            return false;
+
+    /* The plot is drawn in frame coordinates, which requires a translation
+       (e.g. the offset of a window layer) */
+    Vector2i frameSize = drawFrameSize();
+    float xform[6];
+    nvgCurrentTransform(ctx, xform);
+    if (frameSize == Vector2i::Zero() || xform[0] != 1.f || xform[1] != 0.f ||
+        xform[2] != 0.f || xform[3] != 1.f)
+        return false;
+    Vector2i position = mPos + Vector2i((int) std::round(xform[4]), (int) std::round(xform[5]));
+
+    /* Clip to the ancestors like the NanoVG scissor, assuming that they are
+       all offset from their absolute position like this widget */
+    Vector2i offset = position - absolutePosition();
+    Vector2i clipMin = position.cwiseMax(Vector2i::Zero()),
+             clipMax = (position + mSize).cwiseMin(frameSize);
+    for (const Widget *w = parent(); w && w->parent(); w = w->parent()) {
+        Vector2i p = w->absolutePosition() + offset;
+        clipMin = clipMin.cwiseMax(p);
+        clipMax = clipMax.cwiseMin(p + w->size());
+    }
+    if ((clipMin.array() >= clipMax.array()).any())
+        return true;
+
+    if (mPlotShader.name().empty()) {
+        try {
+            if (!mPlotShader.init("GraphShader", graphVertexShader, graphFragmentShader))
+                throw std::runtime_error("Could not create the graph shader!");
+        } catch (const std::exception &e) {
+            std::cerr << "Caught exception in Graph::drawPlotGPU(): " << e.what() << std::endl;
+            mPlotShader.free();
+            mGPUAccelerated = false;
+            return false;
+        }
+    }
+
+    float pixelRatio = drawPixelRatio();
+    Vector2f screenSize = frameSize.cast<float>();
+
+    /* Flush the NanoVG draw stack (background), composite the plot on top */
+    nvgEndFrame(ctx);
+
+    Vector2i clipSize = clipMax - clipMin;
+    glEnable(GL_SCISSOR_TEST);
+    glScissor((GLint) (clipMin.x() * pixelRatio),
+              (GLint) ((frameSize.y() - clipMax.y()) * pixelRatio),
+              (GLsizei) (clipSize.x() * pixelRatio), (GLsizei) (clipSize.y() * pixelRatio));
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_CULL_FACE);
+
+    mPlotShader.bind();
+    glActiveTexture(GL_TEXTURE0);
+    mPlotShader.setUniform("samples", 0);
+    mPlotShader.setUniform("origin", position.cast<float>().eval());
+    mPlotShader.setUniform("extent", mSize.cast<float>().eval());
+    mPlotShader.setUniform("screenSize", screenSize);
+
+    mGPUBuffers.resize(mSeries.size() + 1);
+    auto prepare = [](GPUBuffer &buffer, const void *owner, size_t size) {
+        if (!buffer.buffer) {
+            glGenBuffers(1, &buffer.buffer);
+            glGenTextures(1, &buffer.texture);
+        }
+        if (buffer.owner != owner || buffer.size != size) {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffer.buffer);
+            glBufferData(GL_TEXTURE_BUFFER, size * sizeof(float), nullptr, GL_STREAM_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, buffer.texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, buffer.buffer);
+            buffer.owner = owner;
+            buffer.size = size;
+            buffer.uploaded = 0;
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer.buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, buffer.texture);
+    };
+    auto draw = [this](size_t offset, size_t bufferSize, size_t count, float min, float max,
+                       float halfWidth, const Color &color) {
+        mPlotShader.setUniform("offset", (int) offset);
+        mPlotShader.setUniform("bufferSize", (int) bufferSize);
+        mPlotShader.setUniform("count", (int) count);
+        mPlotShader.setUniform("range", Vector2f(min, max));
+        mPlotShader.setUniform("halfWidth", halfWidth);
+        mPlotShader.setUniform("color", Vector4f(color.r(), color.g(), color.b(), color.w()));
+        mPlotShader.drawArray(GL_TRIANGLE_STRIP, 0, (uint32_t) (2 * count));
+    };
+
+    if (mValues.size() >= 2) {
+        size_t count = (size_t) mValues.size();
+        GPUBuffer &buffer = mGPUBuffers[0];
+        prepare(buffer, &mValues, count);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, count * sizeof(float), mValues.data());
+        draw(0, count, count, 0.f, 1.f, -1.f, mForegroundColor);
+        draw(0, count, count, 0.f, 1.f, 0.5f, Color(100, 255));
+    }
+
+    for (size_t i = 0; i < mSeries.size(); ++i) {
+        const Series &s = *mSeries[i];
+        GPUBuffer &buffer = mGPUBuffers[i + 1];
+        uint64_t written = s.written.load(std::memory_order_acquire);
+        size_t count = (size_t) std::min<uint64_t>(written, s.capacity);
+        prepare(buffer, &s, s.bufferSize);
+
+        /* Only upload the samples written since the last frame, in at most
+           two contiguous ranges of the ring buffer */
+        uint64_t first = std::max(buffer.uploaded, written - std::min<uint64_t>(written, s.bufferSize));
+        const float *data = reinterpret_cast<const float *>(s.data.get());
+        while (first < written) {
+            size_t begin = (size_t) (first % s.bufferSize);
+            size_t length = (size_t) std::min<uint64_t>(written - first, s.bufferSize - begin);
+            glBufferSubData(GL_TEXTURE_BUFFER, begin * sizeof(float), length * sizeof(float), data + begin);
+            first += length;
+        }
+        buffer.uploaded = written;
+
+        if (count < 2 || s.max == s.min)
+            continue;
+        draw((size_t) ((written - count) % s.bufferSize), s.bufferSize, count,
+             s.min, s.max, 0.5f, s.color);
+    }
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glDisable(GL_SCISSOR_TEST);
+    return true;
+#else
+    (void) ctx;
+    return false;
+#endif
+}
+
 void Graph::save(Serializer &s) const {
     Widget::save(s);
     s.set("caption", mCaption);
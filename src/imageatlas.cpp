@@ -0,0 +1,245 @@
+/*
+    src/imageatlas.cpp -- Packs small images into shared NanoVG textures
+
+    NanoGUI was developed by Wenzel Jakob <wenzel.jakob@epfl.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/imageatlas.h>
+#include <nanogui/imagecache.h>
+#include <nanogui/opengl.h>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+NAMESPACE_BEGIN(nanogui)
+
+ImageAtlas::ImageAtlas(NVGcontext *ctx, int pageSize, int maxImageSize)
+    : mContext(ctx), mPageSize(pageSize),
+      mMaxImageSize(std::min(maxImageSize, pageSize - 2)) { }
+
+ImageAtlas::~ImageAtlas() {
+    for (auto &page : mPages)
+        if (page.image)
+            nvgDeleteImage(mContext, page.image);
+}
+
+size_t ImageAtlas::pageCount() const {
+    return (size_t) std::count_if(mPages.begin(), mPages.end(),
+                                  [](const Page &page) { return page.image != 0; });
+}
+
+void ImageAtlas::reset(Page &page) {
+    page.skyline.clear();
+    page.skyline.push_back(Vector3i(0, mPageSize, 0));
+}
+
+bool ImageAtlas::place(Page &page, int width, int height, Vector2i &pos) {
+    auto &sky = page.skyline;
+    int bestIndex = -1, bestY = INT_MAX, bestWidth = INT_MAX;
+
+    /* Bottom-left rule: the lowest position, ties go to the narrowest segment */
+    for (size_t i = 0; i < sky.size(); ++i) {
+        if (sky[i].x() + width > mPageSize)
+            break;
+        int y = 0, remaining = width;
+        for (size_t j = i; remaining > 0; ++j) {
+            y = std::max(y, sky[j].z());
+            remaining -= sky[j].y();
+        }
+        if (y + height > mPageSize)
+            continue;
+        if (y < bestY || (y == bestY && sky[i].y() < bestWidth)) {
+            bestIndex = (int) i;
+            bestY = y;
+            bestWidth = sky[i].y();
+        }
+    }
+    if (bestIndex < 0)
+        return false;
+
+    pos = Vector2i(sky[bestIndex].x(), bestY);
+    sky.insert(sky.begin() + bestIndex, Vector3i(pos.x(), width, bestY + height));
+
+    /* Shrink or remove the segments now covered by the new one */
+    for (size_t i = bestIndex + 1; i < sky.size();) {
+        int overlap = sky[i - 1].x() + sky[i - 1].y() - sky[i].x();
+        if (overlap <= 0)
+            break;
+        sky[i].x() += overlap;
+        sky[i].y() -= overlap;
+        if (sky[i].y() > 0)
+            break;
+        sky.erase(sky.begin() + i);
+    }
+
+    for (size_t i = 0; i + 1 < sky.size();) {
+        if (sky[i].z() == sky[i + 1].z()) {
+            sky[i].y() += sky[i + 1].y();
+            sky.erase(sky.begin() + i + 1);
+        } else {
+            ++i;
+        }
+    }
+    return true;
+}
+
+int ImageAtlas::add(const uint8_t *rgba, int width, int height) {
+    if (width <= 0 || height <= 0 || width > mMaxImageSize || height > mMaxImageSize)
+        return 0;
+
+    /* Reserve a one pixel border on every side */
+    Vector2i pos;
+    int pageIndex = -1, unused = -1;
+    for (size_t i = 0; i < mPages.size(); ++i) {
+        if (!mPages[i].image) {
+            if (unused < 0)
+                unused = (int) i;
+        } else if (place(mPages[i], width + 2, height + 2, pos)) {
+            pageIndex = (int) i;
+            break;
+        }
+    }
+    if (pageIndex < 0) {
+        Page page;
+        page.pixels.resize((size_t) mPageSize * mPageSize * 4, 0);
+        page.image = nvgCreateImageRGBA(mContext, mPageSize, mPageSize, 0, page.pixels.data());
+        if (page.image == 0)
+            return 0;
+        reset(page);
+        place(page, width + 2, height + 2, pos);
+        /* Entries refer to pages by index, so deleted pages leave a slot */
+        if (unused >= 0) {
+            pageIndex = unused;
+            mPages[pageIndex] = std::move(page);
+        } else {
+            pageIndex = (int) mPages.size();
+            mPages.push_back(std::move(page));
+        }
+    }
+
+    Page &page = mPages[pageIndex];
+    for (int y = -1; y <= height; ++y) {
+        const uint8_t *src = rgba + (size_t) std::min(std::max(y, 0), height - 1) * width * 4;
+        uint8_t *dst = page.pixels.data() +
+            ((size_t) (pos.y() + 1 + y) * mPageSize + pos.x()) * 4;
+        for (int x = -1; x <= width; ++x, dst += 4)
+            memcpy(dst, src + std::min(std::max(x, 0), width - 1) * 4, 4);
+    }
+    page.liveCount++;
+
+    Vector2i lo = pos, hi = pos + Vector2i(width + 2, height + 2);
+    page.dirtyMin = page.dirty ? page.dirtyMin.cwiseMin(lo) : lo;
+    page.dirtyMax = page.dirty ? page.dirtyMax.cwiseMax(hi) : hi;
+    page.dirty = mDirty = true;
+
+    Entry entry { pageIndex, pos.x() + 1, pos.y() + 1, width, height, true };
+    int slot;
+    if (!mFreeEntries.empty()) {
+        slot = mFreeEntries.back();
+        mFreeEntries.pop_back();
+        mEntries[slot] = entry;
+    } else {
+        slot = (int) mEntries.size();
+        mEntries.push_back(entry);
+    }
+    return -(slot + 2);
+}
+
+bool ImageAtlas::contains(int icon) const {
+    int slot = -icon - 2;
+    return slot >= 0 && slot < (int) mEntries.size() && mEntries[slot].live;
+}
+
+void ImageAtlas::release(int icon) {
+    if (!contains(icon))
+        return;
+    int slot = -icon - 2;
+    Entry &entry = mEntries[slot];
+    entry.live = false;
+    mFreeEntries.push_back(slot);
+
+    /* Pixels are left in place, they are overwritten by later images. Empty
+       pages are deleted, they would otherwise keep their memory forever. */
+    Page &page = mPages[entry.page];
+    if (--page.liveCount == 0) {
+        nvgDeleteImage(mContext, page.image);
+        page.image = 0;
+        page.dirty = false;
+        std::vector<uint8_t>().swap(page.pixels);
+        std::vector<Vector3i>().swap(page.skyline);
+    }
+}
+
+bool ImageAtlas::lookup(int icon, int &image, Vector4i &rect) const {
+    if (!contains(icon))
+        return false;
+    const Entry &entry = mEntries[-icon - 2];
+    image = mPages[entry.page].image;
+    rect = Vector4i(entry.x, entry.y, entry.width, entry.height);
+    return true;
+}
+
+void ImageAtlas::flush() {
+    if (!mDirty)
+        return;
+    /* nvgUpdateImage() replaces the whole page, so go to the backend to
+       upload just the rectangle that covers the images added since the last
+       call. Like glTexSubImage2D with a row length, it takes the buffer of
+       the whole page. */
+    NVGparams *params = nvgInternalParams(mContext);
+    for (auto &page : mPages) {
+        if (page.dirty) {
+            Vector2i size = page.dirtyMax - page.dirtyMin;
+            params->renderUpdateTexture(params->userPtr, page.image, page.dirtyMin.x(),
+                                        page.dirtyMin.y(), size.x(), size.y(),
+                                        page.pixels.data());
+            page.dirty = false;
+        }
+    }
+    mDirty = false;
+}
+
+void nvgIconSize(NVGcontext *ctx, int icon, int *width, int *height) {
+    if (nvgIsAtlasIcon(icon)) {
+        ImageCache *cache = ImageCache::find(ctx);
+        int image;
+        Vector4i rect;
+        if (cache && cache->atlas().lookup(icon, image, rect)) {
+            *width = rect[2];
+            *height = rect[3];
+        } else {
+            *width = *height = 0;
+        }
+        return;
+    }
+    nvgImageSize(ctx, icon, width, height);
+}
+
+NVGpaint nvgIconPattern(NVGcontext *ctx, float x, float y, float width, float height,
+                        float angle, int icon, float alpha) {
+    ImageCache *cache = nvgIsAtlasIcon(icon) ? ImageCache::find(ctx) : nullptr;
+    int image;
+    Vector4i rect;
+    if (!cache || !cache->atlas().lookup(icon, image, rect))
+        return nvgImagePattern(ctx, x, y, width, height, angle, icon, alpha);
+
+    ImageAtlas &atlas = cache->atlas();
+    atlas.flush();
+
+    /* Stretch the whole page so that the icon's rectangle lands on the
+       requested one; the pattern rotates about its origin */
+    float sx = width / rect[2], sy = height / rect[3];
+    float ox = -rect[0] * sx, oy = -rect[1] * sy;
+    float c = std::cos(angle), s = std::sin(angle);
+    return nvgImagePattern(ctx, x + c * ox - s * oy, y + s * ox + c * oy,
+                           atlas.pageSize() * sx, atlas.pageSize() * sy,
+                           angle, image, alpha);
+}
+
+NAMESPACE_END(nanogui)
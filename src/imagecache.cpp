@@ -0,0 +1,277 @@
+/*
+    src/imagecache.cpp -- Reference counted cache of NanoVG images with
+    a least-recently-used memory budget
+
+    NanoGUI was developed by Wenzel Jakob <wenzel.jakob@epfl.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/imagecache.h>
+#include <nanogui/imageatlas.h>
+#include <nanogui/opengl.h>
+#include <stb_image.h>
+#include <atomic>
+#include <mutex>
+
+NAMESPACE_BEGIN(nanogui)
+
+namespace {
+    /* Screens may be drawn on different threads, see setParallelDrawing() */
+    std::mutex &registryMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    std::unordered_map<NVGcontext *, ImageCache *> &registry() {
+        static std::unordered_map<NVGcontext *, ImageCache *> caches;
+        return caches;
+    }
+
+    /// Last token handed out to a cache, guarded by \c registryMutex()
+    uint64_t lastToken = 0;
+
+    /// Incremented whenever a cache is removed from the registry
+    std::atomic<uint64_t> registryVersion(1);
+
+    /* Widgets look up the cache of the context they draw into every frame,
+       so remember the last hit of each thread and skip the mutex while no
+       cache has been destroyed since */
+    struct Lookup {
+        NVGcontext *ctx = nullptr;
+        ImageCache *cache = nullptr;
+        uint64_t version = 0;
+    };
+    thread_local Lookup lastLookup;
+
+    ImageCache *cachedLookup(NVGcontext *ctx) {
+        if (lastLookup.ctx == ctx &&
+            lastLookup.version == registryVersion.load(std::memory_order_acquire))
+            return lastLookup.cache;
+        return nullptr;
+    }
+
+    /// Remember a lookup; call with \c registryMutex() held
+    void rememberLookup(NVGcontext *ctx, ImageCache *cache) {
+        lastLookup.ctx = ctx;
+        lastLookup.cache = cache;
+        lastLookup.version = registryVersion.load(std::memory_order_relaxed);
+    }
+}
+
+ImageCache::Handle::Handle(NVGcontext *ctx, int image, bool retain) : mImage(image) {
+    ImageCache *cache = ImageCache::find(ctx);
+    if (cache && cache->contains(image) && (!retain || cache->retain(image))) {
+        mContext = ctx;
+        mToken = cache->token();
+    }
+}
+
+ImageCache::Handle::Handle(Handle &&other) noexcept
+    : mContext(other.mContext), mToken(other.mToken), mImage(other.mImage) {
+    other.mContext = nullptr;
+    other.mToken = 0;
+    other.mImage = 0;
+}
+
+ImageCache::Handle &ImageCache::Handle::operator=(Handle &&other) noexcept {
+    if (this != &other) {
+        reset();
+        std::swap(mContext, other.mContext);
+        std::swap(mToken, other.mToken);
+        std::swap(mImage, other.mImage);
+    }
+    return *this;
+}
+
+bool ImageCache::Handle::valid(NVGcontext *ctx) const {
+    return mContext && mContext == ctx && ImageCache::find(ctx, mToken) != nullptr;
+}
+
+void ImageCache::Handle::reset() {
+    /* The cache may have been destroyed along with its context already */
+    if (mContext) {
+        if (ImageCache *cache = ImageCache::find(mContext, mToken))
+            cache->release(mImage);
+    }
+    mContext = nullptr;
+    mToken = 0;
+    mImage = 0;
+}
+
+ImageCache *ImageCache::get(NVGcontext *ctx) {
+    if (ImageCache *cache = cachedLookup(ctx))
+        return cache;
+    std::lock_guard<std::mutex> guard(registryMutex());
+    ImageCache *&cache = registry()[ctx];
+    if (!cache)
+        cache = new ImageCache(ctx);
+    rememberLookup(ctx, cache);
+    return cache;
+}
+
+ImageCache *ImageCache::find(NVGcontext *ctx) {
+    if (ImageCache *cache = cachedLookup(ctx))
+        return cache;
+    std::lock_guard<std::mutex> guard(registryMutex());
+    auto it = registry().find(ctx);
+    if (it == registry().end())
+        return nullptr;
+    rememberLookup(ctx, it->second);
+    return it->second;
+}
+
+ImageCache *ImageCache::find(NVGcontext *ctx, uint64_t token) {
+    ImageCache *cache = find(ctx);
+    return cache && cache->mToken == token ? cache : nullptr;
+}
+
+void ImageCache::destroy(NVGcontext *ctx) {
+    ImageCache *cache = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(registryMutex());
+        auto it = registry().find(ctx);
+        if (it == registry().end())
+            return;
+        cache = it->second;
+        registry().erase(it);
+        ++registryVersion;
+    }
+    delete cache;
+}
+
+ImageCache::ImageCache(NVGcontext *ctx)
+    : mContext(ctx), mToken(++lastToken), mAtlas(new ImageAtlas(ctx)) { }
+
+ImageCache::~ImageCache() {
+    /* Atlas icons are released along with the atlas pages */
+    for (auto &entry : mEntries)
+        if (!nvgIsAtlasIcon(entry.first))
+            nvgDeleteImage(mContext, entry.first);
+}
+
+int ImageCache::create(const uint8_t *rgba, int width, int height, int imageFlags,
+                       bool pack) {
+    int image = pack && imageFlags == 0 ? mAtlas->add(rgba, width, height) : 0;
+    if (image == 0)
+        image = nvgCreateImageRGBA(mContext, width, height, imageFlags, rgba);
+    return image;
+}
+
+void ImageCache::discard(int image) {
+    if (nvgIsAtlasIcon(image))
+        mAtlas->release(image);
+    else
+        nvgDeleteImage(mContext, image);
+}
+
+int ImageCache::acquire(const std::string &key) {
+    auto it = mKeys.find(key);
+    if (it == mKeys.end()) {
+        mStats.misses++;
+        return 0;
+    }
+    mStats.hits++;
+    retain(it->second);
+    return it->second;
+}
+
+int ImageCache::acquire(const std::string &key, const uint8_t *data, size_t size,
+                        int imageFlags, bool pack) {
+    int image = acquire(key);
+    if (image)
+        return image;
+    int width, height, channels;
+    uint8_t *rgba = stbi_load_from_memory(data, (int) size, &width, &height, &channels, 4);
+    if (rgba)
+        image = create(rgba, width, height, imageFlags, pack);
+    stbi_image_free(rgba);
+    if (image == 0)
+        throw std::runtime_error("Unable to load resource data.");
+    return add(key, image, imageFlags);
+}
+
+int ImageCache::insert(const std::string &key, int image, int imageFlags) {
+    auto it = mKeys.find(key);
+    if (it != mKeys.end()) {
+        if (it->second != image)
+            discard(image);
+        retain(it->second);
+        return it->second;
+    }
+    return add(key, image, imageFlags);
+}
+
+int ImageCache::add(const std::string &key, int image, int imageFlags) {
+    int width = 0, height = 0;
+    nvgIconSize(mContext, image, &width, &height);
+    size_t bytes = (size_t) width * height * 4;
+    if (imageFlags & NVG_IMAGE_GENERATE_MIPMAPS)
+        bytes += bytes / 3;
+
+    Entry &entry = mEntries[image];
+    entry.key = key;
+    entry.bytes = bytes;
+    entry.refCount = 1;
+    entry.lru = mUnused.end();
+    mKeys[key] = image;
+    mBytes += bytes;
+
+    trim();
+    return image;
+}
+
+bool ImageCache::retain(int image) {
+    auto it = mEntries.find(image);
+    if (it == mEntries.end())
+        return false;
+    Entry &entry = it->second;
+    if (entry.refCount++ == 0) {
+        mUnused.erase(entry.lru);
+        entry.lru = mUnused.end();
+    }
+    return true;
+}
+
+void ImageCache::release(int image) {
+    auto it = mEntries.find(image);
+    if (it == mEntries.end() || it->second.refCount == 0)
+        return;
+    Entry &entry = it->second;
+    if (--entry.refCount == 0)
+        entry.lru = mUnused.insert(mUnused.end(), image);
+}
+
+void ImageCache::evict(int image) {
+    auto it = mEntries.find(image);
+    mUnused.erase(it->second.lru);
+    mKeys.erase(it->second.key);
+    mBytes -= it->second.bytes;
+    mEntries.erase(it);
+    discard(image);
+}
+
+void ImageCache::trim() {
+    while (mBytes > mBudget && !mUnused.empty()) {
+        evict(mUnused.front());
+        mStats.evictions++;
+    }
+}
+
+void ImageCache::purge() {
+    while (!mUnused.empty())
+        evict(mUnused.front());
+}
+
+ImageCacheStats ImageCache::stats() const {
+    ImageCacheStats stats = mStats;
+    stats.images = mEntries.size();
+    stats.referenced = mEntries.size() - mUnused.size();
+    stats.bytes = mBytes;
+    return stats;
+}
+
+NAMESPACE_END(nanogui)
@@ -0,0 +1,298 @@
+/*
+    src/imageloader.cpp -- Background decoding of image thumbnails with
+    an optional on-disk cache
+
+    NanoGUI was developed by Wenzel Jakob <wenzel.jakob@epfl.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/imageloader.h>
+#include <nanogui/imagecache.h>
+#include <nanogui/opengl.h>
+#include <stb_image.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <sys/stat.h>
+#if defined(_WIN32)
+#  include <direct.h>
+#endif
+
+NAMESPACE_BEGIN(nanogui)
+
+namespace {
+    /* Cache layout: the magic string, width and height as 32-bit integers
+       and the RGBA pixels, all in native byte order */
+    const char thumbMagic[8] = { 'N', 'G', 'T', 'H', 'U', 'M', 'B', '1' };
+
+    /* Set when the process exits. Detached workers may outlive main(), they
+       must not start on another file or wake a main loop that is gone. */
+    std::atomic<bool> processExiting(false);
+
+    void markProcessExiting() {
+        processExiting = true;
+    }
+
+    void wakeMainloop() {
+#if !defined(NANOVG_GL2_IMPLEMENTATION) && !defined(NANOVG_GLES2_IMPLEMENTATION)
+        glfwPostEmptyEvent();
+#endif
+    }
+
+    /// FNV-1a, used to derive the cache file name
+    uint64_t hash(uint64_t h, const void *data, size_t size) {
+        const uint8_t *bytes = (const uint8_t *) data;
+        for (size_t i = 0; i < size; ++i)
+            h = (h ^ bytes[i]) * 0x100000001b3ull;
+        return h;
+    }
+
+    /// Average the source pixels that fall onto every target pixel
+    void downscale(const uint8_t *src, int width, int height,
+                   uint8_t *dst, int targetWidth, int targetHeight) {
+        for (int y = 0; y < targetHeight; ++y) {
+            int y0 = (int) ((int64_t) y * height / targetHeight);
+            int y1 = std::max(y0 + 1, (int) ((int64_t) (y + 1) * height / targetHeight));
+            for (int x = 0; x < targetWidth; ++x) {
+                int x0 = (int) ((int64_t) x * width / targetWidth);
+                int x1 = std::max(x0 + 1, (int) ((int64_t) (x + 1) * width / targetWidth));
+                uint32_t sum[4] = { 0, 0, 0, 0 };
+                for (int sy = y0; sy < y1; ++sy) {
+                    const uint8_t *row = src + ((size_t) sy * width + x0) * 4;
+                    for (int sx = x0; sx < x1; ++sx, row += 4)
+                        for (int c = 0; c < 4; ++c)
+                            sum[c] += row[c];
+                }
+                uint32_t count = (uint32_t) ((y1 - y0) * (x1 - x0));
+                uint8_t *out = dst + ((size_t) y * targetWidth + x) * 4;
+                for (int c = 0; c < 4; ++c)
+                    out[c] = (uint8_t) ((sum[c] + count / 2) / count);
+            }
+        }
+    }
+}
+
+struct ImageLoader::Shared {
+    struct Thumbnail {
+        size_t index;
+        int width, height;
+        std::vector<uint8_t> pixels;
+    };
+
+    Shared(int thumbSize, const std::string &cacheDirectory)
+        : thumbSize(thumbSize), cacheDirectory(cacheDirectory) { }
+
+    static void run(std::shared_ptr<Shared> shared);
+    bool load(const std::string &filename, Thumbnail &thumb) const;
+    std::string cachePath(const std::string &filename) const;
+
+    const int thumbSize;
+    const std::string cacheDirectory;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<std::pair<size_t, std::string>> queue;
+    std::vector<Thumbnail> decoded;
+    /// Set when the loader is destroyed
+    bool stop = false;
+};
+
+ImageLoader::ImageLoader(int thumbSize, const std::string &cacheDirectory, int threadCount)
+    : mThumbSize(thumbSize), mCacheDirectory(cacheDirectory),
+      mShared(std::make_shared<Shared>(thumbSize, cacheDirectory)) {
+    if (!mCacheDirectory.empty()) {
+        /* Failure (e.g. because it exists already) is detected when writing */
+#if defined(_WIN32)
+        _mkdir(mCacheDirectory.c_str());
+#else
+        mkdir(mCacheDirectory.c_str(), 0755);
+#endif
+    }
+    static bool exitHandler = std::atexit(markProcessExiting) == 0;
+    (void) exitHandler;
+    if (threadCount <= 0)
+        threadCount = std::min(4, std::max(1, (int) std::thread::hardware_concurrency() - 1));
+    /* The workers keep the shared state alive, so they are never joined */
+    for (int i = 0; i < threadCount; ++i)
+        std::thread(&Shared::run, mShared).detach();
+}
+
+ImageLoader::~ImageLoader() {
+    /* Don't wait for a decode in progress on the GUI thread */
+    std::lock_guard<std::mutex> guard(mShared->mutex);
+    mShared->stop = true;
+    mShared->queue.clear();
+    mShared->decoded.clear();
+    mShared->condition.notify_all();
+}
+
+size_t ImageLoader::enqueue(const std::string &filename) {
+    size_t index = mCount++;
+    {
+        std::lock_guard<std::mutex> guard(mShared->mutex);
+        mShared->queue.emplace_back(index, filename);
+    }
+    mShared->condition.notify_one();
+    return index;
+}
+
+void ImageLoader::Shared::run(std::shared_ptr<Shared> shared) {
+    while (true) {
+        std::pair<size_t, std::string> item;
+        {
+            std::unique_lock<std::mutex> lock(shared->mutex);
+            shared->condition.wait(lock, [&] { return shared->stop || !shared->queue.empty(); });
+            if (shared->stop || processExiting)
+                return;
+            item = std::move(shared->queue.front());
+            shared->queue.pop_front();
+        }
+
+        Thumbnail thumb;
+        thumb.index = item.first;
+        bool success;
+        try {
+            success = shared->load(item.second, thumb);
+        } catch (const std::bad_alloc &) {
+            success = false;
+        }
+        if (!success) {
+            thumb.width = thumb.height = 0;
+            thumb.pixels = std::vector<uint8_t>();
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(shared->mutex);
+            if (shared->stop || processExiting)
+                return;
+            shared->decoded.push_back(std::move(thumb));
+        }
+        wakeMainloop();
+    }
+}
+
+std::string ImageLoader::Shared::cachePath(const std::string &filename) const {
+    if (cacheDirectory.empty())
+        return std::string();
+#if defined(_WIN32)
+    struct _stat64 st;
+    if (_stat64(filename.c_str(), &st) != 0)
+        return std::string();
+#else
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0)
+        return std::string();
+#endif
+    int64_t mtime = (int64_t) st.st_mtime, fileSize = (int64_t) st.st_size;
+    uint64_t h = 0xcbf29ce484222325ull;
+    h = hash(h, filename.data(), filename.size());
+    h = hash(h, &mtime, sizeof(mtime));
+    h = hash(h, &fileSize, sizeof(fileSize));
+    h = hash(h, &thumbSize, sizeof(thumbSize));
+
+    char name[24];
+    snprintf(name, sizeof(name), "%016llx.thumb", (unsigned long long) h);
+    return cacheDirectory + "/" + name;
+}
+
+bool ImageLoader::Shared::load(const std::string &filename, Thumbnail &thumb) const {
+    std::string cached = cachePath(filename);
+
+    if (!cached.empty()) {
+        FILE *file = fopen(cached.c_str(), "rb");
+        if (file) {
+            char magic[sizeof(thumbMagic)];
+            int32_t size[2];
+            bool valid = fread(magic, sizeof(magic), 1, file) == 1 &&
+                         memcmp(magic, thumbMagic, sizeof(magic)) == 0 &&
+                         fread(size, sizeof(size), 1, file) == 1 &&
+                         size[0] > 0 && size[1] > 0 &&
+                         std::min(size[0], size[1]) <= thumbSize;
+            if (valid) {
+                thumb.width = size[0];
+                thumb.height = size[1];
+                thumb.pixels.resize((size_t) size[0] * size[1] * 4);
+                valid = fread(thumb.pixels.data(), thumb.pixels.size(), 1, file) == 1;
+            }
+            fclose(file);
+            if (valid)
+                return true;
+        }
+    }
+
+    int width, height, channels;
+    uint8_t *data = stbi_load(filename.c_str(), &width, &height, &channels, 4);
+    if (!data)
+        return false;
+
+    float scale = std::min(1.f, thumbSize / (float) std::min(width, height));
+    thumb.width = std::max(1, (int) std::round(width * scale));
+    thumb.height = std::max(1, (int) std::round(height * scale));
+    try {
+        thumb.pixels.resize((size_t) thumb.width * thumb.height * 4);
+    } catch (...) {
+        stbi_image_free(data);
+        throw;
+    }
+    downscale(data, width, height, thumb.pixels.data(), thumb.width, thumb.height);
+    stbi_image_free(data);
+
+    if (!cached.empty()) {
+        /* Write to a temporary file first, so that concurrent instances
+           never observe a partially written thumbnail */
+        std::string temp = cached + ".tmp";
+        FILE *file = fopen(temp.c_str(), "wb");
+        if (file) {
+            int32_t size[2] = { thumb.width, thumb.height };
+            bool written = fwrite(thumbMagic, sizeof(thumbMagic), 1, file) == 1 &&
+                           fwrite(size, sizeof(size), 1, file) == 1 &&
+                           fwrite(thumb.pixels.data(), thumb.pixels.size(), 1, file) == 1;
+            written &= fclose(file) == 0;
+            if (!written || std::rename(temp.c_str(), cached.c_str()) != 0)
+                std::remove(temp.c_str());
+        }
+    }
+    return true;
+}
+
+size_t ImageLoader::upload(NVGcontext *ctx, const std::function<void(size_t, int)> &callback,
+                           size_t maxImages) {
+    std::vector<Shared::Thumbnail> batch;
+    bool remaining;
+    {
+        std::lock_guard<std::mutex> guard(mShared->mutex);
+        std::vector<Shared::Thumbnail> &decoded = mShared->decoded;
+        size_t count = std::min(maxImages, decoded.size());
+        std::move(decoded.begin(), decoded.begin() + count, std::back_inserter(batch));
+        decoded.erase(decoded.begin(), decoded.begin() + count);
+        remaining = !decoded.empty();
+    }
+
+    ImageCache *cache = ImageCache::get(ctx);
+    for (auto &thumb : batch) {
+        int image = 0;
+        if (thumb.width > 0)
+            image = cache->create(thumb.pixels.data(), thumb.width, thumb.height, 0, true);
+        mFinished++;
+        callback(thumb.index, image);
+    }
+
+    /* Request another frame for the rest instead of stalling this one */
+    if (remaining)
+        wakeMainloop();
+    return batch.size();
+}
+
+NAMESPACE_END(nanogui)
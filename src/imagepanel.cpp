@@ -11,7 +11,9 @@
 */
 
 #include <nanogui/imagepanel.h>
+#include <nanogui/imageatlas.h>
 #include <nanogui/opengl.h>
+#include <sys/stat.h>
 
 NAMESPACE_BEGIN(nanogui)
 
@@ -19,6 +21,85 @@ ImagePanel::ImagePanel(Widget *parent)
     : Widget(parent), mThumbSize(64), mSpacing(10), mMargin(10),
       mMouseIndex(-1) {}
 
+void ImagePanel::setImages(const Images &data) {
+    mImages = data;
+    mFiles.clear();
+    mHandles.clear();
+    mLoaderSlots.clear();
+    mLoader = nullptr;
+    mResolveFiles = false;
+}
+
+void ImagePanel::loadDirectory(const std::string &path, const std::string &cacheDirectory) {
+    std::vector<std::string> files = listImageDirectory(path);
+    Images images;
+    for (const std::string &fullName : files)
+        images.push_back(
+            std::make_pair(0, fullName.substr(0, fullName.length() - 4)));
+    setImages(images);
+
+    /* The cache lookup needs the NanoVG context and is deferred to draw() */
+    mFiles = std::move(files);
+    mCacheDirectory = cacheDirectory;
+    mHandles.resize(mFiles.size());
+    mResolveFiles = true;
+}
+
+std::string ImagePanel::thumbnailKey(size_t index) const {
+    /* Like the thumbnail files of the loader, cached images of a file that
+       has been modified since are not reused */
+    const std::string &filename = mFiles[index];
+    int64_t mtime = 0, fileSize = 0;
+#if defined(_WIN32)
+    struct _stat64 st;
+    if (_stat64(filename.c_str(), &st) == 0) {
+#else
+    struct stat st;
+    if (stat(filename.c_str(), &st) == 0) {
+#endif
+        mtime = (int64_t) st.st_mtime;
+        fileSize = (int64_t) st.st_size;
+    }
+    return "thumb:" + std::to_string(mThumbSize) + ":" + std::to_string(mtime) + ":" +
+           std::to_string(fileSize) + ":" + filename;
+}
+
+void ImagePanel::updateThumbnails(NVGcontext *ctx) {
+    ImageCache *cache = ImageCache::get(ctx);
+
+    if (mResolveFiles) {
+        for (size_t i = 0; i < mFiles.size(); ++i) {
+            int image = cache->acquire(thumbnailKey(i));
+            if (image) {
+                mImages[i].first = image;
+                mHandles[i] = ImageCache::Handle(ctx, image, false);
+                continue;
+            }
+            if (!mLoader)
+                mLoader = new ImageLoader(mThumbSize, mCacheDirectory);
+            mLoader->enqueue(mFiles[i]);
+            mLoaderSlots.push_back(i);
+        }
+        mResolveFiles = false;
+    }
+
+    /* Upload a bounded number of finished thumbnails per frame */
+    if (mLoader) {
+        mLoader->upload(ctx, [&](size_t index, int image) {
+            size_t slot = mLoaderSlots[index];
+            if (image != 0) {
+                image = cache->insert(thumbnailKey(slot), image);
+                mHandles[slot] = ImageCache::Handle(ctx, image, false);
+            }
+            mImages[slot].first = image;
+        });
+        if (mLoader->done()) {
+            mLoader = nullptr;
+            mLoaderSlots.clear();
+        }
+    }
+}
+
 Vector2i ImagePanel::gridSize() const {
     int nCols = 1 + std::max(0,
         (int) ((mSize.x() - 2 * mMargin - mThumbSize) /
@@ -41,7 +122,11 @@ int ImagePanel::indexForPosition(const Vector2i &p) const {
 
 bool ImagePanel::mouseMotionEvent(const Vector2i &p, const Vector2i & /* rel */,
                               int /* button */, int /* modifiers */) {
-    mMouseIndex = indexForPosition(p);
+    int index = indexForPosition(p);
+    if (index != mMouseIndex) {
+        mMouseIndex = index;
+        markDirty();
+    }
     return true;
 }
 
@@ -64,12 +149,27 @@ Vector2i ImagePanel::preferredSize(NVGcontext *) const {
 void ImagePanel::draw(NVGcontext* ctx) {
     Vector2i grid = gridSize();
 
+    if (mResolveFiles || mLoader)
+        updateThumbnails(ctx);
+
     for (size_t i=0; i<mImages.size(); ++i) {
         Vector2i p = mPos + Vector2i::Constant(mMargin) +
             Vector2i((int) i % grid.x(), (int) i / grid.x()) * (mThumbSize + mSpacing);
+
+        if (mImages[i].first == 0) {
+            nvgBeginPath(ctx);
+            nvgRoundedRect(ctx, p.x()+0.5f,p.y()+0.5f, mThumbSize-1,mThumbSize-1, 4-0.5f);
+            nvgFillColor(ctx, nvgRGBA(255,255,255, mMouseIndex == (int)i ? 32 : 16));
+            nvgFill(ctx);
+            nvgStrokeWidth(ctx, 1.0f);
+            nvgStrokeColor(ctx, nvgRGBA(255,255,255,48));
+            nvgStroke(ctx);
+            continue;
+        }
+
         int imgw, imgh;
 
-        nvgImageSize(ctx, mImages[i].first, &imgw, &imgh);
+        nvgIconSize(ctx, mImages[i].first, &imgw, &imgh);
         float iw, ih, ix, iy;
         if (imgw < imgh) {
             iw = mThumbSize;
@@ -83,7 +183,7 @@ void ImagePanel::draw(NVGcontext* ctx) {
             iy = 0;
         }
 
-        NVGpaint imgPaint = nvgImagePattern(
+        NVGpaint imgPaint = nvgIconPattern(
             ctx, p.x() + ix, p.y()+ iy, iw, ih, 0, mImages[i].first,
             mMouseIndex == (int)i ? 1.0 : 0.7);
 
@@ -15,31 +15,19 @@
 #include <nanogui/window.h>
 #include <nanogui/screen.h>
 #include <nanogui/theme.h>
+#include <algorithm>
 #include <cmath>
+#include <condition_variable>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 NAMESPACE_BEGIN(nanogui)
 
 namespace {
-    std::vector<std::string> tokenize(const std::string &string,
-                                      const std::string &delim = "\n",
-                                      bool includeEmpty = false) {
-        std::string::size_type lastPos = 0, pos = string.find_first_of(delim, lastPos);
-        std::vector<std::string> tokens;
-
-        while (lastPos != std::string::npos) {
-            std::string substr = string.substr(lastPos, pos - lastPos);
-            if (!substr.empty() || includeEmpty)
-                tokens.push_back(std::move(substr));
-            lastPos = pos;
-            if (lastPos != std::string::npos) {
-                lastPos += 1;
-                pos = string.find_first_of(delim, lastPos);
-            }
-        }
-
-        return tokens;
-    }
-
     constexpr char const *const defaultImageViewVertexShader =
         R"(#version 330
         uniform vec2 scaleFactor;
@@ -55,23 +43,548 @@ namespace {
 
         })";
 
-    constexpr char const *const defaultImageViewFragmentShader =
+    /* Shared by the display and reduction shaders, which prepend it */
+    constexpr char const *const channelValueFunction =
         R"(#version 330
-        uniform sampler2D image;
+        float channelValue(vec4 c, int channel) {
+            if (channel == 1) return c.r;
+            if (channel == 2) return c.g;
+            if (channel == 3) return c.b;
+            if (channel == 4) return c.a;
+            return dot(c.rgb, vec3(0.2126, 0.7152, 0.0722));
+        }
+        )";
+
+    constexpr char const *const defaultImageViewFragmentShader =
+        R"(uniform sampler2D image;
+        uniform sampler2D statistics;
+        uniform float exposure;
+        uniform float invGamma;
+        uniform int channel;
+        uniform bool falseColor;
+        uniform bool autoExposure;
         out vec4 color;
         in vec2 uv;
+
+        /* Polynomial fit of the viridis color map */
+        vec3 colorMap(float t) {
+            const vec3 c0 = vec3(0.2777273, 0.0054073, 0.3340998);
+            const vec3 c1 = vec3(0.1050930, 1.4046135, 1.3845902);
+            const vec3 c2 = vec3(-0.3308618, 0.2148476, 0.0950952);
+            const vec3 c3 = vec3(-4.6342305, -5.7991010, -19.3324410);
+            const vec3 c4 = vec3(6.2282699, 14.1799334, 56.6905526);
+            const vec3 c5 = vec3(4.7763850, -13.7451454, -65.3530326);
+            const vec3 c6 = vec3(-5.4354559, 4.6458526, 26.3124352);
+            t = clamp(t, 0.0, 1.0);
+            return c0 + t*(c1 + t*(c2 + t*(c3 + t*(c4 + t*(c5 + t*c6)))));
+        }
+
         void main() {
-            color = texture(image, uv);
+            vec4 value = texture(image, uv);
+            if (channel != 0)
+                value = vec4(vec3(channelValue(value, channel)), channel == 4 ? 1.0 : value.a);
+
+            float scale = exposure;
+            if (autoExposure) {
+                vec4 s = texelFetch(statistics, ivec2(0), 0);
+                scale *= 0.18 / max(s.z / max(s.w, 1.0), 1e-6);
+            }
+            value.rgb *= scale;
+
+            if (falseColor)
+                value.rgb = colorMap(channelValue(value, channel == 4 ? 1 : channel));
+            else
+                value.rgb = pow(max(value.rgb, vec3(0.0)), vec3(invGamma));
+            color = value;
+        })";
+
+    /* Full screen triangle for the reduction passes */
+    constexpr char const *const reductionVertexShader =
+        R"(#version 330
+        void main() {
+            vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+            gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+        })";
+
+    /* Every output texel holds the (minimum, maximum, sum, count) of a block
+       of 8x8 input texels. The first pass reads the channel value from the
+       image (channel >= 0), later passes combine partial results. */
+    constexpr char const *const reductionFragmentShader =
+        R"(uniform sampler2D source;
+        uniform ivec2 sourceSize;
+        uniform int channel;
+        out vec4 result;
+        void main() {
+            ivec2 base = ivec2(gl_FragCoord.xy) * 8;
+            vec4 r = vec4(3.0e38, -3.0e38, 0.0, 0.0);
+            for (int y = 0; y < 8; ++y) {
+                for (int x = 0; x < 8; ++x) {
+                    ivec2 p = base + ivec2(x, y);
+                    if (p.x >= sourceSize.x || p.y >= sourceSize.y)
+                        continue;
+                    vec4 s = texelFetch(source, p, 0);
+                    if (channel >= 0) {
+                        float v = channelValue(s, channel);
+                        if (isnan(v) || isinf(v))
+                            continue;
+                        s = vec4(v, v, v, 1.0);
+                    }
+                    r = vec4(min(r.x, s.x), max(r.y, s.y), r.z + s.z, r.w + s.w);
+                }
+            }
+            result = r;
         })";
 
+    /* One point per sample of a grid over the image, accumulated into the
+       bins of a one pixel high target using additive blending */
+    constexpr char const *const histogramVertexShader =
+        R"(uniform sampler2D source;
+        uniform sampler2D statistics;
+        uniform ivec2 sourceSize;
+        uniform ivec2 gridSize;
+        uniform int channel;
+        uniform int bins;
+        void main() {
+            ivec2 g = ivec2(gl_VertexID % gridSize.x, gl_VertexID / gridSize.x);
+            float v = channelValue(texelFetch(source, (g * sourceSize) / gridSize, 0), channel);
+            vec4 s = texelFetch(statistics, ivec2(0), 0);
+            float t = (v - s.x) / max(s.y - s.x, 1e-20);
+            float bin = clamp(floor(t * float(bins)), 0.0, float(bins - 1));
+            bool valid = !(isnan(v) || isinf(v));
+            gl_Position = vec4(valid ? (bin + 0.5) / float(bins) * 2.0 - 1.0 : 2.0, 0.0, 0.0, 1.0);
+        })";
+
+    constexpr char const *const histogramFragmentShader =
+        R"(#version 330
+        out vec4 result;
+        void main() {
+            result = vec4(1.0);
+        })";
+
+    constexpr char const *const tileVertexShader =
+        R"(#version 330
+        uniform vec2 scaleFactor;
+        uniform vec2 position;
+        uniform vec2 uvOffset;
+        uniform vec2 uvScale;
+        in vec2 vertex;
+        out vec2 uv;
+        void main() {
+            uv = uvOffset + vertex * uvScale;
+            vec2 scaledVertex = (vertex * scaleFactor) + position;
+            gl_Position  = vec4(2.0*scaledVertex.x - 1.0,
+                                1.0 - 2.0*scaledVertex.y,
+                                0.0, 1.0);
+        })";
+
+    uint64_t tileKey(int level, int x, int y) {
+        return ((uint64_t) level << 48) | ((uint64_t) y << 24) | (uint64_t) x;
+    }
+
+    void wakeMainloop() {
+#if !defined(NANOVG_GL2_IMPLEMENTATION) && !defined(NANOVG_GLES2_IMPLEMENTATION)
+        glfwPostEmptyEvent();
+#endif
+    }
 }
 
+int ImageTileSource::levelCount() const {
+    Vector2i s = size();
+    int levels = 1, extent = std::max(s.x(), s.y());
+    while (extent > tileSize()) {
+        extent = (extent + 1) / 2;
+        levels++;
+    }
+    return levels;
+}
+
+Vector2i ImageTileSource::levelSize(int level) const {
+    Vector2i s = size();
+    for (int i = 0; i < level; ++i)
+        s = ((s.array() + 1) / 2).matrix();
+    return s;
+}
+
+/**
+ * GPU cache of image tiles. Worker threads decode the requested tiles, which
+ * are uploaded to textures on the GUI thread. Resident tiles are evicted in
+ * least recently used order once the byte budget is exceeded.
+ */
+class ImageView::TileCache {
+public:
+    TileCache(ImageTileSource *source, size_t budget)
+        : mShared(std::make_shared<Shared>(source)), mTileSize(source->tileSize()),
+          mBudget(budget) {
+        /* The workers keep the shared state alive, so they are never joined */
+        unsigned int workers = std::max(1u, std::min(4u, std::thread::hardware_concurrency() / 2));
+        for (unsigned int i = 0; i < workers; ++i)
+            std::thread(&TileCache::workerLoop, mShared).detach();
+    }
+
+    ~TileCache() {
+        /* Don't wait for a slow readTile() on the GUI thread */
+        {
+            std::lock_guard<std::mutex> guard(mShared->mutex);
+            mShared->shutdown = true;
+            mShared->pending.clear();
+            mShared->decoded.clear();
+        }
+        mShared->wake.notify_all();
+        for (auto &kv : mResident)
+            glDeleteTextures(1, &kv.second.texture);
+        if (!mFreeTextures.empty())
+            glDeleteTextures((GLsizei) mFreeTextures.size(), mFreeTextures.data());
+    }
+
+    int tileSize() const { return mTileSize; }
+
+    void setBudget(size_t budget) { mBudget = budget; evict(0); }
+
+    /// Return the texture of a resident tile (or 0) and mark it as recently used
+    GLuint lookup(uint64_t key) {
+        auto it = mResident.find(key);
+        if (it == mResident.end())
+            return 0;
+        mLRU.splice(mLRU.begin(), mLRU, it->second.lru);
+        return it->second.texture;
+    }
+
+    /// Replace the pending requests, which are ordered by decreasing priority
+    void request(const std::vector<uint64_t> &keys) {
+        {
+            std::lock_guard<std::mutex> guard(mShared->mutex);
+            mShared->pending.clear();
+            for (auto it = keys.rbegin(); it != keys.rend(); ++it) {
+                if (mResident.find(*it) == mResident.end() &&
+                    mShared->inFlight.find(*it) == mShared->inFlight.end())
+                    mShared->pending.push_back(*it);
+            }
+        }
+        mShared->wake.notify_all();
+    }
+
+    /// Upload decoded tiles, returns \c true if more are waiting
+    bool upload(size_t maxTiles) {
+        std::vector<Decoded> decoded;
+        bool more;
+        {
+            std::lock_guard<std::mutex> guard(mShared->mutex);
+            std::vector<Decoded> &queue = mShared->decoded;
+            size_t count = std::min(maxTiles, queue.size());
+            decoded.assign(std::make_move_iterator(queue.begin()),
+                           std::make_move_iterator(queue.begin() + count));
+            queue.erase(queue.begin(), queue.begin() + count);
+            more = !queue.empty();
+        }
+
+        size_t tileBytes = (size_t) mTileSize * mTileSize * 4;
+        for (auto &tile : decoded) {
+            evict(tileBytes);
+            GLuint texture;
+            if (!mFreeTextures.empty()) {
+                texture = mFreeTextures.back();
+                mFreeTextures.pop_back();
+                glBindTexture(GL_TEXTURE_2D, texture);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, mTileSize, mTileSize,
+                                GL_RGBA, GL_UNSIGNED_BYTE, tile.data.data());
+            } else {
+                glGenTextures(1, &texture);
+                glBindTexture(GL_TEXTURE_2D, texture);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, mTileSize, mTileSize, 0,
+                             GL_RGBA, GL_UNSIGNED_BYTE, tile.data.data());
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            }
+            mLRU.push_front(tile.key);
+            mResident[tile.key] = Resident { texture, mLRU.begin() };
+            mResidentBytes += tileBytes;
+        }
+
+        if (!decoded.empty()) {
+            std::lock_guard<std::mutex> guard(mShared->mutex);
+            for (auto &tile : decoded)
+                mShared->inFlight.erase(tile.key);
+        }
+        return more;
+    }
+
+private:
+    struct Decoded {
+        uint64_t key;
+        std::vector<uint8_t> data;
+    };
+
+    struct Resident {
+        GLuint texture;
+        std::list<uint64_t>::iterator lru;
+    };
+
+    /// Queues shared with the worker threads, which may outlive the cache
+    struct Shared {
+        Shared(ImageTileSource *source) : source(source) { }
+
+        ref<ImageTileSource> source;
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool shutdown = false;
+        std::vector<uint64_t> pending;
+        std::unordered_set<uint64_t> inFlight;
+        std::vector<Decoded> decoded;
+    };
+
+    /// Evict tiles until \c bytes more fit into the budget
+    void evict(size_t bytes) {
+        size_t tileBytes = (size_t) mTileSize * mTileSize * 4;
+        while (!mLRU.empty() && mResidentBytes + bytes > mBudget) {
+            auto it = mResident.find(mLRU.back());
+            mFreeTextures.push_back(it->second.texture);
+            mResident.erase(it);
+            mLRU.pop_back();
+            mResidentBytes -= tileBytes;
+        }
+        /* Keep a few spare textures for reuse, release the rest */
+        while (mFreeTextures.size() > 16) {
+            glDeleteTextures(1, &mFreeTextures.back());
+            mFreeTextures.pop_back();
+        }
+    }
+
+    static void workerLoop(std::shared_ptr<Shared> shared) {
+        std::vector<uint8_t> data;
+        int tileSize = shared->source->tileSize();
+        while (true) {
+            uint64_t key;
+            {
+                std::unique_lock<std::mutex> lock(shared->mutex);
+                shared->wake.wait(lock, [&]() { return shared->shutdown || !shared->pending.empty(); });
+                if (shared->shutdown)
+                    return;
+                key = shared->pending.back();
+                shared->pending.pop_back();
+                shared->inFlight.insert(key);
+            }
+
+            data.resize((size_t) tileSize * tileSize * 4);
+            bool success = false;
+            try {
+                success = shared->source->readTile((int) (key >> 48),
+                    Vector2i((int) (key & 0xFFFFFF), (int) ((key >> 24) & 0xFFFFFF)), data.data());
+            } catch (const std::exception &e) {
+                std::cerr << "Caught exception in ImageTileSource::readTile(): " << e.what() << std::endl;
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(shared->mutex);
+                if (shared->shutdown)
+                    return;
+                if (success)
+                    shared->decoded.push_back(Decoded { key, std::move(data) });
+                else
+                    shared->inFlight.erase(key);
+            }
+            if (success)
+                wakeMainloop();
+            data = std::vector<uint8_t>();
+        }
+    }
+
+    std::shared_ptr<Shared> mShared;
+    int mTileSize;
+    size_t mBudget;
+
+    // GUI thread only
+    std::unordered_map<uint64_t, Resident> mResident;
+    std::list<uint64_t> mLRU;
+    std::vector<GLuint> mFreeTextures;
+    size_t mResidentBytes = 0;
+};
+
+/**
+ * Min/max/mean and histogram of the displayed channel, computed by a chain of
+ * render passes. The final 1x1 level stays on the GPU for auto exposure, and
+ * results are copied to a pixel buffer that is mapped once a fence signals
+ * completion, so the GUI thread never waits for the GPU.
+ */
+class ImageView::Reduction {
+public:
+    Reduction() {
+        mReduceShader.init("ImageViewReductionShader", reductionVertexShader,
+                           std::string(channelValueFunction) + reductionFragmentShader);
+        mHistogramShader.init("ImageViewHistogramShader",
+                              std::string(channelValueFunction) + histogramVertexShader,
+                              histogramFragmentShader);
+        createTarget(mHistogram, Vector2i(HistogramBins, 1), GL_R32F, GL_RED);
+
+        glGenBuffers(1, &mReadback);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, mReadback);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (4 + HistogramBins) * sizeof(float), nullptr, GL_STREAM_READ);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    ~Reduction() {
+        if (mFence)
+            glDeleteSync(mFence);
+        glDeleteBuffers(1, &mReadback);
+        releaseLevels();
+        releaseTarget(mHistogram);
+        mHistogramShader.free();
+        mReduceShader.free();
+    }
+
+    /// Texture whose single texel holds (minimum, maximum, sum, count)
+    GLuint result() const { return mLevels.empty() ? 0 : mLevels.back().texture; }
+
+    /// Is a readback still in flight?
+    bool pending() const { return mFence != nullptr; }
+
+    void run(GLuint image, const Vector2i &size, int channel) {
+        GLint framebuffer, viewport[4], blendSrcRGB, blendDstRGB, blendSrcAlpha, blendDstAlpha;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glGetIntegerv(GL_BLEND_SRC_RGB, &blendSrcRGB);
+        glGetIntegerv(GL_BLEND_DST_RGB, &blendDstRGB);
+        glGetIntegerv(GL_BLEND_SRC_ALPHA, &blendSrcAlpha);
+        glGetIntegerv(GL_BLEND_DST_ALPHA, &blendDstAlpha);
+        GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST), blend = glIsEnabled(GL_BLEND);
+        glDisable(GL_SCISSOR_TEST);
+        glDisable(GL_BLEND);
+
+        if (size != mSourceSize) {
+            releaseLevels();
+            Vector2i levelSize = size;
+            do {
+                levelSize = ((levelSize.array() + 7) / 8).matrix();
+                mLevels.emplace_back();
+                createTarget(mLevels.back(), levelSize, GL_RGBA32F, GL_RGBA);
+            } while (levelSize != Vector2i(1, 1));
+            mSourceSize = size;
+        }
+
+        mReduceShader.bind();
+        glActiveTexture(GL_TEXTURE0);
+        mReduceShader.setUniform("source", 0);
+        GLuint source = image;
+        Vector2i sourceSize = size;
+        for (size_t i = 0; i < mLevels.size(); ++i) {
+            glBindFramebuffer(GL_FRAMEBUFFER, mLevels[i].framebuffer);
+            glViewport(0, 0, mLevels[i].size.x(), mLevels[i].size.y());
+            glBindTexture(GL_TEXTURE_2D, source);
+            mReduceShader.setUniform("sourceSize", sourceSize);
+            mReduceShader.setUniform("channel", i == 0 ? channel : -1);
+            mReduceShader.drawArray(GL_TRIANGLES, 0, 3);
+            source = mLevels[i].texture;
+            sourceSize = mLevels[i].size;
+        }
+
+        /* Histogram of at most 512x512 samples */
+        Vector2i gridSize = size.cwiseMin(Vector2i::Constant(512));
+        glBindFramebuffer(GL_FRAMEBUFFER, mHistogram.framebuffer);
+        glViewport(0, 0, HistogramBins, 1);
+        glClearColor(0.f, 0.f, 0.f, 0.f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        mHistogramShader.bind();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, image);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, result());
+        mHistogramShader.setUniform("source", 0);
+        mHistogramShader.setUniform("statistics", 1);
+        mHistogramShader.setUniform("sourceSize", size);
+        mHistogramShader.setUniform("gridSize", gridSize);
+        mHistogramShader.setUniform("channel", channel);
+        mHistogramShader.setUniform("bins", HistogramBins);
+        mHistogramShader.drawArray(GL_POINTS, 0, (uint32_t) gridSize.prod());
+        glActiveTexture(GL_TEXTURE0);
+
+        /* Queue the copy into the pixel buffer, which completes asynchronously */
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, mReadback);
+        glBindFramebuffer(GL_FRAMEBUFFER, mLevels.back().framebuffer);
+        glReadPixels(0, 0, 1, 1, GL_RGBA, GL_FLOAT, nullptr);
+        glBindFramebuffer(GL_FRAMEBUFFER, mHistogram.framebuffer);
+        glReadPixels(0, 0, HistogramBins, 1, GL_RED, GL_FLOAT, (void *) (4 * sizeof(float)));
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (mFence)
+            glDeleteSync(mFence);
+        mFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        glBlendFuncSeparate(blendSrcRGB, blendDstRGB, blendSrcAlpha, blendDstAlpha);
+        if (!blend)
+            glDisable(GL_BLEND);
+        if (scissor)
+            glEnable(GL_SCISSOR_TEST);
+    }
+
+    /// Fetch the results of the last \ref run() if the GPU has finished it
+    bool poll(ImageStatistics &stats) {
+        if (!mFence || glClientWaitSync(mFence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            return false;
+        glDeleteSync(mFence);
+        mFence = nullptr;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, mReadback);
+        const float *data = (const float *) glMapBufferRange(
+            GL_PIXEL_PACK_BUFFER, 0, (4 + HistogramBins) * sizeof(float), GL_MAP_READ_BIT);
+        if (data) {
+            stats.minimum = data[0];
+            stats.maximum = data[1];
+            stats.mean = data[2] / std::max(data[3], 1.f);
+            stats.histogram.assign(data + 4, data + 4 + HistogramBins);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return data != nullptr;
+    }
+
+private:
+    struct Target {
+        GLuint texture = 0, framebuffer = 0;
+        Vector2i size;
+    };
+
+    static void createTarget(Target &target, const Vector2i &size, GLenum internalFormat, GLenum format) {
+        target.size = size;
+        glGenTextures(1, &target.texture);
+        glBindTexture(GL_TEXTURE_2D, target.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, size.x(), size.y(), 0, format, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glGenFramebuffers(1, &target.framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0);
+    }
+
+    static void releaseTarget(Target &target) {
+        glDeleteFramebuffers(1, &target.framebuffer);
+        glDeleteTextures(1, &target.texture);
+    }
+
+    void releaseLevels() {
+        for (auto &level : mLevels)
+            releaseTarget(level);
+        mLevels.clear();
+        mSourceSize = Vector2i::Zero();
+    }
+
+    GLShader mReduceShader, mHistogramShader;
+    std::vector<Target> mLevels;
+    Target mHistogram;
+    Vector2i mSourceSize = Vector2i::Zero();
+    GLuint mReadback = 0;
+    GLsync mFence = nullptr;
+};
+
 ImageView::ImageView(Widget* parent, GLuint imageID)
     : Widget(parent), mImageID(imageID), mScale(1.0f), mOffset(Vector2f::Zero()),
     mFixedScale(false), mFixedOffset(false), mPixelInfoCallback(nullptr) {
     updateImageParameters();
     mShader.init("ImageViewShader", defaultImageViewVertexShader,
-                 defaultImageViewFragmentShader);
+                 std::string(channelValueFunction) + defaultImageViewFragmentShader);
 
     MatrixXu indices(3, 2);
     indices.col(0) << 0, 1, 2;
@@ -89,15 +602,131 @@ ImageView::ImageView(Widget* parent, GLuint imageID)
 }
 
 ImageView::~ImageView() {
+    mReduction.reset();
+    if (mOwnedImage)
+        glDeleteTextures(1, &mOwnedImage);
+    mTiles.reset();
+    mTileShader.free();
     mShader.free();
 }
 
+void ImageView::setTileSource(ImageTileSource *source) {
+    mTiles.reset();
+    mTileSource = source;
+    if (source) {
+        if (mTileShader.name().empty()) {
+            mTileShader.init("ImageViewTileShader", tileVertexShader,
+                             std::string(channelValueFunction) + defaultImageViewFragmentShader);
+            mTileShader.bind();
+            mTileShader.shareAttrib(mShader, "indices");
+            mTileShader.shareAttrib(mShader, "vertex");
+        }
+        mTiles.reset(new TileCache(source, mTileBudget));
+    }
+    invalidatePixelInfo();
+    updateImageParameters();
+    fit();
+}
+
+void ImageView::setTileBudget(size_t bytes) {
+    mTileBudget = bytes;
+    if (mTiles)
+        mTiles->setBudget(bytes);
+}
+
 void ImageView::bindImage(GLuint imageId) {
+    /* A bound image replaces the tile source */
+    mTiles.reset();
+    mTileSource = nullptr;
     mImageID = imageId;
+    invalidatePixelInfo();
     updateImageParameters();
     fit();
 }
 
+void ImageView::uploadImage(const void *data, const Vector2i &size, int channels, GLenum type) {
+    if (channels < 1 || channels > 4)
+        throw std::runtime_error("ImageView::setImageData(): invalid number of channels!");
+
+    static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    static const GLenum formats8[] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+    static const GLenum formats16F[] = { GL_R16F, GL_RG16F, GL_RGB16F, GL_RGBA16F };
+    static const GLenum formats32F[] = { GL_R32F, GL_RG32F, GL_RGB32F, GL_RGBA32F };
+    GLenum internalFormat;
+    switch (type) {
+        case GL_UNSIGNED_BYTE: internalFormat = formats8[channels - 1]; break;
+        case GL_HALF_FLOAT: internalFormat = formats16F[channels - 1]; break;
+        case GL_FLOAT: internalFormat = formats32F[channels - 1]; break;
+        default:
+            throw std::runtime_error("ImageView::setImageData(): unsupported component type!");
+    }
+
+    bool sameImage = mOwnedImage != 0 && mImageID == mOwnedImage && size == mImageSize &&
+                     !mTiles;
+    if (!mOwnedImage)
+        glGenTextures(1, &mOwnedImage);
+    glBindTexture(GL_TEXTURE_2D, mOwnedImage);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, size.x(), size.y(), 0,
+                 formats[channels - 1], type, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    /* Show gray and gray+alpha images as such rather than in red and green */
+    GLint swizzle[4] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+    if (channels == 1)
+        swizzle[1] = swizzle[2] = GL_RED, swizzle[3] = GL_ONE;
+    else if (channels == 2)
+        swizzle[1] = swizzle[2] = GL_RED, swizzle[3] = GL_GREEN;
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+
+    /* Keep the view when only the contents changed */
+    if (sameImage)
+        invalidatePixelInfo();
+    else
+        bindImage(mOwnedImage);
+}
+
+void ImageView::setDisplayUniforms(GLShader &shader) {
+    bool autoExposure = mAutoExposure && mReduction && mReduction->result() && !mTiles;
+    if (autoExposure) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, mReduction->result());
+        glActiveTexture(GL_TEXTURE0);
+    }
+    /* Custom shaders (see imageShader()) need not declare these */
+    shader.setUniform("statistics", 1, false);
+    shader.setUniform("exposure", std::pow(2.f, mExposure), false);
+    shader.setUniform("invGamma", 1.f / mGamma, false);
+    shader.setUniform("channel", (int) mChannel, false);
+    shader.setUniform("falseColor", (int) mFalseColor, false);
+    shader.setUniform("autoExposure", (int) autoExposure, false);
+}
+
+void ImageView::computeStatistics() {
+    if ((!mAutoExposure && !mStatisticsCallback) || mTiles || (mImageSize.array() <= 0).any())
+        return;
+    if (!mReduction)
+        mReduction.reset(new Reduction());
+
+    if (mStatisticsRevision != mImageRevision || mStatisticsChannel != mChannel) {
+        mReduction->run(mImageID, mImageSize, (int) mChannel);
+        mStatisticsRevision = mImageRevision;
+        mStatisticsChannel = mChannel;
+    }
+
+    ImageStatistics stats;
+    if (mReduction->poll(stats)) {
+        if (mStatisticsCallback)
+            mStatisticsCallback(stats);
+    } else if (mReduction->pending()) {
+        wakeMainloop();
+    }
+}
+
 Vector2f ImageView::imageCoordinateAt(const Vector2f& position) const {
     auto imagePosition = position - mOffset;
     return imagePosition / mScale;
@@ -174,7 +803,7 @@ bool ImageView::gridVisible() const {
 }
 
 bool ImageView::pixelInfoVisible() const {
-    return mPixelInfoCallback && (mPixelInfoThreshold != -1) && (mScale > mPixelInfoThreshold);
+    return (mPixelInfoCallback || mPixelInfoBatchCallback) && (mPixelInfoThreshold != -1) && (mScale > mPixelInfoThreshold);
 }
 
 bool ImageView::helpersVisible() const {
@@ -303,13 +932,19 @@ void ImageView::draw(NVGcontext* ctx) {
     glScissor(positionInScreen.x() * r,
               (screenSize.y() - positionInScreen.y() - size().y()) * r,
               size().x() * r, size().y() * r);
-    mShader.bind();
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, mImageID);
-    mShader.setUniform("image", 0);
-    mShader.setUniform("scaleFactor", scaleFactor);
-    mShader.setUniform("position", imagePosition);
-    mShader.drawIndexed(GL_TRIANGLES, 0, 2);
+    if (mTiles) {
+        drawTiles(positionInScreen, screenSize);
+    } else {
+        computeStatistics();
+        mShader.bind();
+        setDisplayUniforms(mShader);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, mImageID);
+        mShader.setUniform("image", 0);
+        mShader.setUniform("scaleFactor", scaleFactor);
+        mShader.setUniform("position", imagePosition);
+        mShader.drawIndexed(GL_TRIANGLES, 0, 2);
+    }
     glDisable(GL_SCISSOR_TEST);
 
     if (helpersVisible())
@@ -318,7 +953,81 @@ void ImageView::draw(NVGcontext* ctx) {
     drawWidgetBorder(ctx);
 }
 
+void ImageView::drawTiles(const Vector2f& positionInScreen, const Vector2f& screenSize) {
+    const int maxUploadsPerFrame = 8;
+    if (mTiles->upload(maxUploadsPerFrame))
+        wakeMainloop();
+
+    int tileSize = mTiles->tileSize();
+    int levels = mTileSource->levelCount();
+    int level = std::min(std::max((int) std::floor(std::log2(1.f / mScale)), 0), levels - 1);
+
+    // Tiles of the chosen level that intersect the visible part of the image.
+    Vector2f topLeft = clampedImageCoordinateAt(Vector2f::Zero());
+    Vector2f bottomRight = clampedImageCoordinateAt(sizeF());
+    Vector2f center = (topLeft + bottomRight) / 2;
+    auto tileExtent = [tileSize](int l) { return (float) tileSize * (float) (1 << l); };
+    float extent = tileExtent(level);
+    Vector2i levelTiles = ((mTileSource->levelSize(level).array() + tileSize - 1) / tileSize).matrix();
+    Vector2i first = (topLeft / extent).cast<int>();
+    Vector2i last = (bottomRight / extent).array().ceil().cast<int>().matrix().cwiseMin(levelTiles);
+
+    // The coarsest level is always requested first, so there's a fallback for every tile.
+    mTileRequests.clear();
+    mTileRequests.push_back(tileKey(levels - 1, 0, 0));
+    size_t firstVisible = mTileRequests.size();
+
+    mTileShader.bind();
+    setDisplayUniforms(mTileShader);
+    glActiveTexture(GL_TEXTURE0);
+    mTileShader.setUniform("image", 0);
+    for (int y = first.y(); y < last.y(); ++y) {
+        for (int x = first.x(); x < last.x(); ++x) {
+            Vector2f origin = Vector2f((float) x, (float) y) * extent;
+            Vector2f size = (imageSizeF() - origin).cwiseMin(Vector2f::Constant(extent));
+
+            // Use the finest resident level that covers this tile.
+            GLuint texture = 0;
+            int l = level;
+            for (; l < levels && !texture; ++l) {
+                Vector2i tile = (origin / tileExtent(l)).cast<int>();
+                texture = mTiles->lookup(tileKey(l, tile.x(), tile.y()));
+            }
+            if (l - 1 != level || !texture)
+                mTileRequests.push_back(tileKey(level, x, y));
+            if (!texture)
+                continue;
+            --l;
+
+            Vector2f tileOrigin = (origin / tileExtent(l)).array().floor().matrix() * tileExtent(l);
+            float levelScale = 1.f / (float) (1 << l);
+            mTileShader.setUniform("uvOffset", ((origin - tileOrigin) * levelScale / tileSize).eval());
+            mTileShader.setUniform("uvScale", (size * levelScale / tileSize).eval());
+            mTileShader.setUniform("scaleFactor", (mScale * size).cwiseQuotient(screenSize).eval());
+            mTileShader.setUniform("position",
+                (positionInScreen + mOffset + mScale * origin).cwiseQuotient(screenSize).eval());
+            glBindTexture(GL_TEXTURE_2D, texture);
+            mTileShader.drawIndexed(GL_TRIANGLES, 0, 2);
+        }
+    }
+
+    // Missing tiles nearest to the center of the view are decoded first.
+    std::sort(mTileRequests.begin() + firstVisible, mTileRequests.end(),
+              [&](uint64_t a, uint64_t b) {
+        auto distance = [&](uint64_t key) {
+            Vector2f tile((float) (key & 0xFFFFFF), (float) ((key >> 24) & 0xFFFFFF));
+            return ((tile + Vector2f::Constant(0.5f)) * extent - center).squaredNorm();
+        };
+        return distance(a) < distance(b);
+    });
+    mTiles->request(mTileRequests);
+}
+
 void ImageView::updateImageParameters() {
+    if (mTileSource) {
+        mImageSize = mTileSource->size();
+        return;
+    }
     // Query the width of the OpenGL texture.
     glBindTexture(GL_TEXTURE_2D, mImageID);
     GLint w, h;
@@ -403,49 +1112,98 @@ void ImageView::drawPixelInfo(NVGcontext* ctx, float stride) const {
                                .unaryExpr([](float x) { return std::ceil(x); })
                                .cast<int>();
 
+    if ((bottomRight - topLeft).minCoeff() <= 0)
+        return;
+    updatePixelInfo(topLeft, bottomRight);
+
     // Extract the positions for where to draw the text.
     Vector2f currentCellPosition =
         (positionF() + positionForCoordinate(topLeft.cast<float>()));
-
     float xInitialPosition = currentCellPosition.x();
-    int xInitialIndex = topLeft.x();
 
     // Properly scale the pixel information for the given stride.
     auto fontSize = stride * mFontScaleFactor;
     static constexpr float maxFontSize = 30.0f;
     fontSize = fontSize > maxFontSize ? maxFontSize : fontSize;
+
+    // The font state is shared by all labels, only the fill color changes between them.
     nvgBeginPath(ctx);
-    nvgFontSize(ctx, fontSize);
+    mTheme->setFont(ctx, "sans", fontSize);
     nvgTextAlign(ctx, NVG_ALIGN_CENTER | NVG_ALIGN_TOP);
-    nvgFontFace(ctx, "sans");
-    while (topLeft.y() != bottomRight.y()) {
-        while (topLeft.x() != bottomRight.x()) {
-            writePixelInfo(ctx, currentCellPosition, topLeft, stride, fontSize);
+    Color currentColor(0.0f, 0.0f, 0.0f, -1.0f);
+    for (int y = topLeft.y(); y != bottomRight.y(); ++y) {
+        size_t index = (size_t) (y - mPixelInfoOrigin.y()) * mPixelInfoExtent.x() +
+                       (topLeft.x() - mPixelInfoOrigin.x());
+        for (int x = topLeft.x(); x != bottomRight.x(); ++x) {
+            writePixelInfo(ctx, currentCellPosition, mPixelInfo[index++], stride,
+                           fontSize, currentColor);
             currentCellPosition.x() += stride;
-            ++topLeft.x();
         }
         currentCellPosition.x() = xInitialPosition;
         currentCellPosition.y() += stride;
-        ++topLeft.y();
-        topLeft.x() = xInitialIndex;
     }
 }
 
-void ImageView::writePixelInfo(NVGcontext* ctx, const Vector2f& cellPosition,
-                               const Vector2i& pixel, float stride, float fontSize) const {
-    auto pixelData = mPixelInfoCallback(pixel);
-    auto pixelDataRows = tokenize(pixelData.first);
+void ImageView::updatePixelInfo(const Vector2i& topLeft, const Vector2i& bottomRight) const {
+    if (!mPixelInfoBatchCallback) {
+        // The per-pixel callback may depend on external state, so it is queried every frame.
+        mPixelInfoOrigin = topLeft;
+        mPixelInfoExtent = bottomRight - topLeft;
+        mPixelInfo.resize((size_t) mPixelInfoExtent.prod());
+        size_t index = 0;
+        for (int y = topLeft.y(); y != bottomRight.y(); ++y)
+            for (int x = topLeft.x(); x != bottomRight.x(); ++x)
+                mPixelInfo[index++] = mPixelInfoCallback(Vector2i(x, y));
+        mPixelInfoRevision = (size_t) -1;
+        return;
+    }
 
-    // If no data is provided for this pixel then simply return.
-    if (pixelDataRows.empty())
+    // Reuse the cached block as long as it covers the visible pixels.
+    Vector2i cachedEnd = mPixelInfoOrigin + mPixelInfoExtent;
+    if (mPixelInfoRevision == mImageRevision &&
+        (topLeft.array() >= mPixelInfoOrigin.array()).all() &&
+        (bottomRight.array() <= cachedEnd.array()).all())
         return;
 
-    nvgFillColor(ctx, pixelData.second);
-    float yOffset = (stride - fontSize * pixelDataRows.size()) / 2;
-    for (size_t i = 0; i != pixelDataRows.size(); ++i) {
-        nvgText(ctx, cellPosition.x() + stride / 2, cellPosition.y() + yOffset,
-                pixelDataRows[i].data(), nullptr);
-        yOffset += fontSize;
+    // Round the block outwards to whole tiles, so that small pans don't trigger a refresh.
+    static constexpr int tileSize = 32;
+    mPixelInfoOrigin = (topLeft.array() / tileSize * tileSize).matrix();
+    Vector2i end = ((bottomRight.array() + (tileSize - 1)) / tileSize * tileSize).matrix();
+    mPixelInfoExtent = end.cwiseMin(mImageSize) - mPixelInfoOrigin;
+    mPixelInfo.resize((size_t) mPixelInfoExtent.prod());
+    mPixelInfoBatchCallback(mPixelInfoOrigin, mPixelInfoExtent, mPixelInfo);
+    if (mPixelInfo.size() != (size_t) mPixelInfoExtent.prod())
+        throw std::runtime_error("ImageView: the pixel info callback must not resize its output!");
+    mPixelInfoRevision = mImageRevision;
+}
+
+void ImageView::writePixelInfo(NVGcontext* ctx, const Vector2f& cellPosition, const PixelInfo& info,
+                               float stride, float fontSize, Color& currentColor) const {
+    const char *begin = info.first.data(), *end = begin + info.first.size();
+
+    // Count the non-empty rows, if no data is provided for this pixel then simply return.
+    size_t rows = 0;
+    for (const char *it = begin; it != end; ) {
+        const char *lineEnd = std::find(it, end, '\n');
+        rows += lineEnd != it;
+        it = lineEnd == end ? end : lineEnd + 1;
+    }
+    if (rows == 0)
+        return;
+
+    if (info.second != currentColor) {
+        nvgFillColor(ctx, info.second);
+        currentColor = info.second;
+    }
+
+    float yOffset = (stride - fontSize * rows) / 2;
+    for (const char *it = begin; it != end; ) {
+        const char *lineEnd = std::find(it, end, '\n');
+        if (lineEnd != it) {
+            nvgText(ctx, cellPosition.x() + stride / 2, cellPosition.y() + yOffset, it, lineEnd);
+            yOffset += fontSize;
+        }
+        it = lineEnd == end ? end : lineEnd + 1;
     }
 }
 
@@ -38,8 +38,7 @@ void Label::setTheme(Theme *theme) {
 Vector2i Label::preferredSize(NVGcontext *ctx) const {
     if (mCaption == "")
         return Vector2i::Zero();
-    nvgFontFace(ctx, mFont.c_str());
-    nvgFontSize(ctx, fontSize());
+    mTheme->setFont(ctx, mFont, fontSize());
     if (mFixedSize.x() > 0) {
         nvgTextAlign(ctx, (int)mHorizAlign | NVG_ALIGN_TOP);
         float bounds[4];
@@ -56,8 +55,7 @@ Vector2i Label::preferredSize(NVGcontext *ctx) const {
 
 void Label::draw(NVGcontext* ctx) {
     Widget::draw(ctx);
-    nvgFontFace(ctx, mFont.c_str());
-    nvgFontSize(ctx, fontSize());
+    mTheme->setFont(ctx, mFont, fontSize());
     if (mFixedSize.x() > 0) {
         nvgTextAlign(ctx, (int)mHorizAlign | NVG_ALIGN_TOP);
         if (mShowShadow) {
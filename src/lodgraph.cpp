@@ -0,0 +1,385 @@
+/*
+    src/lodgraph.cpp -- Graph widget for very large time series, which
+    are drawn from a multi-resolution min/max/mean pyramid
+
+    NanoGUI was developed by Wenzel Jakob <wenzel.jakob@epfl.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/lodgraph.h>
+#include <nanogui/opengl.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+NAMESPACE_BEGIN(nanogui)
+
+void MemorySampleSource::read(size_t offset, size_t count, float *out) const {
+    if (offset + count > mSamples.size())
+        throw std::runtime_error("MemorySampleSource::read(): out of bounds!");
+    memcpy(out, mSamples.data() + offset, count * sizeof(float));
+}
+
+MappedSampleSource::MappedSampleSource(const std::string &filename)
+    : mFilename(filename) {
+#if defined(_WIN32)
+    mFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (mFile == INVALID_HANDLE_VALUE) {
+        mFile = nullptr;
+        throw std::runtime_error("MappedSampleSource: could not open \"" + filename + "\"!");
+    }
+#else
+    mFile = open(filename.c_str(), O_RDONLY);
+    if (mFile < 0)
+        throw std::runtime_error("MappedSampleSource: could not open \"" + filename + "\"!");
+#endif
+    refresh();
+}
+
+MappedSampleSource::~MappedSampleSource() {
+    unmap();
+#if defined(_WIN32)
+    if (mFile)
+        CloseHandle(mFile);
+#else
+    if (mFile >= 0)
+        close(mFile);
+#endif
+}
+
+void MappedSampleSource::unmap() {
+#if defined(_WIN32)
+    if (mData)
+        UnmapViewOfFile(mData);
+    if (mMapping)
+        CloseHandle(mMapping);
+    mMapping = nullptr;
+#else
+    if (mData)
+        munmap(const_cast<float *>(mData), mMapped * sizeof(float));
+#endif
+    mData = nullptr;
+    mSize = mMapped = 0;
+}
+
+void MappedSampleSource::refresh() {
+#if defined(_WIN32)
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(mFile, &fileSize))
+        throw std::runtime_error("MappedSampleSource: could not query the size of \"" + mFilename + "\"!");
+    size_t size = (size_t) fileSize.QuadPart / sizeof(float);
+#else
+    struct stat st;
+    if (fstat(mFile, &st) != 0)
+        throw std::runtime_error("MappedSampleSource: could not query the size of \"" + mFilename + "\"!");
+    size_t size = (size_t) st.st_size / sizeof(float);
+#endif
+    if (size <= mMapped && mData) {
+        /* Samples appended within the reserved range are visible already */
+        mSize = size;
+        return;
+    }
+
+    unmap();
+    if (size == 0)
+        return;
+#if defined(_WIN32)
+    /* Read-only mappings can't extend past the end of the file */
+    mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mMapping)
+        mData = (const float *) MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, size * sizeof(float));
+    if (!mData)
+        throw std::runtime_error("MappedSampleSource: could not map \"" + mFilename + "\"!");
+    mMapped = size;
+#else
+    /* Reserve twice the current size, pages past the end of the file are
+       never touched since reads are limited to the file size */
+    size_t mapped = std::max(size * 2, (size_t) 1 << 20);
+    void *data = mmap(nullptr, mapped * sizeof(float), PROT_READ, MAP_SHARED, mFile, 0);
+    if (data == MAP_FAILED) {
+        mapped = size;
+        data = mmap(nullptr, mapped * sizeof(float), PROT_READ, MAP_SHARED, mFile, 0);
+    }
+    if (data == MAP_FAILED)
+        throw std::runtime_error("MappedSampleSource: could not map \"" + mFilename + "\"!");
+    mData = (const float *) data;
+    mMapped = mapped;
+#endif
+    mSize = size;
+}
+
+void MappedSampleSource::read(size_t offset, size_t count, float *out) const {
+    if (offset + count > mSize)
+        throw std::runtime_error("MappedSampleSource::read(): out of bounds!");
+    memcpy(out, mData + offset, count * sizeof(float));
+}
+
+const size_t LODGraph::BaseBlockSize;
+const size_t LODGraph::LevelFactor;
+const size_t LODGraph::UpdateBudget;
+
+LODGraph::LODGraph(Widget *parent, const std::string &caption)
+    : Graph(parent, caption) { }
+
+size_t LODGraph::binSize(size_t level) {
+    size_t size = BaseBlockSize;
+    while (level-- > 0)
+        size *= LevelFactor;
+    return size;
+}
+
+void LODGraph::setSource(SampleSource *source) {
+    mSource = source;
+    mLevels.clear();
+    mBuiltSamples = 0;
+    mSourceSize = 0;
+    mFitView = true;
+    update();
+}
+
+void LODGraph::setView(double start, double end) {
+    mViewStart = start;
+    mViewEnd = end;
+    mFitView = false;
+    mFollow = end >= (double) mBuiltSamples;
+    clampView();
+}
+
+void LODGraph::clampView() {
+    double n = (double) mBuiltSamples;
+    double span = std::min(std::max(mViewEnd - mViewStart, 2.0), n);
+    mViewStart = std::min(std::max(mViewStart, 0.0), n - span);
+    mViewEnd = mViewStart + span;
+}
+
+void LODGraph::update() {
+    if (!mSource)
+        return;
+    mSource->refresh();
+    size_t n = mSource->size();
+    mSourceSize = n;
+
+    if (n < mBuiltSamples) {
+        /* The data was replaced, start over */
+        mLevels.clear();
+        mBuiltSamples = 0;
+    }
+
+    /* Large sources are summarized over several calls, so that setting one
+       doesn't stall a frame; the samples covered so far are drawn meanwhile */
+    if (n - mBuiltSamples > UpdateBudget)
+        n = (mBuiltSamples + UpdateBudget) / BaseBlockSize * BaseBlockSize;
+
+    if (n > mBuiltSamples) {
+        if (mLevels.empty())
+            mLevels.emplace_back();
+
+        /* Summarize the new samples, including the last partial block */
+        const size_t chunkBins = 1024;
+        size_t firstBin = mBuiltSamples / BaseBlockSize;
+        std::vector<Bin> &base = mLevels[0];
+        base.resize((n + BaseBlockSize - 1) / BaseBlockSize);
+        mSamples.resize(chunkBins * BaseBlockSize);
+        for (size_t bin = firstBin; bin < base.size(); bin += chunkBins) {
+            size_t offset = bin * BaseBlockSize;
+            size_t count = std::min(n - offset, chunkBins * BaseBlockSize);
+            mSource->read(offset, count, mSamples.data());
+            for (size_t i = 0; i < count; i += BaseBlockSize) {
+                size_t blockSize = std::min(BaseBlockSize, count - i);
+                const float *block = mSamples.data() + i;
+                Bin b { block[0], block[0], 0.f };
+                double sum = 0;
+                for (size_t j = 0; j < blockSize; ++j) {
+                    b.min = std::min(b.min, block[j]);
+                    b.max = std::max(b.max, block[j]);
+                    sum += block[j];
+                }
+                b.mean = (float) (sum / blockSize);
+                base[bin + i / BaseBlockSize] = b;
+            }
+        }
+
+        /* Propagate the changed bins up the pyramid */
+        size_t dirty = firstBin;
+        for (size_t level = 0; mLevels[level].size() > 1; ++level) {
+            if (level + 1 == mLevels.size())
+                mLevels.emplace_back();
+            const std::vector<Bin> &lower = mLevels[level];
+            std::vector<Bin> &upper = mLevels[level + 1];
+            size_t lowerBinSize = binSize(level);
+            upper.resize((lower.size() + LevelFactor - 1) / LevelFactor);
+            for (size_t p = dirty / LevelFactor; p < upper.size(); ++p) {
+                size_t begin = p * LevelFactor, end = std::min(begin + LevelFactor, lower.size());
+                Bin b = lower[begin];
+                double sum = 0, weight = 0;
+                for (size_t c = begin; c < end; ++c) {
+                    /* Only the last bin of a level may be partially filled */
+                    double w = (double) std::min(lowerBinSize, n - c * lowerBinSize);
+                    b.min = std::min(b.min, lower[c].min);
+                    b.max = std::max(b.max, lower[c].max);
+                    sum += lower[c].mean * w;
+                    weight += w;
+                }
+                b.mean = (float) (sum / weight);
+                upper[p] = b;
+            }
+            dirty /= LevelFactor;
+        }
+
+        if (mFollow && !mFitView) {
+            double shift = (double) n - mViewEnd;
+            mViewStart += shift;
+            mViewEnd += shift;
+        }
+        mBuiltSamples = n;
+    }
+
+    if (mFitView) {
+        mViewStart = 0;
+        mViewEnd = (double) n;
+    }
+    clampView();
+}
+
+void LODGraph::drawPlot(NVGcontext *ctx) {
+    Graph::drawPlot(ctx);
+
+    update();
+    size_t n = mBuiltSamples, width = (size_t) std::max(mSize.x(), 0);
+    double span = mViewEnd - mViewStart;
+    if (n < 2 || width == 0 || span <= 0 || mMax == mMin)
+        return;
+
+    double samplesPerPixel = span / width;
+    float yScale = mSize.y() / (mMax - mMin);
+    float yBase = mPos.y() + mSize.y() + mMin * yScale;
+
+    if (samplesPerPixel <= 2) {
+        /* Zoomed in far enough to draw the individual samples */
+        size_t first = (size_t) std::floor(mViewStart);
+        size_t last = std::min(n, (size_t) std::ceil(mViewEnd) + 1);
+        mSamples.resize(last - first);
+        mSource->read(first, last - first, mSamples.data());
+        float xScale = mSize.x() / (float) span;
+        nvgBeginPath(ctx);
+        for (size_t i = first; i < last; ++i) {
+            float vx = mPos.x() + (float) (i - mViewStart) * xScale;
+            float vy = yBase - mSamples[i - first] * yScale;
+            if (i == first)
+                nvgMoveTo(ctx, vx, vy);
+            else
+                nvgLineTo(ctx, vx, vy);
+        }
+        nvgStrokeColor(ctx, Color(100, 255));
+        nvgStroke(ctx);
+        return;
+    }
+
+    /* Reduce the bins (or raw samples) overlapping each pixel column. The
+       level is chosen so that a column overlaps at most a handful of bins. */
+    size_t level = 0;
+    while (level + 1 < mLevels.size() && binSize(level + 1) <= samplesPerPixel)
+        ++level;
+    bool raw = samplesPerPixel < BaseBlockSize;
+    size_t size = raw ? 1 : binSize(level);
+    size_t count = raw ? n : mLevels[level].size();
+
+    size_t offset = 0;
+    if (raw) {
+        offset = (size_t) std::floor(mViewStart);
+        size_t last = std::min(n, (size_t) std::ceil(mViewEnd));
+        mSamples.resize(last - offset);
+        mSource->read(offset, last - offset, mSamples.data());
+    }
+    auto bin = [&](size_t i) -> Bin {
+        if (raw) {
+            float v = mSamples[i - offset];
+            return Bin { v, v, v };
+        }
+        return mLevels[level][i];
+    };
+
+    mColumns.resize(width);
+    for (size_t c = 0; c < width; ++c) {
+        double s0 = mViewStart + c * samplesPerPixel, s1 = s0 + samplesPerPixel;
+        size_t b0 = std::max((size_t) (s0 / size), raw ? offset : (size_t) 0);
+        size_t b1 = std::min((size_t) std::ceil(s1 / size), raw ? offset + mSamples.size() : count);
+        b1 = std::max(b1, b0 + 1);
+        Bin column = bin(b0);
+        double sum = 0;
+        for (size_t i = b0; i < b1; ++i) {
+            Bin b = bin(i);
+            column.min = std::min(column.min, b.min);
+            column.max = std::max(column.max, b.max);
+            sum += b.mean;
+        }
+        column.mean = (float) (sum / (b1 - b0));
+        mColumns[c] = column;
+    }
+
+    /* Envelope between the minima and maxima, and the mean on top */
+    nvgBeginPath(ctx);
+    for (size_t c = 0; c < width; ++c) {
+        float vx = mPos.x() + c + 0.5f, vy = yBase - mColumns[c].max * yScale;
+        if (c == 0)
+            nvgMoveTo(ctx, vx, vy);
+        else
+            nvgLineTo(ctx, vx, vy);
+    }
+    for (size_t c = width; c-- > 0; )
+        nvgLineTo(ctx, mPos.x() + c + 0.5f, yBase - mColumns[c].min * yScale);
+    nvgClosePath(ctx);
+    nvgFillColor(ctx, mForegroundColor);
+    nvgFill(ctx);
+
+    nvgBeginPath(ctx);
+    for (size_t c = 0; c < width; ++c) {
+        float vx = mPos.x() + c + 0.5f, vy = yBase - mColumns[c].mean * yScale;
+        if (c == 0)
+            nvgMoveTo(ctx, vx, vy);
+        else
+            nvgLineTo(ctx, vx, vy);
+    }
+    nvgStrokeColor(ctx, Color(100, 255));
+    nvgStroke(ctx);
+}
+
+bool LODGraph::mouseButtonEvent(const Vector2i &p, int button, bool down, int modifiers) {
+    if (Graph::mouseButtonEvent(p, button, down, modifiers))
+        return true;
+    return button == GLFW_MOUSE_BUTTON_1;
+}
+
+bool LODGraph::mouseDragEvent(const Vector2i &, const Vector2i &rel, int button, int) {
+    if (!(button & (1 << GLFW_MOUSE_BUTTON_1)) || mSize.x() <= 0 || mBuiltSamples < 2)
+        return false;
+    double shift = -rel.x() * (mViewEnd - mViewStart) / mSize.x();
+    setView(mViewStart + shift, mViewEnd + shift);
+    return true;
+}
+
+bool LODGraph::scrollEvent(const Vector2i &p, const Vector2f &rel) {
+    if (mSize.x() <= 0 || mBuiltSamples < 2)
+        return false;
+    double span = mViewEnd - mViewStart;
+    double pivot = mViewStart + (p.x() - mPos.x()) * span / mSize.x();
+    double scale = std::pow(1.2, -rel.y());
+    setView(pivot - (pivot - mViewStart) * scale, pivot + (mViewEnd - pivot) * scale);
+    return true;
+}
+
+NAMESPACE_END(nanogui)
@@ -16,6 +16,7 @@
 #include <nanogui/serializer/core.h>
 #include "nanogui/popupbutton.h"
 #include "nanogui/screen.h"
+#include <limits>
 
 NAMESPACE_BEGIN(nanogui)
 
@@ -52,6 +53,11 @@ void Popup::refreshRelativePlacement() {
     }
 }
 
+void Popup::drawBounds(Vector2i &min, Vector2i &max) const {
+    min = Vector2i::Constant(std::numeric_limits<int>::min() / 2);
+    max = Vector2i::Constant(std::numeric_limits<int>::max() / 2);
+}
+
 void Popup::draw(NVGcontext* ctx) {
 
     if (disposable() && !focused() && !mParentWindow->focused()) {
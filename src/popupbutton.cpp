@@ -47,8 +47,8 @@ void PopupButton::draw(NVGcontext* ctx) {
         NVGcolor textColor =
             mTextColor.w() == 0 ? mTheme->get<Color>("/text-color") : mTextColor;
 
-        nvgFontSize(ctx, (mFontSize < 0 ? mTheme->get<int>("/button/text-size") : mFontSize) * 1.5f);
-        nvgFontFace(ctx, "icons");
+        mTheme->setFont(ctx, "icons",
+            (mFontSize < 0 ? mTheme->get<int>("/button/text-size") : mFontSize) * 1.5f);
         nvgFillColor(ctx, mEnabled ? textColor : mTheme->get<Color>("/disabled-text-color"));
         nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_MIDDLE);
 
@@ -14,8 +14,13 @@
 #include <nanogui/screen.h>
 #include <nanogui/theme.h>
 #include <nanogui/opengl.h>
+#include <nanogui/glutil.h>
 #include <nanogui/window.h>
 #include <nanogui/popup.h>
+#include <nanogui/eventlog.h>
+#include <nanogui/imagecache.h>
+#include <nanogui/drawbatcher.h>
+#include <nanogui/softwarerenderer.h>
 #include <map>
 #include <iostream>
 
@@ -68,6 +73,22 @@ inline void nvgDeleteContext(NVGcontext* ctx) {
 #endif
 }
 
+int nvgCreateImageFromTexture(NVGcontext *ctx, GLuint texture, int width, int height,
+                              int imageFlags) {
+    imageFlags |= NVG_IMAGE_NODELETE;
+#if defined(NANOVG_GL2_IMPLEMENTATION)
+    return nvglCreateImageFromHandleGL2(ctx, texture, width, height, imageFlags);
+#elif defined(NANOVG_GL3_IMPLEMENTATION)
+    return nvglCreateImageFromHandleGL3(ctx, texture, width, height, imageFlags);
+#elif defined(NANOVG_GLES2_IMPLEMENTATION)
+    return nvglCreateImageFromHandleGLES2(ctx, texture, width, height, imageFlags);
+#elif defined(NANOVG_GLES3_IMPLEMENTATION)
+    return nvglCreateImageFromHandleGLES3(ctx, texture, width, height, imageFlags);
+#else
+#error No NANOVG_GL*_IMPLEMENTATION macro defined
+#endif
+}
+
 /* Calculate pixel ratio for hi-dpi devices. */
 static float get_pixel_ratio(GLFWwindow *window) {
 #if defined(_WIN32)
@@ -114,6 +135,13 @@ static float get_pixel_ratio(GLFWwindow *window) {
 #endif
 }
 
+/* Interrupt glfwWaitEvents() in the main loop, callable from any thread. */
+static void wake_mainloop() {
+#if !defined(NANOVG_GL2_IMPLEMENTATION) && !defined(NANOVG_GLES2_IMPLEMENTATION)
+    glfwPostEmptyEvent();
+#endif
+}
+
 Screen::Screen()
     : Widget(nullptr), mGLFWWindow(nullptr), mNVGContext(nullptr),
 #if !defined(NANOGUI_CURSOR_DISABLED)
@@ -337,14 +365,16 @@ void Screen::initialize(GLFWwindow *window, bool shutdownGLFWOnDestruct) {
     if (mNVGContext == nullptr){
         throw std::runtime_error("Could not initialize NanoVG!");
     }
+    /* Merge text and pixel-aligned rectangles into few draw calls */
+    nvgSetBatching(mNVGContext, true);
 
     mVisible = glfwGetWindowAttrib(window, GLFW_VISIBLE) != 0;
     setTheme(new Theme(mNVGContext));
     mMousePos = Vector2i::Zero();
     mMouseState = mModifiers = 0;
     mDragActive = false;
-    mLastInteraction = glfwGetTime();
-    mLastMouseDown = glfwGetTime();
+    mLastInteraction = time();
+    mLastMouseDown = time();
     mProcessEvents = true;
     __nanogui_screens[mGLFWWindow] = this;
 
@@ -367,7 +397,14 @@ void Screen::deinitialize() {
         }
     }
 #endif
+    setSoftwareRendering(false);
     if (mNVGContext){
+        /* Layers hold textures that NanoVG draws from */
+        for (Widget *child : mChildren) {
+            if (Window *window = dynamic_cast<Window *>(child))
+                window->releaseLayer();
+        }
+        ImageCache::destroy(mNVGContext);
         nvgDeleteContext(mNVGContext);
         mNVGContext = nullptr;
     }
@@ -383,6 +420,22 @@ Screen::~Screen() {
     deinitialize();
 }
 
+void Screen::setSoftwareRendering(bool software) {
+    if (software == softwareRendering())
+        return;
+    if (software) {
+        mSoftwareContext = nvgCreateSoftware();
+        if (!mSoftwareContext)
+            throw std::runtime_error("Could not initialize the software renderer!");
+    } else {
+        /* The texture of the OpenGL context is deleted by drawWidgets() */
+        ImageCache::destroy(mSoftwareContext);
+        nvgDeleteSoftware(mSoftwareContext);
+        mSoftwareContext = nullptr;
+    }
+    markLayersDirty();
+}
+
 void Screen::setVisible(bool visible) {
     if (mVisible != visible) {
         mVisible = visible;
@@ -411,28 +464,142 @@ void Screen::setSize(const Vector2i &size) {
 #endif
 }
 
+void Screen::post(CommandQueue::Command command) {
+    /* The command may update any widget */
+    auto wrapped = [this, command = std::move(command)]() {
+        command();
+        markLayersDirty();
+    };
+    if (mCommands.push(std::move(wrapped)))
+        wake_mainloop();
+}
+
+void Screen::post(const Widget *target, int slot, CommandQueue::Command command) {
+    /* The command supersedes a pending postUpdate() of the same slot, whose
+       value must not keep later updates from being queued */
+    {
+        std::lock_guard<std::mutex> guard(mUpdateMutex);
+        mPendingUpdates.erase(std::make_pair(target, slot));
+    }
+
+    /* Keep the target alive while the update is pending, which also keeps
+       its address from being reused by another pending target */
+    ref<const Widget> holder(target);
+    auto update = [holder, command = std::move(command)]() {
+        if (!holder->removed()) {
+            command();
+            /* Only the layer of the target's window needs to be rendered again */
+            const_cast<Widget *>(holder.get())->markDirty();
+        }
+    };
+    if (mCommands.push(target, slot, std::move(update)))
+        wake_mainloop();
+}
+
+void Screen::pushUpdate(const Widget *target, int slot) {
+    ref<const Widget> holder(target);
+    auto update = [this, holder, slot]() {
+        /* Take the value even if the target has been removed, so that the
+           next postUpdate() queues a command again */
+        std::unique_ptr<PendingUpdate> pending;
+        {
+            std::lock_guard<std::mutex> guard(mUpdateMutex);
+            auto it = mPendingUpdates.find(std::make_pair(holder.get(), slot));
+            if (it != mPendingUpdates.end()) {
+                pending = std::move(it->second);
+                mPendingUpdates.erase(it);
+            }
+        }
+        if (pending && !holder->removed()) {
+            pending->apply();
+            const_cast<Widget *>(holder.get())->markDirty();
+        }
+    };
+    if (mCommands.push(target, slot, std::move(update)))
+        wake_mainloop();
+}
+
+void Screen::postAfterFrame(CommandQueue::Command task) {
+    mAfterFrame.push_back(std::move(task));
+    wake_mainloop();
+}
+
+double Screen::time() const {
+    return mVirtualTime >= 0 ? mVirtualTime : glfwGetTime();
+}
+
 void Screen::drawAll() {    
-    double cpuStartTime = glfwGetTime();
+    prepareFrame();
+    if (mDeferFrame) {
+        /* Rendered on a worker thread, see mainloop() */
+        glfwMakeContextCurrent(nullptr);
+        mFrameDeferred = true;
+        return;
+    }
+    renderFrame();
+    presentFrame();
+}
+
+void Screen::prepareFrame() {
+    mFrameStartTime = glfwGetTime();
+
+    if (mEventRecorder)
+        mEventRecorder->frame(time());
+
+    /* Commands mark the layers they affect, see post() */
+    processCommands();
+    processPendingEvents();
+
+    /* GLFW only allows window queries on the main thread */
+    if (mVisible) {
+        updateFrameSize();
+        mFrameSizeValid = true;
+    }
+}
+
+void Screen::renderFrame() {
+    glfwMakeContextCurrent(mGLFWWindow);
 
     glClearColor(mBackground[0], mBackground[1], mBackground[2], mBackground[3]);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
     drawContents();
     drawWidgets();
+}
+
+void Screen::presentFrame() {
+    /* Some platforms (e.g. EGL) require the context to be current for swapping */
+    glfwMakeContextCurrent(mGLFWWindow);
 
+    int swapInterval = mFrameSwapInterval >= 0 ? mFrameSwapInterval : mSwapInterval;
+    if (swapInterval != mAppliedSwapInterval) {
+        glfwSwapInterval(swapInterval);
+        mAppliedSwapInterval = swapInterval;
+    }
     glfwSwapBuffers(mGLFWWindow);
-    
-    float dCpuTime = glfwGetTime() - cpuStartTime;
+
+    /* Destroy removed widgets after the frame has been presented */
+    Widget::reclaimRemoved();
+
+    /* Evict images that were released while the context is still current */
+    if (ImageCache *cache = ImageCache::find(mNVGContext))
+        cache->trim();
+    if (mSoftwareContext)
+        if (ImageCache *cache = ImageCache::find(mSoftwareContext))
+            cache->trim();
+
+    float dCpuTime = glfwGetTime() - mFrameStartTime;
     float fps = 1. / dCpuTime;
     mFPS = mFPS + 0.0175 * (fps - mFPS);
-}
-
-void Screen::drawWidgets() {
-    if (!mVisible)
-        return;
 
-    glfwMakeContextCurrent(mGLFWWindow);
+    /* Tasks may post further tasks for the next frame */
+    std::vector<CommandQueue::Command> afterFrame;
+    afterFrame.swap(mAfterFrame);
+    for (auto &task : afterFrame)
+        task();
+}
 
+void Screen::updateFrameSize() {
     glfwGetFramebufferSize(mGLFWWindow, &mFBSize[0], &mFBSize[1]);
     glfwGetWindowSize(mGLFWWindow, &mSize[0], &mSize[1]);
 
@@ -444,16 +611,48 @@ void Screen::drawWidgets() {
     if (mSize[0])
         mPixelRatio = (float) mFBSize[0] / (float) mSize[0];
 #endif
+}
+
+void Screen::drawWidgets() {
+    if (!mVisible)
+        return;
+
+    glfwMakeContextCurrent(mGLFWWindow);
+
+    if (!mFrameSizeValid)
+        updateFrameSize();
+    mFrameSizeValid = false;
+
+    NVGcontext *ctx = nvgContext();
+    if (!mSoftwareContext && mSoftwareImage) {
+        nvgDeleteImage(mNVGContext, mSoftwareImage);
+        mSoftwareImage = 0;
+    }
+
+    /* Re-render the layers of windows that changed, see Window::setLayered().
+       The software renderer draws them directly. */
+    for (Widget *child : mChildren) {
+        if (Window *window = dynamic_cast<Window *>(child)) {
+            if (mSoftwareContext)
+                window->releaseLayer();
+            else
+                window->updateLayer(mNVGContext, mPixelRatio);
+        }
+    }
 
     glViewport(0, 0, mFBSize[0], mFBSize[1]);
 #if !defined(NANOVG_GL2_IMPLEMENTATION) && !defined(NANOVG_GLES2_IMPLEMENTATION)
     glBindSampler(0, 0);
 #endif
-    nvgBeginFrame(mNVGContext, mSize[0], mSize[1], mPixelRatio);
+    nvgBeginFrame(ctx, mSize[0], mSize[1], mPixelRatio);
+    if (mSoftwareContext)
+        nvgSoftwareClear(ctx, Color(0, 0));
 
-    draw(mNVGContext);
+    setDrawClip(mSize, mPixelRatio);
+    draw(ctx);
+    setDrawClip(Vector2i::Zero());
 
-    double elapsed = glfwGetTime() - mLastInteraction;
+    double elapsed = time() - mLastInteraction;
 
     if (elapsed > 0.0125f) {
         /* Draw tooltips */
@@ -462,67 +661,146 @@ void Screen::drawWidgets() {
             int tooltipWidth = 150;
 
             float bounds[4];
-            nvgFontFace(mNVGContext, "sans");
-            nvgFontSize(mNVGContext, 15.0f);
-            nvgTextAlign(mNVGContext, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
-            nvgTextLineHeight(mNVGContext, 1.1f);
+            mTheme->setFont(ctx, "sans", 15.0f);
+            nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+            nvgTextLineHeight(ctx, 1.1f);
             Vector2i pos = widget->absolutePosition() +
                            Vector2i(widget->width() / 2, widget->height() + 10);
 
-            nvgTextBounds(mNVGContext, pos.x(), pos.y(),
+            nvgTextBounds(ctx, pos.x(), pos.y(),
                             widget->tooltip().c_str(), nullptr, bounds);
             int h = (bounds[2] - bounds[0]) / 2;
             if (h > tooltipWidth / 2) {
-                nvgTextAlign(mNVGContext, NVG_ALIGN_CENTER | NVG_ALIGN_TOP);
-                nvgTextBoxBounds(mNVGContext, pos.x(), pos.y(), tooltipWidth,
+                nvgTextAlign(ctx, NVG_ALIGN_CENTER | NVG_ALIGN_TOP);
+                nvgTextBoxBounds(ctx, pos.x(), pos.y(), tooltipWidth,
                                 widget->tooltip().c_str(), nullptr, bounds);
 
                 h = (bounds[2] - bounds[0]) / 2;
             }
-            nvgGlobalAlpha(mNVGContext,
+            nvgGlobalAlpha(ctx,
                            std::min(1.0, 2 * (elapsed - 0.5f)) * 0.8);
 
-            nvgBeginPath(mNVGContext);
-            nvgFillColor(mNVGContext, Color(0, 255));
-            nvgRoundedRect(mNVGContext, bounds[0] - 4 - h, bounds[1] - 4,
+            nvgBeginPath(ctx);
+            nvgFillColor(ctx, Color(0, 255));
+            nvgRoundedRect(ctx, bounds[0] - 4 - h, bounds[1] - 4,
                            (int) (bounds[2] - bounds[0]) + 8,
                            (int) (bounds[3] - bounds[1]) + 8, 3);
 
             int px = (int) ((bounds[2] + bounds[0]) / 2) - h;
-            nvgMoveTo(mNVGContext, px, bounds[1] - 10);
-            nvgLineTo(mNVGContext, px + 7, bounds[1] + 1);
-            nvgLineTo(mNVGContext, px - 7, bounds[1] + 1);
-            nvgFill(mNVGContext);
-
-            nvgFillColor(mNVGContext, Color(255, 255));
-            nvgFontBlur(mNVGContext, 0.0f);
-            nvgTextBox(mNVGContext, pos.x() - h, pos.y(), tooltipWidth,
+            nvgMoveTo(ctx, px, bounds[1] - 10);
+            nvgLineTo(ctx, px + 7, bounds[1] + 1);
+            nvgLineTo(ctx, px - 7, bounds[1] + 1);
+            nvgFill(ctx);
+
+            nvgFillColor(ctx, Color(255, 255));
+            nvgFontBlur(ctx, 0.0f);
+            nvgTextBox(ctx, pos.x() - h, pos.y(), tooltipWidth,
                        widget->tooltip().c_str(), nullptr);
         }
     }
 
-    nvgEndFrame(mNVGContext);
+    nvgEndFrame(ctx);
+
+    if (mSoftwareContext) {
+        /* Upload the pixels and blend them over the contents in one draw */
+        int width, height;
+        const uint8_t *pixels = nvgSoftwarePixels(ctx, &width, &height);
+        if (width <= 0 || height <= 0)
+            return;
+        if (!mSoftwareImage || mSoftwareImageSize != Vector2i(width, height)) {
+            if (mSoftwareImage)
+                nvgDeleteImage(mNVGContext, mSoftwareImage);
+            mSoftwareImage = nvgCreateImageRGBA(mNVGContext, width, height,
+                                                NVG_IMAGE_PREMULTIPLIED, pixels);
+            mSoftwareImageSize = Vector2i(width, height);
+            if (!mSoftwareImage)
+                return;
+        } else {
+            nvgUpdateImage(mNVGContext, mSoftwareImage, pixels);
+        }
+        nvgBeginFrame(mNVGContext, mSize[0], mSize[1], mPixelRatio);
+        nvgBeginPath(mNVGContext);
+        nvgRect(mNVGContext, 0, 0, mSize[0], mSize[1]);
+        nvgFillPaint(mNVGContext, nvgImagePattern(mNVGContext, 0, 0, mSize[0], mSize[1],
+                                                  0.f, mSoftwareImage, 1.f));
+        nvgFill(mNVGContext);
+        nvgEndFrame(mNVGContext);
+    }
 }
 
 bool Screen::keyboardEvent(int key, int scancode, int action, int modifiers) {
+    bool cached = mKeyConsumer && mKeyConsumerGeneration == mFocusGeneration;
+    mKeyRepeating = cached && action == GLFW_REPEAT && key == mKeyConsumerKey;
+
+    /* Fast path: repeats go straight to the widget that took the key press */
+    if (mKeyRepeating) {
+        if (mKeyConsumer->focused() &&
+            mKeyConsumer->keyboardEvent(key, scancode, action, modifiers))
+            return true;
+        mKeyRepeating = false;
+    }
+
     if (mFocusPath.size() > 0) {
-        for (auto it = mFocusPath.rbegin() + 1; it != mFocusPath.rend(); ++it)
-            if ((*it)->focused() && (*it)->keyboardEvent(key, scancode, action, modifiers))
+        size_t generation = mFocusGeneration;
+        for (auto it = mFocusPath.rbegin() + 1; it != mFocusPath.rend(); ++it) {
+            Widget *widget = *it;
+            if (widget->focused() && widget->keyboardEvent(key, scancode, action, modifiers)) {
+                if (action == GLFW_PRESS && generation == mFocusGeneration) {
+                    mKeyConsumer = widget;
+                    mKeyConsumerKey = key;
+                    mKeyConsumerGeneration = generation;
+                }
                 return true;
+            }
+            if (generation != mFocusGeneration)
+                break;
+        }
     }
 
     return false;
 }
 
 bool Screen::keyboardCharacterEvent(unsigned int codepoint) {
+    if (mKeyRepeating && mKeyConsumerGeneration == mFocusGeneration &&
+        mKeyConsumer->focused() && mKeyConsumer->keyboardCharacterEvent(codepoint))
+        return true;
+
     if (mFocusPath.size() > 0) {
-        for (auto it = mFocusPath.rbegin() + 1; it != mFocusPath.rend(); ++it)
+        size_t generation = mFocusGeneration;
+        for (auto it = mFocusPath.rbegin() + 1; it != mFocusPath.rend(); ++it) {
             if ((*it)->focused() && (*it)->keyboardCharacterEvent(codepoint))
                 return true;
+            if (generation != mFocusGeneration)
+                break;
+        }
     }
     return false;
 }
 
+uint64_t Screen::shortcutKey(int key, int modifiers) {
+    const int mask = GLFW_MOD_SHIFT | GLFW_MOD_CONTROL | GLFW_MOD_ALT | GLFW_MOD_SUPER;
+    return ((uint64_t) (uint32_t) key << 32) | (uint32_t) (modifiers & mask);
+}
+
+void Screen::setShortcut(int key, int modifiers, const std::function<void()> &callback) {
+    if (callback)
+        mShortcuts[shortcutKey(key, modifiers)] = callback;
+    else
+        mShortcuts.erase(shortcutKey(key, modifiers));
+}
+
+bool Screen::processShortcut(int key, int action, int modifiers) {
+    if (mShortcuts.empty() || action == GLFW_RELEASE)
+        return false;
+    auto it = mShortcuts.find(shortcutKey(key, modifiers));
+    if (it == mShortcuts.end())
+        return false;
+    /* Copy, the callback may replace or remove the shortcut */
+    std::function<void()> callback = it->second;
+    callback();
+    return true;
+}
+
 bool Screen::resizeEvent(const Vector2i& size) {
     if (mResizeCallback) {
         mResizeCallback(size);
@@ -531,7 +809,45 @@ bool Screen::resizeEvent(const Vector2i& size) {
     return false;
 }
 
+void Screen::setEventCoalescing(bool eventCoalescing) {
+    if (!eventCoalescing)
+        processPendingEvents();
+    mEventCoalescing = eventCoalescing;
+}
+
+void Screen::processPendingEvents() {
+    if (mPendingEvents.empty())
+        return;
+    /* Dispatching may queue further events via the callbacks below, so
+       iterate by index and keep the buffer's capacity for the next frame */
+    for (size_t i = 0; i < mPendingEvents.size(); ++i) {
+        PendingEvent event = mPendingEvents[i];
+        if (event.scroll)
+            processScroll(event.x, event.y);
+        else
+            processCursorPos(event.x, event.y);
+    }
+    mPendingEvents.clear();
+}
+
 bool Screen::cursorPosCallbackEvent(double x, double y) {
+    if (mEventRecorder)
+        mEventRecorder->cursorPos(time(), x, y);
+    if (!mEventCoalescing)
+        return processCursorPos(x, y);
+
+    /* Only the latest position of consecutive motion events matters */
+    mLastInteraction = time();
+    if (!mPendingEvents.empty() && !mPendingEvents.back().scroll) {
+        mPendingEvents.back().x = x;
+        mPendingEvents.back().y = y;
+    } else {
+        mPendingEvents.push_back(PendingEvent { false, x, y });
+    }
+    return false;
+}
+
+bool Screen::processCursorPos(double x, double y) {
     Vector2i p((int) x, (int) y);
 
 #if defined(_WIN32) || defined(__linux__)
@@ -539,7 +855,7 @@ bool Screen::cursorPosCallbackEvent(double x, double y) {
 #endif
 
     bool ret = false;
-    mLastInteraction = glfwGetTime();
+    mLastInteraction = time();
     try {
         p -= Vector2i(1, 2);
 
@@ -555,6 +871,10 @@ bool Screen::cursorPosCallbackEvent(double x, double y) {
             ret = mDragWidget->mouseDragEvent(
                 p - mDragWidget->parent()->absolutePosition(), p - mMousePos,
                 mMouseState, mModifiers);
+            /* Moving a window leaves the contents of its layer unchanged,
+               other drags may invoke callbacks that touch any window */
+            if (!ret || !dynamic_cast<Window *>(mDragWidget))
+                markLayersDirty();
         }
 
         if (!ret) {
@@ -572,8 +892,11 @@ bool Screen::cursorPosCallbackEvent(double x, double y) {
 }
 
 bool Screen::mouseButtonCallbackEvent(int button, int action, int modifiers) {
+    if (mEventRecorder)
+        mEventRecorder->mouseButton(time(), button, action, modifiers);
+    processPendingEvents();
     mModifiers = modifiers;
-    mLastInteraction = glfwGetTime();
+    mLastInteraction = time();
     try {
         if (mFocusPath.size() > 1) {
             const Window *window =
@@ -592,13 +915,13 @@ bool Screen::mouseButtonCallbackEvent(int button, int action, int modifiers) {
         // Detect double clicks
         if (button == GLFW_MOUSE_BUTTON_LEFT) {
             if (action == GLFW_PRESS) {
-                if (mLastMouseDown >= 0 && (glfwGetTime() - mLastMouseDown) > 0.2)
+                if (mLastMouseDown >= 0 && (time() - mLastMouseDown) > 0.2)
                     mLastMouseDown = -1;
-                if (glfwGetTime() - mLastMouseDown < 0.2) {
+                if (time() - mLastMouseDown < 0.2) {
                     mModifiers |= GLFW_MOD_DOUBLE_CLICK;
                     mLastMouseDown = -1;
                 } else {
-                    mLastMouseDown = glfwGetTime();
+                    mLastMouseDown = time();
                 }
             }
         }
@@ -631,6 +954,7 @@ bool Screen::mouseButtonCallbackEvent(int button, int action, int modifiers) {
             mDragWidget = nullptr;
         }
 
+        markLayersDirty();
         return mouseButtonEvent(mMousePos, button, action == GLFW_PRESS,
                                 mModifiers);
     } catch (const std::exception &e) {
@@ -640,9 +964,25 @@ bool Screen::mouseButtonCallbackEvent(int button, int action, int modifiers) {
 }
 
 bool Screen::keyCallbackEvent(int key, int scancode, int action, int mods) {
-    mLastInteraction = glfwGetTime();
+    if (mEventRecorder)
+        mEventRecorder->key(time(), key, scancode, action, mods);
+    processPendingEvents();
+    mLastInteraction = time();
+    markLayersDirty();
+    mSuppressCharacter = false;
     try {
-        return keyboardEvent(key, scancode, action, mods);
+        /* Text entry takes precedence, e.g. to select all text with Ctrl+A */
+        bool textFocus = false;
+        for (Widget *widget : mFocusPath)
+            textFocus = textFocus || (widget->focused() && widget->textInput());
+        if (textFocus && keyboardEvent(key, scancode, action, mods))
+            return true;
+        if (processShortcut(key, action, mods)) {
+            mKeyRepeating = false;
+            mSuppressCharacter = true;
+            return true;
+        }
+        return !textFocus && keyboardEvent(key, scancode, action, mods);
     } catch (const std::exception &e) {
         std::cerr << "Caught exception in event handler: " << e.what() << std::endl;
         return false;
@@ -650,7 +990,16 @@ bool Screen::keyCallbackEvent(int key, int scancode, int action, int mods) {
 }
 
 bool Screen::charCallbackEvent(unsigned int codepoint) {
-    mLastInteraction = glfwGetTime();
+    if (mEventRecorder)
+        mEventRecorder->character(time(), codepoint);
+    processPendingEvents();
+    mLastInteraction = time();
+    markLayersDirty();
+    if (mSuppressCharacter) {
+        /* The key press was taken by a shortcut */
+        mSuppressCharacter = false;
+        return true;
+    }
     try {
         return keyboardCharacterEvent(codepoint);
     } catch (const std::exception &e) {
@@ -661,6 +1010,10 @@ bool Screen::charCallbackEvent(unsigned int codepoint) {
 }
 
 bool Screen::dropCallbackEvent(int count, const char **filenames) {
+    if (mEventRecorder)
+        mEventRecorder->drop(time(), count, filenames);
+    processPendingEvents();
+    markLayersDirty();
     std::vector<std::string> arg(count);
     for (int i = 0; i < count; ++i)
         arg[i] = filenames[i];
@@ -668,7 +1021,25 @@ bool Screen::dropCallbackEvent(int count, const char **filenames) {
 }
 
 bool Screen::scrollCallbackEvent(double x, double y) {
-    mLastInteraction = glfwGetTime();
+    if (mEventRecorder)
+        mEventRecorder->scroll(time(), x, y);
+    if (!mEventCoalescing)
+        return processScroll(x, y);
+
+    /* Consecutive scroll events are accumulated */
+    mLastInteraction = time();
+    if (!mPendingEvents.empty() && mPendingEvents.back().scroll) {
+        mPendingEvents.back().x += x;
+        mPendingEvents.back().y += y;
+    } else {
+        mPendingEvents.push_back(PendingEvent { true, x, y });
+    }
+    return false;
+}
+
+bool Screen::processScroll(double x, double y) {
+    mLastInteraction = time();
+    markLayersDirty();
     try {
         if (mFocusPath.size() > 1) {
             const Window *window =
@@ -686,7 +1057,10 @@ bool Screen::scrollCallbackEvent(double x, double y) {
     }
 }
 
-bool Screen::resizeCallbackEvent(int, int) {
+bool Screen::resizeCallbackEvent(int width, int height) {
+    if (mEventRecorder)
+        mEventRecorder->resize(time(), width, height);
+    processPendingEvents();
     Vector2i fbSize, size;
     glfwGetFramebufferSize(mGLFWWindow, &fbSize[0], &fbSize[1]);
     glfwGetWindowSize(mGLFWWindow, &size[0], &size[1]);
@@ -699,7 +1073,7 @@ bool Screen::resizeCallbackEvent(int, int) {
         return false;
 
     mFBSize = fbSize; mSize = size;
-    mLastInteraction = glfwGetTime();
+    mLastInteraction = time();
 
     try {
         return resizeEvent(mSize);
@@ -711,38 +1085,39 @@ bool Screen::resizeCallbackEvent(int, int) {
 }
 
 void Screen::updateFocus(Widget *widget) {
-    // Construct new focus path
+    // Construct new focus path, reusing the storage of the previous one
     Window *window = widget ? widget->window() : nullptr;
-    std::vector<Widget*> newFocusPath;
+    std::vector<Widget *> &newFocusPath = mOldFocusPath;
+    newFocusPath.clear();
     while (widget && widget->parent()) {
         newFocusPath.push_back(widget);
         widget = widget->parent();
     }
 
-    std::vector<Widget*> oldFocusPath = mFocusPath;
-    for (auto w : oldFocusPath) {
-        // Don't send a de-focus event to widgets that are also in the new focus path.
-        if (std::find(newFocusPath.begin(), newFocusPath.end(), w) != newFocusPath.end())
-            continue;
-        w->focusEvent(false);
-    }
+    // Both paths end below the screen, so their common ancestors form a shared suffix.
+    size_t oldSize = mFocusPath.size(), newSize = newFocusPath.size(), common = 0;
+    while (common < oldSize && common < newSize &&
+           mFocusPath[oldSize - 1 - common] == newFocusPath[newSize - 1 - common])
+        ++common;
 
-    for (auto it = newFocusPath.rbegin(); it != newFocusPath.rend(); ++it) {
-        // Don't send a focus event to widgets that are already focused.
-        Widget *w = *it;
-        if (std::find(oldFocusPath.begin(), oldFocusPath.end(), w) != oldFocusPath.end())
-            continue;
-        w->focusEvent(true);
-    }
+    mFocusPath.swap(mOldFocusPath);
+    const std::vector<Widget *> &oldFocusPath = mOldFocusPath;
 
-    mFocusPath = newFocusPath;
+    // Event handlers may change the focus again, which supersedes this update.
+    size_t generation = ++mFocusGeneration;
+    for (size_t i = 0; i < oldSize - common && generation == mFocusGeneration; ++i)
+        oldFocusPath[i]->focusEvent(false);
+    for (size_t i = newSize - common; i-- > 0 && generation == mFocusGeneration &&
+                                      i < mFocusPath.size(); )
+        mFocusPath[i]->focusEvent(true);
 
-    if (window && !window->isBackgroundWindow())
+    if (window && !window->isBackgroundWindow() && generation == mFocusGeneration)
         moveWindowToFront(window);
 }
 
 void Screen::updateMouseFocus(const Vector2i& p) {
-    std::vector<Widget*> newMouseFocusPath;
+    std::vector<Widget *> &newMouseFocusPath = mOldMouseFocusPath;
+    newMouseFocusPath.clear();
 
     Widget* widget = findWidget(p);
     while (widget) {
@@ -750,30 +1125,35 @@ void Screen::updateMouseFocus(const Vector2i& p) {
         widget = widget->parent();
     }
 
-    std::vector<Widget*> oldMouseFocusPath = mMouseFocusPath;
-    for (auto w : oldMouseFocusPath) {
-        // Don't send a de-focus event to widget's that are also in the new focus path.
-        if (std::find(newMouseFocusPath.begin(), newMouseFocusPath.end(), w) != newMouseFocusPath.end())
-            continue;
+    size_t oldSize = mMouseFocusPath.size(), newSize = newMouseFocusPath.size(), common = 0;
+    while (common < oldSize && common < newSize &&
+           mMouseFocusPath[oldSize - 1 - common] == newMouseFocusPath[newSize - 1 - common])
+        ++common;
+
+    mMouseFocusPath.swap(mOldMouseFocusPath);
+    const std::vector<Widget *> &oldMouseFocusPath = mOldMouseFocusPath;
+
+    size_t generation = ++mMouseFocusGeneration;
+    for (size_t i = 0; i < oldSize - common && generation == mMouseFocusGeneration; ++i) {
+        Widget *w = oldMouseFocusPath[i];
         w->mouseEnterEvent(p - w->absolutePosition(), false);
     }
-
-    for (auto it = newMouseFocusPath.rbegin(); it != newMouseFocusPath.rend(); ++it) {
-        // Don't send a focus event to widget's that were in the old focus path.
-        Widget *w = *it;
-        if (std::find(oldMouseFocusPath.begin(), oldMouseFocusPath.end(), w) != oldMouseFocusPath.end())
-            continue;
+    for (size_t i = newSize - common; i-- > 0 && generation == mMouseFocusGeneration &&
+                                      i < mMouseFocusPath.size(); ) {
+        Widget *w = mMouseFocusPath[i];
         w->mouseEnterEvent(p - w->absolutePosition(), true);
     }
-
-    mMouseFocusPath = newMouseFocusPath;
 }
 
 void Screen::disposeWindow(Window *window) {
-    if (std::find(mFocusPath.begin(), mFocusPath.end(), window) != mFocusPath.end())
+    if (std::find(mFocusPath.begin(), mFocusPath.end(), window) != mFocusPath.end()) {
         mFocusPath.clear();
-    if (std::find(mMouseFocusPath.begin(), mMouseFocusPath.end(), window) != mMouseFocusPath.end())
+        mFocusGeneration++;
+    }
+    if (std::find(mMouseFocusPath.begin(), mMouseFocusPath.end(), window) != mMouseFocusPath.end()) {
         mMouseFocusPath.clear();
+        mMouseFocusGeneration++;
+    }
     if (mDragWidget == window)
         mDragWidget = nullptr;
     removeChild(window);
@@ -787,6 +1167,11 @@ void Screen::centerWindow(Window *window) {
     window->setPosition((mSize - window->size()) / 2);
 }
 
+void Screen::markLayersDirty() {
+    for (Widget *child : mChildren)
+        child->markDirty();
+}
+
 void Screen::moveWindowToFront(Window *window) {
     mChildren.erase(std::remove(mChildren.begin(), mChildren.end(), window), mChildren.end());
     mChildren.push_back(window);
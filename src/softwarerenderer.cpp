@@ -0,0 +1,960 @@
+/*
+    src/softwarerenderer.cpp -- NanoVG backend that rasterizes on the CPU
+
+    NanoGUI was developed by Wenzel Jakob <wenzel.jakob@epfl.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/softwarerenderer.h>
+#include <nanovg.h>
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define NANOGUI_SOFTWARE_SSE2
+#endif
+
+NAMESPACE_BEGIN(nanogui)
+
+namespace {
+    struct Texture {
+        int type = 0, flags = 0, width = 0, height = 0;
+        std::vector<uint8_t> data;
+    };
+
+    /// Paint state, prepared like the uniforms of the OpenGL backend
+    struct Shading {
+        float paintMat[6];
+        float extent[2];
+        float radius, feather;
+        /// Premultiplied colors
+        float inner[4], outer[4];
+        const Texture *texture;
+        /// 0: premultiplied RGBA, 1: straight RGBA, 2: alpha
+        int textureType;
+        bool solid, sourceOver;
+        NVGcompositeOperationState composite;
+    };
+
+    /// Scissor state, shared by consecutive shapes that were drawn with it
+    struct Scissor {
+        NVGscissor source;
+        float mat[6], extent[2], scale[2];
+        /**
+         * For axis-aligned scissors: the pixels (x0, y0, x1, y1) where the
+         * mask is nonzero, and those where it is one. Otherwise, the whole
+         * buffer and an empty rectangle.
+         */
+        int outer[4], inner[4];
+    };
+
+    struct Edge {
+        float x0, y0, x1, y1;
+    };
+
+    /// Filled edges or a list of textured triangles, plus the scissor (or -1)
+    struct Shape {
+        bool triangles;
+        size_t first, count;
+        int scissor;
+        /// Pixel bounds: x0, y0, x1, y1
+        float bounds[4];
+    };
+
+    /// Consecutive shapes with the same paint
+    struct Batch {
+        Shading shading;
+        size_t first, count;
+    };
+
+    float clamp01(float value) {
+        return std::min(std::max(value, 0.f), 1.f);
+    }
+
+    /**
+     * Accumulates the signed area that edges cover in each pixel of a
+     * rectangle, one scanline at a time. The prefix sum along a row then
+     * yields the exact coverage under the nonzero rule, as long as paths
+     * of opposite orientation don't overlap (which is how NanoVG encodes
+     * holes).
+     */
+    class Rasterizer {
+    public:
+        /// Start a shape within the pixel rectangle [x0, x1) x [y0, y1)
+        void begin(int x0, int y0, int x1, int y1) {
+            mX = x0;
+            mY = y0;
+            mWidth = x1 - x0;
+            mHeight = y1 - y0;
+            mStride = mWidth + 2;
+            size_t size = (size_t) mStride * mHeight;
+            if (mAccumulation.size() < size)
+                mAccumulation.resize(size, 0.f);
+            if (mCoverage.size() < (size_t) mWidth)
+                mCoverage.resize(mWidth);
+        }
+
+        /// Add an edge (in pixel coordinates)
+        void line(float x0, float y0, float x1, float y1) {
+            clip(x0 - mX, y0 - mY, x1 - mX, y1 - mY);
+        }
+
+        /// Return the coverage of a row (relative to the rectangle) and reset it
+        float *resolve(int row) {
+            float *acc = mAccumulation.data() + (size_t) row * mStride;
+            float *cov = mCoverage.data();
+            int i = 0;
+            float sum = 0.f;
+#if defined(NANOGUI_SOFTWARE_SSE2)
+            __m128 offset = _mm_setzero_ps(), one = _mm_set1_ps(1.f),
+                   absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+            for (; i + 4 <= mWidth; i += 4) {
+                /* Prefix sum within the register, then carry over the last lane */
+                __m128 x = _mm_loadu_ps(acc + i);
+                x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 4)));
+                x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 8)));
+                x = _mm_add_ps(x, offset);
+                _mm_storeu_ps(cov + i, _mm_min_ps(_mm_and_ps(x, absMask), one));
+                _mm_storeu_ps(acc + i, _mm_setzero_ps());
+                offset = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 3, 3));
+            }
+            sum = _mm_cvtss_f32(offset);
+#endif
+            for (; i < mWidth; ++i) {
+                sum += acc[i];
+                cov[i] = std::min(std::abs(sum), 1.f);
+                acc[i] = 0.f;
+            }
+            acc[mWidth] = acc[mWidth + 1] = 0.f;
+            return cov;
+        }
+
+    private:
+        /* Split edges at the left and right border. The parts outside are
+           moved onto the border, which keeps the winding of the pixels in
+           between intact. */
+        void clip(float x0, float y0, float x1, float y1) {
+            const float borders[2] = { 0.f, (float) mWidth };
+            for (float b : borders) {
+                if ((x0 < b && x1 > b) || (x0 > b && x1 < b)) {
+                    float y = y0 + (b - x0) * (y1 - y0) / (x1 - x0);
+                    clip(x0, y0, b, y);
+                    clip(b, y, x1, y1);
+                    return;
+                }
+            }
+            accumulate(std::min(std::max(x0, 0.f), (float) mWidth), y0,
+                       std::min(std::max(x1, 0.f), (float) mWidth), y1);
+        }
+
+        void accumulate(float x0, float y0, float x1, float y1) {
+            if (y0 == y1)
+                return;
+            float dir = 1.f;
+            if (y0 > y1) {
+                std::swap(x0, x1);
+                std::swap(y0, y1);
+                dir = -1.f;
+            }
+            float dxdy = (x1 - x0) / (y1 - y0), x = x0;
+            if (y0 < 0.f) {
+                x -= y0 * dxdy;
+                y0 = 0.f;
+            }
+            y1 = std::min(y1, (float) mHeight);
+            if (y0 >= y1)
+                return;
+
+            for (int y = (int) y0, yEnd = (int) std::ceil(y1); y < yEnd; ++y) {
+                float *row = mAccumulation.data() + (size_t) y * mStride;
+                float dy = std::min(y + 1.f, y1) - std::max((float) y, y0);
+                float xNext = x + dxdy * dy, d = dy * dir;
+                float xa = std::min(x, xNext), xb = std::max(x, xNext);
+                float xaFloor = std::floor(xa), xbCeil = std::ceil(xb);
+                int xai = (int) xaFloor, xbi = (int) xbCeil;
+
+                if (xbi <= xai + 1) {
+                    /* The edge stays within one pixel column */
+                    float xm = 0.5f * (x + xNext) - xaFloor;
+                    row[xai] += d - d * xm;
+                    row[xai + 1] += d * xm;
+                } else {
+                    float s = 1.f / (xb - xa), xaf = xa - xaFloor,
+                          xbf = xb - xbCeil + 1.f;
+                    float a0 = 0.5f * s * (1.f - xaf) * (1.f - xaf),
+                          am = 0.5f * s * xbf * xbf;
+                    row[xai] += d * a0;
+                    if (xbi == xai + 2) {
+                        row[xai + 1] += d * (1.f - a0 - am);
+                    } else {
+                        float a1 = s * (1.5f - xaf);
+                        row[xai + 1] += d * (a1 - a0);
+                        for (int xi = xai + 2; xi < xbi - 1; ++xi)
+                            row[xi] += d * s;
+                        float a2 = a1 + (xbi - xai - 3) * s;
+                        row[xbi - 1] += d * (1.f - a2 - am);
+                    }
+                    row[xbi] += d * am;
+                }
+                x = xNext;
+            }
+        }
+
+        int mX = 0, mY = 0, mWidth = 0, mHeight = 0, mStride = 0;
+        std::vector<float> mAccumulation, mCoverage;
+    };
+
+    /// Threads that render the bands of a frame, kept for the lifetime of the context
+    class BandWorkers {
+    public:
+        ~BandWorkers() {
+            {
+                std::lock_guard<std::mutex> guard(mMutex);
+                mShutdown = true;
+            }
+            mWake.notify_all();
+            for (auto &thread : mThreads)
+                thread.join();
+        }
+
+        /// Call \c func for all bands in <tt>[0, count)</tt>, band 0 on the calling thread
+        void run(int count, const std::function<void(int)> &func) {
+            {
+                std::lock_guard<std::mutex> guard(mMutex);
+                /* New workers start out waiting for the next job */
+                while ((int) mThreads.size() < count - 1) {
+                    int index = (int) mThreads.size() + 1;
+                    mThreads.emplace_back([this, index, job = mJob]() { workerLoop(index, job); });
+                }
+                mFunc = &func;
+                mCount = count;
+                mPending = count - 1;
+                mJob++;
+            }
+            mWake.notify_all();
+            func(0);
+
+            std::unique_lock<std::mutex> lock(mMutex);
+            mDone.wait(lock, [this]() { return mPending == 0; });
+            mFunc = nullptr;
+        }
+
+    private:
+        void workerLoop(int index, size_t job) {
+            while (true) {
+                const std::function<void(int)> *func;
+                {
+                    std::unique_lock<std::mutex> lock(mMutex);
+                    mWake.wait(lock, [&]() { return mShutdown || mJob != job; });
+                    if (mShutdown)
+                        return;
+                    job = mJob;
+                    if (index >= mCount)
+                        continue;
+                    func = mFunc;
+                }
+                (*func)(index);
+                std::lock_guard<std::mutex> guard(mMutex);
+                if (--mPending == 0)
+                    mDone.notify_all();
+            }
+        }
+
+        std::vector<std::thread> mThreads;
+        std::mutex mMutex;
+        std::condition_variable mWake, mDone;
+        const std::function<void(int)> *mFunc = nullptr;
+        int mCount = 0, mPending = 0;
+        size_t mJob = 0;
+        bool mShutdown = false;
+    };
+
+    class SoftwareRenderer {
+    public:
+        SoftwareRenderer(int threadCount) : mThreadCount(threadCount) {
+            if (mThreadCount <= 0)
+                mThreadCount = (int) std::max(1u, std::min(std::thread::hardware_concurrency(), 8u));
+        }
+
+        int createTexture(int type, int width, int height, int flags, const uint8_t *data) {
+            Texture &texture = mTextures[++mTextureCounter];
+            texture.type = type;
+            texture.flags = flags;
+            texture.width = width;
+            texture.height = height;
+            size_t size = (size_t) width * height * (type == NVG_TEXTURE_RGBA ? 4 : 1);
+            if (data)
+                texture.data.assign(data, data + size);
+            else
+                texture.data.assign(size, 0);
+            return mTextureCounter;
+        }
+
+        Texture *findTexture(int image) {
+            auto it = mTextures.find(image);
+            return it != mTextures.end() ? &it->second : nullptr;
+        }
+
+        void deleteTexture(int image) { mTextures.erase(image); }
+
+        bool updateTexture(int image, int x, int y, int width, int height, const uint8_t *data) {
+            Texture *texture = findTexture(image);
+            if (!texture)
+                return false;
+            /* Like glTexSubImage2D with a row length: data holds the whole image */
+            size_t bpp = texture->type == NVG_TEXTURE_RGBA ? 4 : 1;
+            for (int row = y; row < y + height; ++row) {
+                size_t offset = ((size_t) row * texture->width + x) * bpp;
+                memcpy(texture->data.data() + offset, data + offset, width * bpp);
+            }
+            return true;
+        }
+
+        void viewport(float width, float height, float pixelRatio) {
+            mPixelRatio = pixelRatio;
+            int w = (int) (width * pixelRatio + 0.5f), h = (int) (height * pixelRatio + 0.5f);
+            if (w != mWidth || h != mHeight) {
+                mWidth = w;
+                mHeight = h;
+                mPixels.assign((size_t) w * h * 4, 0);
+            }
+        }
+
+        void clear(const Color &color) {
+            uint8_t value[4];
+            for (int i = 0; i < 4; ++i)
+                value[i] = (uint8_t) std::round(
+                    clamp01(i < 3 ? color[i] * color[3] : color[3]) * 255.f);
+            for (size_t i = 0; i < mPixels.size(); i += 4)
+                memcpy(mPixels.data() + i, value, 4);
+        }
+
+        void cancel() {
+            mBatches.clear();
+            mShapes.clear();
+            mScissors.clear();
+            mEdges.clear();
+            mVertices.clear();
+        }
+
+        void fill(const NVGpaint *paint, NVGcompositeOperationState composite,
+                  const NVGscissor *scissor, float fringe, const NVGpath *paths, int npaths) {
+            Shape shape;
+            beginEdges(shape);
+            for (int i = 0; i < npaths; ++i) {
+                const NVGvertex *v = paths[i].fill;
+                for (int j = 0, n = paths[i].nfill; j < n; ++j) {
+                    const NVGvertex &a = v[j], &b = v[(j + 1) % n];
+                    addEdge(shape, a.x, a.y, b.x, b.y);
+                }
+            }
+            submit(shape, paint, composite, scissor, fringe);
+        }
+
+        void stroke(const NVGpaint *paint, NVGcompositeOperationState composite,
+                    const NVGscissor *scissor, float fringe, const NVGpath *paths, int npaths) {
+            Shape shape;
+            beginEdges(shape);
+            /* Strokes arrive as triangle strips that may fold over themselves.
+               Giving every triangle the same orientation turns the nonzero
+               rule into their union. */
+            for (int i = 0; i < npaths; ++i) {
+                const NVGvertex *v = paths[i].stroke;
+                for (int j = 0; j + 2 < paths[i].nstroke; ++j) {
+                    const NVGvertex *a = &v[j], *b = &v[j + 1], *c = &v[j + 2];
+                    float area = (b->x - a->x) * (c->y - a->y) - (c->x - a->x) * (b->y - a->y);
+                    if (area == 0.f)
+                        continue;
+                    if (area < 0.f)
+                        std::swap(b, c);
+                    addEdge(shape, a->x, a->y, b->x, b->y);
+                    addEdge(shape, b->x, b->y, c->x, c->y);
+                    addEdge(shape, c->x, c->y, a->x, a->y);
+                }
+            }
+            submit(shape, paint, composite, scissor, fringe);
+        }
+
+        void triangles(const NVGpaint *paint, NVGcompositeOperationState composite,
+                       const NVGscissor *scissor, const NVGvertex *verts, int nverts) {
+            Shape shape;
+            shape.triangles = true;
+            shape.first = mVertices.size();
+            shape.count = (size_t) nverts / 3 * 3;
+            mVertices.insert(mVertices.end(), verts, verts + shape.count);
+            resetBounds(shape);
+            for (size_t i = 0; i < shape.count; ++i)
+                extendBounds(shape, verts[i].x * mPixelRatio, verts[i].y * mPixelRatio);
+            submit(shape, paint, composite, scissor, 1.f / mPixelRatio);
+        }
+
+        void flush() {
+            if (!mBatches.empty() && mWidth > 0 && mHeight > 0) {
+                /* Every thread renders all batches, clipped to its own band of rows */
+                int bands = std::max(1, std::min(mThreadCount, mHeight / 32));
+                if ((int) mRasterizers.size() < bands)
+                    mRasterizers.resize(bands);
+                std::function<void(int)> band = [this, bands](int index) {
+                    render(mRasterizers[index], mHeight * index / bands,
+                           mHeight * (index + 1) / bands);
+                };
+                if (bands == 1)
+                    band(0);
+                else
+                    mWorkers.run(bands, band);
+            }
+            cancel();
+        }
+
+        const uint8_t *pixels(int *width, int *height) const {
+            if (width)
+                *width = mWidth;
+            if (height)
+                *height = mHeight;
+            return mPixels.data();
+        }
+
+    private:
+        bool convertPaint(Shading &s, const NVGpaint *paint,
+                          NVGcompositeOperationState composite) {
+            NVGcolor inner = paint->innerColor, outer = paint->outerColor;
+            for (int i = 0; i < 3; ++i) {
+                s.inner[i] = inner.rgba[i] * inner.a;
+                s.outer[i] = outer.rgba[i] * outer.a;
+            }
+            s.inner[3] = inner.a;
+            s.outer[3] = outer.a;
+            s.composite = composite;
+            s.sourceOver = composite.srcRGB == NVG_ONE && composite.srcAlpha == NVG_ONE &&
+                           composite.dstRGB == NVG_ONE_MINUS_SRC_ALPHA &&
+                           composite.dstAlpha == NVG_ONE_MINUS_SRC_ALPHA;
+
+            s.extent[0] = paint->extent[0];
+            s.extent[1] = paint->extent[1];
+            s.radius = paint->radius;
+            s.feather = paint->feather;
+            s.texture = nullptr;
+            s.textureType = 0;
+            if (paint->image != 0) {
+                s.texture = findTexture(paint->image);
+                if (!s.texture)
+                    return false;
+                if (s.texture->flags & NVG_IMAGE_FLIPY) {
+                    /* Mirror the pattern about the center of its extent */
+                    float m1[6], m2[6] = { 1.f, 0.f, 0.f, -1.f, 0.f, 0.f }, m3[6];
+                    float t[6] = { 1.f, 0.f, 0.f, 1.f, 0.f, paint->extent[1] * 0.5f };
+                    multiply(m1, paint->xform, t);
+                    multiply(m3, m1, m2);
+                    t[5] = -paint->extent[1] * 0.5f;
+                    multiply(m1, m3, t);
+                    nvgTransformInverse(s.paintMat, m1);
+                } else {
+                    nvgTransformInverse(s.paintMat, paint->xform);
+                }
+                if (s.texture->type == NVG_TEXTURE_RGBA)
+                    s.textureType = (s.texture->flags & NVG_IMAGE_PREMULTIPLIED) ? 0 : 1;
+                else
+                    s.textureType = 2;
+            } else {
+                nvgTransformInverse(s.paintMat, paint->xform);
+            }
+            s.solid = s.texture == nullptr &&
+                      std::equal(s.inner, s.inner + 4, s.outer);
+            return true;
+        }
+
+        /// Concatenate two transforms: apply \c b, then \c a
+        static void multiply(float *dst, const float *a, const float *b) {
+            float t[6];
+            t[0] = b[0] * a[0] + b[1] * a[2];
+            t[1] = b[0] * a[1] + b[1] * a[3];
+            t[2] = b[2] * a[0] + b[3] * a[2];
+            t[3] = b[2] * a[1] + b[3] * a[3];
+            t[4] = b[4] * a[0] + b[5] * a[2] + a[4];
+            t[5] = b[4] * a[1] + b[5] * a[3] + a[5];
+            memcpy(dst, t, sizeof(t));
+        }
+
+        /**
+         * Queue a shape. Every widget draws under its own scissor, so shapes
+         * are grouped by paint alone: consecutive shapes with the same paint
+         * share one batch, while each keeps a reference to its scissor. The
+         * scissor is dropped when it can't affect the shape, and the shape
+         * when it lies outside of the scissor.
+         */
+        void submit(Shape &shape, const NVGpaint *paint, NVGcompositeOperationState composite,
+                    const NVGscissor *scissor, float fringe) {
+            if (shape.count == 0)
+                return;
+            shape.scissor = -1;
+            if (scissor->extent[0] >= -0.5f && scissor->extent[1] >= -0.5f) {
+                if (mScissors.empty() || memcmp(&mScissors.back().source, scissor, sizeof(NVGscissor)) != 0)
+                    addScissor(scissor, fringe);
+                const Scissor &sc = mScissors.back();
+                int rect[4];
+                if (!pixelRect(shape.bounds, 0, mHeight, rect, &sc))
+                    return;
+                pixelRect(shape.bounds, 0, mHeight, rect, nullptr);
+                if (rect[0] < sc.inner[0] || rect[1] < sc.inner[1] ||
+                    rect[2] > sc.inner[2] || rect[3] > sc.inner[3])
+                    shape.scissor = (int) mScissors.size() - 1;
+            }
+
+            if (mBatches.empty() || !mLastPaintValid ||
+                memcmp(&mLastPaint, paint, sizeof(NVGpaint)) != 0 ||
+                memcmp(&mLastComposite, &composite, sizeof(composite)) != 0) {
+                Batch batch;
+                mLastPaintValid = convertPaint(batch.shading, paint, composite);
+                if (!mLastPaintValid)
+                    return;
+                mLastPaint = *paint;
+                mLastComposite = composite;
+                batch.first = mShapes.size();
+                batch.count = 0;
+                mBatches.push_back(batch);
+            }
+            mShapes.push_back(shape);
+            mBatches.back().count++;
+        }
+
+        void addScissor(const NVGscissor *scissor, float fringe) {
+            Scissor sc;
+            sc.source = *scissor;
+            nvgTransformInverse(sc.mat, scissor->xform);
+            sc.extent[0] = scissor->extent[0];
+            sc.extent[1] = scissor->extent[1];
+            sc.scale[0] = std::sqrt(scissor->xform[0] * scissor->xform[0] +
+                                    scissor->xform[2] * scissor->xform[2]) / fringe;
+            sc.scale[1] = std::sqrt(scissor->xform[1] * scissor->xform[1] +
+                                    scissor->xform[3] * scissor->xform[3]) / fringe;
+
+            sc.outer[0] = sc.outer[1] = 0;
+            sc.outer[2] = mWidth;
+            sc.outer[3] = mHeight;
+            sc.inner[0] = sc.inner[1] = sc.inner[2] = sc.inner[3] = 0;
+            if (sc.mat[1] == 0.f && sc.mat[2] == 0.f && sc.mat[0] != 0.f && sc.mat[3] != 0.f) {
+                /* The mask ramps across one pixel at the scissor border; find
+                   the pixel centers on either side of the ramp (with some
+                   slack for rounding) */
+                const float eps = 1e-3f;
+                for (int k = 0; k < 2; ++k) {
+                    float center = -sc.mat[4 + k] / sc.mat[3 * k],
+                          ramp = 0.5f / (sc.scale[k] * std::abs(sc.mat[3 * k]));
+                    float lo = (center - sc.extent[k] / std::abs(sc.mat[3 * k])) * mPixelRatio - 0.5f,
+                          hi = (center + sc.extent[k] / std::abs(sc.mat[3 * k])) * mPixelRatio - 0.5f;
+                    ramp *= mPixelRatio;
+                    sc.outer[k] = std::max((int) std::floor(lo - ramp - eps) + 1, 0);
+                    sc.outer[k + 2] = std::min((int) std::ceil(hi + ramp + eps), k == 0 ? mWidth : mHeight);
+                    sc.inner[k] = (int) std::ceil(lo + ramp + eps);
+                    sc.inner[k + 2] = (int) std::floor(hi - ramp - eps) + 1;
+                }
+            }
+            mScissors.push_back(sc);
+        }
+
+        /// Multiply coverage by the mask of a scissor
+        void applyScissor(const Scissor &sc, float *cov, int x0, int y, int width) const {
+            float invRatio = 1.f / mPixelRatio, py = (y + 0.5f) * invRatio;
+            const float *m = sc.mat;
+            for (int i = 0; i < width; ++i) {
+                if (cov[i] <= 0.f)
+                    continue;
+                float px = (x0 + i + 0.5f) * invRatio;
+                float sx = std::abs(m[0] * px + m[2] * py + m[4]) - sc.extent[0],
+                      sy = std::abs(m[1] * px + m[3] * py + m[5]) - sc.extent[1];
+                cov[i] *= clamp01(0.5f - sx * sc.scale[0]) * clamp01(0.5f - sy * sc.scale[1]);
+            }
+        }
+
+        void beginEdges(Shape &shape) {
+            shape.triangles = false;
+            shape.first = mEdges.size();
+            shape.count = 0;
+            resetBounds(shape);
+        }
+
+        void addEdge(Shape &shape, float x0, float y0, float x1, float y1) {
+            float r = mPixelRatio;
+            mEdges.push_back(Edge { x0 * r, y0 * r, x1 * r, y1 * r });
+            extendBounds(shape, x0 * r, y0 * r);
+            extendBounds(shape, x1 * r, y1 * r);
+            shape.count++;
+        }
+
+        static void resetBounds(Shape &shape) {
+            shape.bounds[0] = shape.bounds[1] = std::numeric_limits<float>::infinity();
+            shape.bounds[2] = shape.bounds[3] = -std::numeric_limits<float>::infinity();
+        }
+
+        static void extendBounds(Shape &shape, float x, float y) {
+            shape.bounds[0] = std::min(shape.bounds[0], x);
+            shape.bounds[1] = std::min(shape.bounds[1], y);
+            shape.bounds[2] = std::max(shape.bounds[2], x);
+            shape.bounds[3] = std::max(shape.bounds[3], y);
+        }
+
+        /**
+         * Clip bounds to the buffer, a band of rows and the nonzero region of
+         * a scissor (if given), returns false if empty
+         */
+        bool pixelRect(const float *bounds, int y0, int y1, int *rect,
+                       const Scissor *scissor) const {
+            rect[0] = std::max((int) std::floor(bounds[0]), 0);
+            rect[1] = std::max((int) std::floor(bounds[1]), y0);
+            rect[2] = std::min((int) std::ceil(bounds[2]) + 1, mWidth);
+            rect[3] = std::min((int) std::ceil(bounds[3]) + 1, y1);
+            if (scissor) {
+                rect[0] = std::max(rect[0], scissor->outer[0]);
+                rect[1] = std::max(rect[1], scissor->outer[1]);
+                rect[2] = std::min(rect[2], scissor->outer[2]);
+                rect[3] = std::min(rect[3], scissor->outer[3]);
+            }
+            return rect[0] < rect[2] && rect[1] < rect[3];
+        }
+
+        void render(Rasterizer &rasterizer, int y0, int y1) {
+            for (const Batch &batch : mBatches) {
+                for (size_t j = batch.first; j < batch.first + batch.count; ++j) {
+                    const Shape &shape = mShapes[j];
+                    const Scissor *scissor = shape.scissor >= 0 ? &mScissors[shape.scissor] : nullptr;
+                    if (shape.triangles) {
+                        for (size_t i = 0; i < shape.count; i += 3)
+                            renderTriangle(rasterizer, batch.shading, scissor,
+                                           &mVertices[shape.first + i], y0, y1);
+                        continue;
+                    }
+                    int rect[4];
+                    if (!pixelRect(shape.bounds, y0, y1, rect, scissor))
+                        continue;
+                    rasterizer.begin(rect[0], rect[1], rect[2], rect[3]);
+                    for (size_t i = shape.first; i < shape.first + shape.count; ++i) {
+                        const Edge &e = mEdges[i];
+                        if (std::max(e.y0, e.y1) <= rect[1] || std::min(e.y0, e.y1) >= rect[3])
+                            continue;
+                        rasterizer.line(e.x0, e.y0, e.x1, e.y1);
+                    }
+                    for (int y = rect[1]; y < rect[3]; ++y)
+                        shadeRow(batch.shading, scissor, rasterizer.resolve(y - rect[1]),
+                                 rect[0], y, rect[2] - rect[0], nullptr);
+                }
+            }
+        }
+
+        void renderTriangle(Rasterizer &rasterizer, const Shading &shading,
+                            const Scissor *scissor, const NVGvertex *v, int y0, int y1) {
+            float r = mPixelRatio, bounds[4] = {
+                std::min({ v[0].x, v[1].x, v[2].x }) * r, std::min({ v[0].y, v[1].y, v[2].y }) * r,
+                std::max({ v[0].x, v[1].x, v[2].x }) * r, std::max({ v[0].y, v[1].y, v[2].y }) * r
+            };
+            int rect[4];
+            if (!pixelRect(bounds, y0, y1, rect, scissor))
+                return;
+
+            /* Texture coordinates are an affine function of the position */
+            float dx1 = v[1].x - v[0].x, dy1 = v[1].y - v[0].y,
+                  dx2 = v[2].x - v[0].x, dy2 = v[2].y - v[0].y;
+            float det = dx1 * dy2 - dx2 * dy1;
+            if (det == 0.f)
+                return;
+            float uv[6];
+            for (int k = 0; k < 2; ++k) {
+                float t0 = k == 0 ? v[0].u : v[0].v,
+                      d1 = (k == 0 ? v[1].u : v[1].v) - t0,
+                      d2 = (k == 0 ? v[2].u : v[2].v) - t0;
+                float gx = (d1 * dy2 - d2 * dy1) / det, gy = (d2 * dx1 - d1 * dx2) / det;
+                uv[3 * k + 0] = gx;
+                uv[3 * k + 1] = gy;
+                uv[3 * k + 2] = t0 - gx * v[0].x - gy * v[0].y;
+            }
+
+            rasterizer.begin(rect[0], rect[1], rect[2], rect[3]);
+            for (int i = 0; i < 3; ++i) {
+                const NVGvertex &a = v[i], &b = v[(i + 1) % 3];
+                rasterizer.line(a.x * r, a.y * r, b.x * r, b.y * r);
+            }
+            for (int y = rect[1]; y < rect[3]; ++y)
+                shadeRow(shading, scissor, rasterizer.resolve(y - rect[1]), rect[0], y,
+                         rect[2] - rect[0], uv);
+        }
+
+        static void sample(const Shading &s, float u, float v, float *out) {
+            const Texture &t = *s.texture;
+            int channels = t.type == NVG_TEXTURE_RGBA ? 4 : 1;
+            float fx = u * t.width - 0.5f, fy = v * t.height - 0.5f;
+            auto wrap = [](int i, int size, bool repeat) {
+                if (repeat) {
+                    i %= size;
+                    return i < 0 ? i + size : i;
+                }
+                return std::min(std::max(i, 0), size - 1);
+            };
+            bool rx = (t.flags & NVG_IMAGE_REPEATX) != 0, ry = (t.flags & NVG_IMAGE_REPEATY) != 0;
+            float texel[4] = { 0.f, 0.f, 0.f, 0.f };
+            if (t.flags & NVG_IMAGE_NEAREST) {
+                int x = wrap((int) std::floor(fx + 0.5f), t.width, rx),
+                    y = wrap((int) std::floor(fy + 0.5f), t.height, ry);
+                const uint8_t *p = t.data.data() + ((size_t) y * t.width + x) * channels;
+                for (int c = 0; c < channels; ++c)
+                    texel[c] = p[c];
+            } else {
+                float x0f = std::floor(fx), y0f = std::floor(fy);
+                float wx = fx - x0f, wy = fy - y0f;
+                int xs[2] = { wrap((int) x0f, t.width, rx), wrap((int) x0f + 1, t.width, rx) },
+                    ys[2] = { wrap((int) y0f, t.height, ry), wrap((int) y0f + 1, t.height, ry) };
+                for (int j = 0; j < 2; ++j) {
+                    for (int i = 0; i < 2; ++i) {
+                        float w = (i ? wx : 1.f - wx) * (j ? wy : 1.f - wy);
+                        const uint8_t *p = t.data.data() + ((size_t) ys[j] * t.width + xs[i]) * channels;
+                        for (int c = 0; c < channels; ++c)
+                            texel[c] += w * p[c];
+                    }
+                }
+            }
+            for (int c = 0; c < 4; ++c)
+                texel[c] *= 1.f / 255.f;
+            if (s.textureType == 1) {
+                for (int c = 0; c < 3; ++c)
+                    texel[c] *= texel[3];
+            } else if (s.textureType == 2) {
+                texel[1] = texel[2] = texel[3] = texel[0];
+            }
+            for (int c = 0; c < 4; ++c)
+                out[c] = texel[c] * s.inner[c];
+        }
+
+        /// Premultiplied color of the paint at a position in logical coordinates
+        void shade(const Shading &s, float x, float y, const float *uv, float *out) const {
+            if (uv) {
+                float u = uv[0] * x + uv[1] * y + uv[2], v = uv[3] * x + uv[4] * y + uv[5];
+                if (s.texture)
+                    sample(s, u, v, out);
+                else
+                    memcpy(out, s.inner, sizeof(float) * 4);
+                return;
+            }
+            const float *m = s.paintMat;
+            float px = m[0] * x + m[2] * y + m[4], py = m[1] * x + m[3] * y + m[5];
+            if (s.texture) {
+                sample(s, px / s.extent[0], py / s.extent[1], out);
+                return;
+            }
+            /* Signed distance to the rounded rectangle, as in the fragment shader */
+            float ex = s.extent[0] - s.radius, ey = s.extent[1] - s.radius;
+            float dx = std::abs(px) - ex, dy = std::abs(py) - ey;
+            float dist = std::min(std::max(dx, dy), 0.f) +
+                         std::sqrt(std::max(dx, 0.f) * std::max(dx, 0.f) +
+                                   std::max(dy, 0.f) * std::max(dy, 0.f)) - s.radius;
+            float t = clamp01((dist + s.feather * 0.5f) / s.feather);
+            for (int c = 0; c < 4; ++c)
+                out[c] = s.inner[c] + (s.outer[c] - s.inner[c]) * t;
+        }
+
+        static float blendFactor(int factor, const float *src, const float *dst, int c) {
+            switch (factor) {
+                case NVG_ZERO: return 0.f;
+                case NVG_ONE: return 1.f;
+                case NVG_SRC_COLOR: return src[c];
+                case NVG_ONE_MINUS_SRC_COLOR: return 1.f - src[c];
+                case NVG_DST_COLOR: return dst[c];
+                case NVG_ONE_MINUS_DST_COLOR: return 1.f - dst[c];
+                case NVG_SRC_ALPHA: return src[3];
+                case NVG_ONE_MINUS_SRC_ALPHA: return 1.f - src[3];
+                case NVG_DST_ALPHA: return dst[3];
+                case NVG_ONE_MINUS_DST_ALPHA: return 1.f - dst[3];
+                case NVG_SRC_ALPHA_SATURATE: return c == 3 ? 1.f : std::min(src[3], 1.f - dst[3]);
+                default: return 0.f;
+            }
+        }
+
+        static void blend(const Shading &s, uint8_t *pixel, const float *src) {
+            float dst[4], out[4];
+            for (int c = 0; c < 4; ++c)
+                dst[c] = pixel[c] * (1.f / 255.f);
+            if (s.sourceOver) {
+                for (int c = 0; c < 4; ++c)
+                    out[c] = src[c] + dst[c] * (1.f - src[3]);
+            } else {
+                const NVGcompositeOperationState &op = s.composite;
+                for (int c = 0; c < 4; ++c) {
+                    bool alpha = c == 3;
+                    out[c] = src[c] * blendFactor(alpha ? op.srcAlpha : op.srcRGB, src, dst, c) +
+                             dst[c] * blendFactor(alpha ? op.dstAlpha : op.dstRGB, src, dst, c);
+                }
+            }
+            for (int c = 0; c < 4; ++c)
+                pixel[c] = (uint8_t) (clamp01(out[c]) * 255.f + 0.5f);
+        }
+
+        void shadeRow(const Shading &s, const Scissor *scissor, float *cov, int x0, int y,
+                      int width, const float *uv) {
+            uint8_t *row = mPixels.data() + ((size_t) y * mWidth + x0) * 4;
+            float invRatio = 1.f / mPixelRatio, py = (y + 0.5f) * invRatio;
+
+            if (scissor)
+                applyScissor(*scissor, cov, x0, y, width);
+
+            if (s.solid && s.sourceOver && !uv) {
+                blendSolid(row, cov, width, s.inner);
+                return;
+            }
+
+            float color[4];
+            for (int i = 0; i < width; ++i) {
+                float c = cov[i];
+                if (c <= 0.f)
+                    continue;
+                shade(s, (x0 + i + 0.5f) * invRatio, py, uv, color);
+                for (int k = 0; k < 4; ++k)
+                    color[k] *= c;
+                blend(s, row + 4 * i, color);
+            }
+        }
+
+        /// Source-over blending of a premultiplied color, the common case
+        static void blendSolid(uint8_t *row, const float *cov, int width, const float *color) {
+            bool opaque = color[3] >= 1.f;
+            uint8_t solid[4];
+            for (int c = 0; c < 4; ++c)
+                solid[c] = (uint8_t) (clamp01(color[c]) * 255.f + 0.5f);
+#if defined(NANOGUI_SOFTWARE_SSE2)
+            __m128 src = _mm_mul_ps(_mm_loadu_ps(color), _mm_set1_ps(255.f));
+            __m128i zero = _mm_setzero_si128();
+#endif
+            for (int i = 0; i < width; ++i) {
+                float c = cov[i];
+                uint8_t *pixel = row + 4 * i;
+                if (c <= 0.f)
+                    continue;
+                if (c >= 1.f && opaque) {
+                    memcpy(pixel, solid, 4);
+                    continue;
+                }
+#if defined(NANOGUI_SOFTWARE_SSE2)
+                int32_t packed;
+                memcpy(&packed, pixel, 4);
+                __m128i p = _mm_cvtsi32_si128(packed);
+                p = _mm_unpacklo_epi16(_mm_unpacklo_epi8(p, zero), zero);
+                __m128 dst = _mm_cvtepi32_ps(p);
+                __m128 out = _mm_add_ps(_mm_mul_ps(src, _mm_set1_ps(c)),
+                                        _mm_mul_ps(dst, _mm_set1_ps(1.f - color[3] * c)));
+                p = _mm_cvtps_epi32(out);
+                p = _mm_packus_epi16(_mm_packs_epi32(p, p), zero);
+                packed = _mm_cvtsi128_si32(p);
+                memcpy(pixel, &packed, 4);
+#else
+                float inv = 1.f - color[3] * c;
+                for (int k = 0; k < 4; ++k)
+                    pixel[k] = (uint8_t) std::min(color[k] * c * 255.f + pixel[k] * inv + 0.5f, 255.f);
+#endif
+            }
+        }
+
+        int mThreadCount;
+        float mPixelRatio = 1.f;
+        int mWidth = 0, mHeight = 0;
+        std::vector<uint8_t> mPixels;
+        std::unordered_map<int, Texture> mTextures;
+        int mTextureCounter = 0;
+        std::vector<Batch> mBatches;
+        std::vector<Shape> mShapes;
+        std::vector<Scissor> mScissors;
+        NVGpaint mLastPaint;
+        NVGcompositeOperationState mLastComposite;
+        bool mLastPaintValid = false;
+        std::vector<Edge> mEdges;
+        std::vector<NVGvertex> mVertices;
+        std::vector<Rasterizer> mRasterizers;
+        BandWorkers mWorkers;
+    };
+
+    SoftwareRenderer *renderer(NVGcontext *ctx) {
+        return (SoftwareRenderer *) nvgInternalParams(ctx)->userPtr;
+    }
+
+    /// Also identifies software contexts, see nvgIsSoftware()
+    void deleteRenderer(void *uptr) {
+        delete (SoftwareRenderer *) uptr;
+    }
+}
+
+NVGcontext *nvgCreateSoftware(int threadCount) {
+    NVGparams params;
+    memset(&params, 0, sizeof(params));
+    params.userPtr = new SoftwareRenderer(threadCount);
+    /* Coverage is computed exactly, so NanoVG must not add fringes */
+    params.edgeAntiAlias = 0;
+    params.renderCreate = [](void *) { return 1; };
+    params.renderCreateTexture = [](void *uptr, int type, int w, int h, int imageFlags,
+                                    const unsigned char *data) {
+        return ((SoftwareRenderer *) uptr)->createTexture(type, w, h, imageFlags, data);
+    };
+    params.renderDeleteTexture = [](void *uptr, int image) {
+        ((SoftwareRenderer *) uptr)->deleteTexture(image);
+        return 1;
+    };
+    params.renderUpdateTexture = [](void *uptr, int image, int x, int y, int w, int h,
+                                    const unsigned char *data) {
+        return ((SoftwareRenderer *) uptr)->updateTexture(image, x, y, w, h, data) ? 1 : 0;
+    };
+    params.renderGetTextureSize = [](void *uptr, int image, int *w, int *h) {
+        const Texture *texture = ((SoftwareRenderer *) uptr)->findTexture(image);
+        if (!texture)
+            return 0;
+        *w = texture->width;
+        *h = texture->height;
+        return 1;
+    };
+    params.renderViewport = [](void *uptr, float width, float height, float devicePixelRatio) {
+        ((SoftwareRenderer *) uptr)->viewport(width, height, devicePixelRatio);
+    };
+    params.renderCancel = [](void *uptr) { ((SoftwareRenderer *) uptr)->cancel(); };
+    params.renderFlush = [](void *uptr) { ((SoftwareRenderer *) uptr)->flush(); };
+    params.renderFill = [](void *uptr, NVGpaint *paint, NVGcompositeOperationState op,
+                           NVGscissor *scissor, float fringe, const float *,
+                           const NVGpath *paths, int npaths) {
+        ((SoftwareRenderer *) uptr)->fill(paint, op, scissor, fringe, paths, npaths);
+    };
+    params.renderStroke = [](void *uptr, NVGpaint *paint, NVGcompositeOperationState op,
+                             NVGscissor *scissor, float fringe, float,
+                             const NVGpath *paths, int npaths) {
+        ((SoftwareRenderer *) uptr)->stroke(paint, op, scissor, fringe, paths, npaths);
+    };
+    params.renderTriangles = [](void *uptr, NVGpaint *paint, NVGcompositeOperationState op,
+                                NVGscissor *scissor, const NVGvertex *verts, int nverts) {
+        ((SoftwareRenderer *) uptr)->triangles(paint, op, scissor, verts, nverts);
+    };
+    params.renderDelete = deleteRenderer;
+
+    /* NanoVG calls renderDelete() itself if creating the context fails */
+    return nvgCreateInternal(&params);
+}
+
+bool nvgIsSoftware(NVGcontext *ctx) {
+    return nvgInternalParams(ctx)->renderDelete == deleteRenderer;
+}
+
+void nvgDeleteSoftware(NVGcontext *ctx) {
+    nvgDeleteInternal(ctx);
+}
+
+void nvgSoftwareClear(NVGcontext *ctx, const Color &color) {
+    renderer(ctx)->clear(color);
+}
+
+const uint8_t *nvgSoftwarePixels(NVGcontext *ctx, int *width, int *height) {
+    return renderer(ctx)->pixels(width, height);
+}
+
+NAMESPACE_END(nanogui)
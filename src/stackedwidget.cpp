@@ -13,6 +13,8 @@
 */
 
 #include <nanogui/stackedwidget.h>
+#include <nanogui/screen.h>
+#include <algorithm>
 
 NAMESPACE_BEGIN(nanogui)
 
@@ -24,20 +26,68 @@ void StackedWidget::setSelectedIndex(int index) {
     if (mSelectedIndex >= 0)
         mChildren[mSelectedIndex]->setVisible(false);
     mSelectedIndex = index;
-    if (mSelectedIndex >= 0)
+    if (mSelectedIndex >= 0) {
         mChildren[mSelectedIndex]->setVisible(true);
+        if (layoutStale(mSelectedIndex))
+            layoutPage(mSelectedIndex);
+        schedulePrelayout();
+    }
 }
 
 int StackedWidget::selectedIndex() const {
     return mSelectedIndex;
 }
 
+bool StackedWidget::layoutStale(int index) const {
+    return std::find(mStalePages.begin(), mStalePages.end(), mChildren[index]) != mStalePages.end();
+}
+
+void StackedWidget::layoutPage(int index) {
+    Widget *child = mChildren[index];
+    mStalePages.erase(std::remove(mStalePages.begin(), mStalePages.end(), child), mStalePages.end());
+    child->setPosition(Vector2i::Zero());
+    child->setSize(mSize);
+    child->performLayout(mLayoutContext);
+}
+
+void StackedWidget::schedulePrelayout() {
+    if (!mPrelayout || mPrelayoutScheduled || mStalePages.empty())
+        return;
+    Widget *widget = this;
+    while (widget && !dynamic_cast<Screen *>(widget))
+        widget = widget->parent();
+    if (!widget)
+        return; // Not attached to a screen yet
+
+    /* Lay out one neighbor of the selected page after each frame, so that
+       the frame that shows the page doesn't pay for its neighbors */
+    mPrelayoutScheduled = true;
+    ref<StackedWidget> self = this;
+    static_cast<Screen *>(widget)->postAfterFrame([self]() mutable {
+        self->mPrelayoutScheduled = false;
+        if (self->removed() || self->mSelectedIndex < 0)
+            return;
+        int index = self->mSelectedIndex;
+        for (int neighbor : { index + 1, index - 1 }) {
+            if (neighbor >= 0 && neighbor < self->childCount() && self->layoutStale(neighbor)) {
+                self->layoutPage(neighbor);
+                self->schedulePrelayout();
+                return;
+            }
+        }
+    });
+}
+
 void StackedWidget::performLayout(NVGcontext *ctx) {
-    for (auto child : mChildren) {
-        child->setPosition(Vector2i::Zero());
-        child->setSize(mSize);
-        child->performLayout(ctx);
+    mLayoutContext = ctx;
+    mStalePages.clear();
+    for (int i = 0; i < childCount(); ++i) {
+        if (mLazyLayout && i != mSelectedIndex)
+            mStalePages.push_back(mChildren[i]);
+        else
+            layoutPage(i);
     }
+    schedulePrelayout();
 }
 
 Vector2i StackedWidget::preferredSize(NVGcontext *ctx) const {
@@ -55,4 +105,10 @@ void StackedWidget::addChild(int index, Widget *widget) {
     setSelectedIndex(index);
 }
 
+void StackedWidget::removeChild(const Widget *widget) {
+    /* The page may be destroyed, and another one allocated at its address */
+    mStalePages.erase(std::remove(mStalePages.begin(), mStalePages.end(), widget), mStalePages.end());
+    Widget::removeChild(widget);
+}
+
 NAMESPACE_END(nanogui)
@@ -302,8 +302,7 @@ void TabHeader::performLayout(NVGcontext* ctx) {
 
 Vector2i TabHeader::preferredSize(NVGcontext* ctx) const {
     // Set up the nvg context for measuring the text inside the tab buttons.
-    nvgFontFace(ctx, mFont.c_str());
-    nvgFontSize(ctx, fontSize());
+    mTheme->setFont(ctx, mFont, fontSize());
     nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
     Vector2i size = Vector2i(2*theme()->get<int>("/tab/control/width"), 0);
     for (auto& tab : mTabButtons) {
@@ -358,8 +357,7 @@ void TabHeader::draw(NVGcontext* ctx) {
         drawControls(ctx);
 
     // Set up common text drawing settings.
-    nvgFontFace(ctx, mFont.c_str());
-    nvgFontSize(ctx, fontSize());
+    mTheme->setFont(ctx, mFont, fontSize());
     nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
 
     auto current = visibleBegin();
@@ -411,8 +409,7 @@ void TabHeader::drawControls(NVGcontext* ctx) {
     int fontSize = mFontSize == -1 ? mTheme->prop("/button/text-size") : mFontSize;
     float ih = fontSize;
     ih *= 1.5f;
-    nvgFontSize(ctx, ih);
-    nvgFontFace(ctx, "icons");
+    mTheme->setFont(ctx, "icons", ih);
     NVGcolor arrowColor;
     if (active)
         arrowColor = mTheme->get<Color>("/text-color");
@@ -433,8 +430,7 @@ void TabHeader::drawControls(NVGcontext* ctx) {
     fontSize = mFontSize == -1 ? mTheme->get<int>("/button/text-size") : mFontSize;
     ih = fontSize;
     ih *= 1.5f;
-    nvgFontSize(ctx, ih);
-    nvgFontFace(ctx, "icons");
+    mTheme->setFont(ctx, "icons", ih);
     float rightWidth = nvgTextBounds(ctx, 0, 0, iconRight.data(), nullptr, nullptr);
     if (active)
         arrowColor = mTheme->get<Color>("/text-color");
@@ -117,6 +117,14 @@ const std::string &TabWidget::tabLabelAt(int index) const {
     return mHeader->tabLabelAt(index);
 }
 
+bool TabWidget::prelayout() const {
+    return mContent->prelayout();
+}
+
+void TabWidget::setPrelayout(bool prelayout) {
+    mContent->setPrelayout(prelayout);
+}
+
 void TabWidget::performLayout(NVGcontext* ctx) {
     int headerHeight = mHeader->preferredSize(ctx).y();
     int margin = mTheme->prop("/tab/inner-margin");
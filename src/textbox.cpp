@@ -15,6 +15,7 @@
 #include <nanogui/window.h>
 #include <nanogui/screen.h>
 #include <nanogui/textbox.h>
+#include <nanogui/imageatlas.h>
 #include <nanogui/opengl.h>
 #include <nanogui/theme.h>
 #include <nanogui/entypo.h>
@@ -57,16 +58,16 @@ Vector2i TextBox::preferredSize(NVGcontext *ctx) const {
     Vector2i size(0, 0);
     float bounds[4];
     nvgSave(ctx);
-    nvgFontFace(ctx, mPreferredFont.c_str());
-    nvgFontSize(ctx, (mFontSize < 0) ? mTheme->prop("/textbox/text-size") : mFontSize);
+    mTheme->setFont(ctx, mPreferredFont,
+                    (mFontSize < 0) ? mTheme->get<int>("/textbox/text-size") : mFontSize);
     float ts = nvgTextBounds(ctx, 0, 0, mValue.c_str(), nullptr, bounds);
     nvgRestore(ctx);
     size(1) = (bounds[3] - bounds[1])*1.8f;
 
     float uw = 0;
-    if (mUnitsImage > 0) {
+    if (mUnitsImage > 0 || nvgIsAtlasIcon(mUnitsImage)) {
         int w, h;
-        nvgImageSize(ctx, mUnitsImage, &w, &h);
+        nvgIconSize(ctx, mUnitsImage, &w, &h);
         float uh = size(1) * 0.4f;
         uw = w * uh / h;
     } else if (!mUnits.empty()) {
@@ -84,49 +85,44 @@ Vector2i TextBox::preferredSize(NVGcontext *ctx) const {
 void TextBox::draw(NVGcontext* ctx) {
     Widget::draw(ctx);
 
-    NVGpaint bg = nvgBoxGradient(ctx,
-        mPos.x() + 1, mPos.y() + 1 + 1.0f, mSize.x() - 2, mSize.y() - 2,
-        3, 4, Color(255, 32), Color(32, 32));
-    NVGpaint fg1 = nvgBoxGradient(ctx,
-        mPos.x() + 1, mPos.y() + 1 + 1.0f, mSize.x() - 2, mSize.y() - 2,
-        3, 4, Color(150, 32), Color(32, 32));
-    NVGpaint fg2 = nvgBoxGradient(ctx,
-        mPos.x() + 1, mPos.y() + 1 + 1.0f, mSize.x() - 2, mSize.y() - 2,
-        3, 4, nvgRGBA(255, 0, 0, 100), nvgRGBA(255, 0, 0, 50));
-
-    nvgBeginPath(ctx);
-    nvgRoundedRect(ctx, mPos.x() + 1, mPos.y() + 1 + 1.0f, mSize.x() - 2,
-                   mSize.y() - 2, 3);
-
-    if (mEditable && focused())
-        mValidFormat ? nvgFillPaint(ctx, fg1) : nvgFillPaint(ctx, fg2);
-    else if (mSpinnable && mMouseDownPos.x() != -1)
-        nvgFillPaint(ctx, fg1);
-    else
-        nvgFillPaint(ctx, bg);
+    Color inner(255, 32), outer(32, 32);
+    if (mEditable && focused() && !mValidFormat) {
+        inner = Color(255, 0, 0, 100);
+        outer = Color(255, 0, 0, 50);
+    } else if ((mEditable && focused()) || (mSpinnable && mMouseDownPos.x() != -1)) {
+        inner = Color(150, 32);
+    }
+
+    mTheme->drawChrome(ctx, mChrome, "textbox", { inner, outer }, {}, mPos, mSize,
+                       Vector2i(8, 0), drawPixelRatio(),
+                       [=](NVGcontext *ctx, const Vector2i &size) {
+        NVGpaint bg = nvgBoxGradient(ctx, 1, 1 + 1.0f, size.x() - 2, size.y() - 2,
+                                     3, 4, inner, outer);
 
-    nvgFill(ctx);
+        nvgBeginPath(ctx);
+        nvgRoundedRect(ctx, 1, 1 + 1.0f, size.x() - 2, size.y() - 2, 3);
+        nvgFillPaint(ctx, bg);
+        nvgFill(ctx);
 
-    nvgBeginPath(ctx);
-    nvgRoundedRect(ctx, mPos.x() + 0.5f, mPos.y() + 0.5f, mSize.x() - 1,
-                   mSize.y() - 1, 2.5f);
-    nvgStrokeColor(ctx, Color(0, 48));
-    nvgStroke(ctx);
+        nvgBeginPath(ctx);
+        nvgRoundedRect(ctx, 0.5f, 0.5f, size.x() - 1, size.y() - 1, 2.5f);
+        nvgStrokeColor(ctx, Color(0, 48));
+        nvgStroke(ctx);
+    });
 
-    nvgFontSize(ctx, fontSize());
-    nvgFontFace(ctx, mPreferredFont.c_str());
+    mTheme->setFont(ctx, mPreferredFont, fontSize());
     Vector2i drawPos(mPos.x(), mPos.y() + mSize.y() * 0.5f + 1);
 
     float xSpacing = mSize.y() * 0.3f;
 
     float unitWidth = 0;
 
-    if (mUnitsImage > 0) {
+    if (mUnitsImage > 0 || nvgIsAtlasIcon(mUnitsImage)) {
         int w, h;
-        nvgImageSize(ctx, mUnitsImage, &w, &h);
+        nvgIconSize(ctx, mUnitsImage, &w, &h);
         float unitHeight = mSize.y() * 0.4f;
         unitWidth = w * unitHeight / h;
-        NVGpaint imgPaint = nvgImagePattern(
+        NVGpaint imgPaint = nvgIconPattern(
             ctx, mPos.x() + mSize.x() - xSpacing - unitWidth,
             drawPos.y() - unitHeight * 0.5f, unitWidth, unitHeight, 0,
             mUnitsImage, mEnabled ? 0.7f : 0.35f);
@@ -150,8 +146,8 @@ void TextBox::draw(NVGcontext* ctx) {
     if (mSpinnable && !focused()) {
         spinArrowsWidth = 14.f;
 
-        nvgFontFace(ctx, "icons");
-        nvgFontSize(ctx, ((mFontSize < 0) ? mTheme->prop("/textbox/text-size") : mFontSize) * 1.2f);
+        mTheme->setFont(ctx, "icons",
+            ((mFontSize < 0) ? mTheme->get<int>("/textbox/text-size") : mFontSize) * 1.2f);
 
         bool spinning = mMouseDownPos.x() != -1;
 
@@ -175,8 +171,7 @@ void TextBox::draw(NVGcontext* ctx) {
             nvgText(ctx, iconPos.x(), iconPos.y(), icon.data(), nullptr);
         }
 
-        nvgFontSize(ctx, fontSize());
-        nvgFontFace(ctx, mPreferredFont.c_str());
+        mTheme->setFont(ctx, mPreferredFont, fontSize());
     }
 
     switch (mAlignment) {
@@ -194,7 +189,7 @@ void TextBox::draw(NVGcontext* ctx) {
             break;
     }
 
-    nvgFontSize(ctx, fontSize());
+    mTheme->setFont(ctx, mPreferredFont, fontSize());
     nvgFillColor(ctx,
                  mEnabled ? mTheme->get<Color>("/text-color") : mTheme->get<Color>("/disabled-text-color"));
 
@@ -293,7 +288,7 @@ bool TextBox::mouseButtonEvent(const Vector2i &p, int button, bool down,
             mMouseDownPos = p;
             mMouseDownModifier = modifiers;
 
-            double time = glfwGetTime();
+            double time = screen()->time();
             if (time - mLastClick < 0.25) {
                 /* Double-click: select all text */
                 mSelectionPos = 0;
@@ -330,7 +325,7 @@ bool TextBox::mouseButtonEvent(const Vector2i &p, int button, bool down,
                 mMouseDownPos = p;
                 mMouseDownModifier = modifiers;
 
-                double time = glfwGetTime();
+                double time = screen()->time();
                 if (time - mLastClick < 0.25) {
                     /* Double-click: reset to default value */
                     mValue = mDefaultValue;
@@ -356,6 +351,9 @@ bool TextBox::mouseButtonEvent(const Vector2i &p, int button, bool down,
 
 bool TextBox::mouseMotionEvent(const Vector2i &p, const Vector2i & /* rel */,
                                int /* button */, int /* modifiers */) {
+    /* The spin arrows highlight on hover */
+    if (mSpinnable && spinArea(p) != spinArea(mMousePos))
+        markDirty();
     mMousePos = p;
 
     if (!mEditable)
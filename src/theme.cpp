@@ -13,10 +13,119 @@
 
 #include <nanogui/theme.h>
 #include <nanogui/opengl.h>
+#include <nanogui/imagecache.h>
+#include <nanogui/softwarerenderer.h>
 #include <nanogui_resources.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <mutex>
 
 NAMESPACE_BEGIN(nanogui)
 
+namespace {
+    /// Immutable font data, shared by all NanoVG contexts of the process
+    struct FontData {
+        const unsigned char *data = nullptr;
+        size_t size = 0;
+        std::vector<unsigned char> storage;
+    };
+
+    typedef std::shared_future<std::shared_ptr<const FontData>> FontHandle;
+
+    FontHandle makeFontHandle(std::shared_ptr<const FontData> data) {
+        std::promise<std::shared_ptr<const FontData>> promise;
+        promise.set_value(std::move(data));
+        return promise.get_future().share();
+    }
+
+    FontHandle makeFontHandle(const unsigned char *data, size_t size) {
+        auto font = std::make_shared<FontData>();
+        font->data = data;
+        font->size = size;
+        return makeFontHandle(std::move(font));
+    }
+
+    std::shared_ptr<const FontData> readFontFile(const std::string &filename) {
+        std::ifstream is(filename, std::ios::binary);
+        if (!is)
+            throw std::runtime_error("Could not open font file \"" + filename + "\"!");
+        auto font = std::make_shared<FontData>();
+        font->storage.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+        font->data = font->storage.data();
+        font->size = font->storage.size();
+        return font;
+    }
+
+    struct FontEntry {
+        FontHandle handle;
+        /// Incremented whenever the face is replaced
+        size_t version = 0;
+        /// Set once a background load of this version has failed
+        bool failed = false;
+    };
+
+    std::mutex fontRegistryMutex;
+
+    /// Incremented whenever a face is registered, so that themes notice replaced faces
+    std::atomic<size_t> fontGeneration(0);
+
+    /// Font faces known to the process, guarded by \c fontRegistryMutex
+    std::unordered_map<std::string, FontEntry> &fontRegistry() {
+        static std::unordered_map<std::string, FontEntry> registry = {
+            { "sans",      { makeFontHandle(roboto_regular_ttf, roboto_regular_ttf_size) } },
+            { "sans-bold", { makeFontHandle(roboto_bold_ttf, roboto_bold_ttf_size) } },
+            { "mono",      { makeFontHandle(droidsans_mono_ttf, droidsans_mono_ttf_size) } },
+            { "icons",     { makeFontHandle(entypo_ttf, entypo_ttf_size) } }
+        };
+        return registry;
+    }
+
+    void insertFont(const std::string &name, FontHandle handle) {
+        /* Contexts may still reference the data of a replaced face, so it is kept alive */
+        static std::vector<FontHandle> replaced;
+        std::lock_guard<std::mutex> guard(fontRegistryMutex);
+        FontEntry &entry = fontRegistry()[name];
+        if (entry.handle.valid())
+            replaced.push_back(std::move(entry.handle));
+        entry.handle = std::move(handle);
+        entry.version++;
+        entry.failed = false;
+        fontGeneration++;
+    }
+
+    /// Report that a version of a face can't be used, once
+    void markFontFailed(const std::string &name, size_t version, const std::string &message) {
+        std::cerr << "Theme::fontId(): " << message << std::endl;
+        std::lock_guard<std::mutex> guard(fontRegistryMutex);
+        FontEntry &entry = fontRegistry()[name];
+        if (entry.version == version)
+            entry.failed = true;
+    }
+
+    /// Chrome templates longer than this along an axis that isn't stretched are drawn directly
+    const int maxChromeExtent = 256;
+
+    /// Software context that renders chrome templates on the calling thread
+    NVGcontext *chromeContext() {
+        struct Holder {
+            NVGcontext *ctx = nullptr;
+            ~Holder() {
+                if (ctx)
+                    nvgDeleteSoftware(ctx);
+            }
+        };
+        thread_local Holder holder;
+        if (!holder.ctx)
+            holder.ctx = nvgCreateSoftware(1);
+        return holder.ctx;
+    }
+}
+
 Theme::Theme(NVGcontext* ctx)
     : mCtx(ctx) {
     prop("/textbox/text-size") = 20;
@@ -66,13 +175,12 @@ Theme::Theme(NVGcontext* ctx)
     prop("/popup/fill")        = Color(50, 255);
     prop("/popup/transparent") = Color(50, 0);
 
-    bool loadedFonts = true;
-    loadedFonts &= nvgCreateFontMem(mCtx, "sans", roboto_regular_ttf, roboto_regular_ttf_size, 0) >= 0;
-    loadedFonts &= nvgCreateFontMem(mCtx, "sans-bold", roboto_bold_ttf, roboto_bold_ttf_size, 0) >= 0;
-    loadedFonts &= nvgCreateFontMem(mCtx, "mono", droidsans_mono_ttf, droidsans_mono_ttf_size, 0) >= 0;
-    loadedFonts &= nvgCreateFontMem(mCtx, "icons", entypo_ttf, entypo_ttf_size, 0) >= 0;
-    if (!loadedFonts)
-        throw std::runtime_error("Could not load fonts!");    
+    /* Register the default faces right away, so that plain nvgFontFace()
+       calls find them before any widget has selected them */
+    if (mCtx) {
+        for (const char *face : { "sans", "sans-bold", "mono", "icons" })
+            fontId(mCtx, face);
+    }
 }
 
 void Theme::update(const json& j) {
@@ -81,4 +189,256 @@ void Theme::update(const json& j) {
     }
 }
 
+void Theme::addFont(const std::string &name, const unsigned char *data, size_t size,
+                    GlyphMode mode) {
+    registerFont(name, data, size);
+    mGlyphModes[name] = mode;
+}
+
+void Theme::registerFont(const std::string &name, const unsigned char *data, size_t size) {
+    insertFont(name, makeFontHandle(data, size));
+}
+
+void Theme::loadFont(const std::string &name, const std::string &filename, bool background) {
+    FontHandle handle;
+    if (background)
+        handle = std::async(std::launch::async, readFontFile, filename).share();
+    else
+        handle = makeFontHandle(readFontFile(filename));
+    insertFont(name, std::move(handle));
+}
+
+int Theme::fontId(NVGcontext *ctx, const std::string &face) const {
+    uint64_t token = ImageCache::get(ctx)->token();
+    size_t generation = fontGeneration.load();
+    {
+        std::lock_guard<std::mutex> guard(mFontMutex);
+        ContextFonts &fonts = mFontIds[ctx];
+        if (fonts.token != token) {
+            /* A new context at the address of a deleted one */
+            fonts.faces.clear();
+            fonts.token = token;
+        }
+        auto it = fonts.faces.find(face);
+        if (it != fonts.faces.end() && it->second.generation == generation)
+            return it->second.id;
+    }
+
+    FontHandle handle;
+    size_t version;
+    bool failed;
+    {
+        std::lock_guard<std::mutex> guard(fontRegistryMutex);
+        auto it = fontRegistry().find(face);
+        if (it == fontRegistry().end())
+            return nvgFindFont(ctx, face.c_str());
+        handle = it->second.handle;
+        version = it->second.version;
+        failed = it->second.failed;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(mFontMutex);
+        auto it = mFontIds[ctx].faces.find(face);
+        if (it != mFontIds[ctx].faces.end() && it->second.version == version) {
+            it->second.generation = generation;
+            return it->second.id;
+        }
+    }
+
+    /* Fonts that are still being loaded in the background (or failed to
+       load) don't block drawing */
+    if (failed || handle.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return face == "sans" ? -1 : fontId(ctx, "sans");
+
+    std::shared_ptr<const FontData> font;
+    try {
+        font = handle.get();
+    } catch (const std::exception &e) {
+        /* Report the failure once instead of rethrowing it on every frame */
+        markFontFailed(face, version, e.what());
+        return face == "sans" ? -1 : fontId(ctx, "sans");
+    }
+
+    /* A replaced face is created again under the same name */
+    int id = nvgCreateFontMem(ctx, face.c_str(), const_cast<unsigned char *>(font->data),
+                              (int) font->size, 0);
+    if (id < 0) {
+        markFontFailed(face, version, "could not load font \"" + face + "\"!");
+        return face == "sans" ? -1 : fontId(ctx, "sans");
+    }
+
+    std::lock_guard<std::mutex> guard(mFontMutex);
+    mFontIds[ctx].faces[face] = FontSlot { id, version, generation };
+    return id;
+}
+
+GlyphMode Theme::glyphMode(const std::string &face) const {
+    auto it = mGlyphModes.find(face);
+    return it == mGlyphModes.end() ? GlyphMode::Exact : it->second;
+}
+
+void Theme::setFont(NVGcontext *ctx, const std::string &face, float size) const {
+    nvgFontFaceId(ctx, fontId(ctx, face));
+    if (size > 0 && glyphMode(face) == GlyphMode::Quantized) {
+        /* The font atlas caches glyphs per rasterized size, which includes the
+           scale of the current transformation. Snap that size to 1/8 octave
+           steps so that continuous zooming keeps hitting cached glyphs. */
+        float xform[6];
+        nvgCurrentTransform(ctx, xform);
+        float scale = 0.5f * (std::sqrt(xform[0] * xform[0] + xform[1] * xform[1]) +
+                              std::sqrt(xform[2] * xform[2] + xform[3] * xform[3]));
+        if (scale > 0)
+            size = std::exp2(std::round(std::log2(size * scale) * 8.f) / 8.f) / scale;
+    }
+    nvgFontSize(ctx, size);
+}
+
+std::string Theme::chromeKey(const std::string &name, std::initializer_list<Color> colors,
+                             std::initializer_list<float> values) {
+    std::string key = "chrome:" + name;
+    char buf[32];
+    for (const Color &color : colors) {
+        uint32_t packed = 0;
+        for (int i = 0; i < 4; ++i)
+            packed = (packed << 8) |
+                     (uint32_t) std::round(std::min(std::max(color[i], 0.f), 1.f) * 255.f);
+        snprintf(buf, sizeof(buf), ":%08x", packed);
+        key += buf;
+    }
+    for (float value : values) {
+        snprintf(buf, sizeof(buf), ":%g", value);
+        key += buf;
+    }
+    return key;
+}
+
+void Theme::drawChrome(NVGcontext *ctx, ChromeCache &cache, const char *name,
+                       std::initializer_list<Color> colors, std::initializer_list<float> values,
+                       const Vector2i &pos, const Vector2i &size, const Vector2i &margin,
+                       float pixelRatio, const ChromeRender &render, bool hollow) const {
+    if ((size.array() <= 0).any())
+        return;
+
+    /* Slices along each axis: offsets in the template and on screen */
+    Vector2i extent = size;
+    int src[2][4], dst[2][4], count[2];
+    for (int i = 0; i < 2; ++i) {
+        int m = margin[i];
+        if (m > 0 && size[i] > 2 * m + 1) {
+            extent[i] = 2 * m + 1;
+            int s[4] = { 0, m, m + 1, 2 * m + 1 }, d[4] = { 0, m, size[i] - m, size[i] };
+            std::copy(s, s + 4, src[i]);
+            std::copy(d, d + 4, dst[i]);
+            count[i] = 3;
+        } else {
+            src[i][0] = dst[i][0] = 0;
+            src[i][1] = dst[i][1] = size[i];
+            count[i] = 1;
+        }
+    }
+
+    /* Reuse the image of the last frame if nothing it depends on changed */
+    bool same = cache.mName == name && cache.mExtent == extent &&
+                cache.mPixelRatio == pixelRatio &&
+                cache.mParams.size() == colors.size() * 4 + values.size() &&
+                cache.mHandle.valid(ctx);
+    if (same) {
+        const float *param = cache.mParams.data();
+        for (const Color &color : colors)
+            for (int i = 0; i < 4 && same; ++i)
+                same = *param++ == color[i];
+        for (float value : values)
+            same = same && *param++ == value;
+    }
+
+    int image = same ? cache.mHandle.image() : 0;
+    NVGcontext *software = !image && extent.maxCoeff() <= maxChromeExtent && pixelRatio > 0
+                               ? chromeContext() : nullptr;
+    if (software) {
+        ImageCache *images = ImageCache::get(ctx);
+        std::string key = chromeKey(name, colors, values) + ":" +
+                          std::to_string(extent.x()) + "x" + std::to_string(extent.y()) +
+                          "@" + std::to_string(pixelRatio);
+        image = images->acquire(key);
+        if (!image) {
+            nvgBeginFrame(software, extent.x(), extent.y(), pixelRatio);
+            nvgSoftwareClear(software, Color(0, 0));
+            render(software, extent);
+            nvgEndFrame(software);
+
+            int width, height;
+            const uint8_t *pixels = nvgSoftwarePixels(software, &width, &height);
+            image = images->create(pixels, width, height, NVG_IMAGE_PREMULTIPLIED);
+            if (image)
+                image = images->insert(key, image, NVG_IMAGE_PREMULTIPLIED);
+        }
+
+        /* The handle takes over the reference returned by acquire() or insert() */
+        cache.mHandle = ImageCache::Handle(ctx, image, false);
+        cache.mName = name;
+        cache.mExtent = extent;
+        cache.mPixelRatio = pixelRatio;
+        cache.mParams.clear();
+        for (const Color &color : colors)
+            cache.mParams.insert(cache.mParams.end(), color.data(), color.data() + 4);
+        cache.mParams.insert(cache.mParams.end(), values.begin(), values.end());
+    } else if (!image) {
+        cache.reset();
+    }
+
+    if (!image) {
+        nvgSave(ctx);
+        nvgTranslate(ctx, pos.x(), pos.y());
+        render(ctx, size);
+        nvgRestore(ctx);
+        return;
+    }
+
+    /* The slices meet at integer positions, antialiasing their edges would
+       leave visible seams at fractional pixel ratios */
+    nvgSave(ctx);
+    nvgShapeAntiAlias(ctx, 0);
+    for (int y = 0; y < count[1]; ++y) {
+        for (int x = 0; x < count[0]; ++x) {
+            if (hollow && x == 1 && y == 1)
+                continue;
+            float sx = float(dst[0][x + 1] - dst[0][x]) / (src[0][x + 1] - src[0][x]),
+                  sy = float(dst[1][y + 1] - dst[1][y]) / (src[1][y + 1] - src[1][y]);
+            NVGpaint paint = nvgImagePattern(
+                ctx, pos.x() + dst[0][x] - src[0][x] * sx, pos.y() + dst[1][y] - src[1][y] * sy,
+                extent.x() * sx, extent.y() * sy, 0.f, image, 1.f);
+            nvgBeginPath(ctx);
+            nvgRect(ctx, pos.x() + dst[0][x], pos.y() + dst[1][y],
+                    dst[0][x + 1] - dst[0][x], dst[1][y + 1] - dst[1][y]);
+            nvgFillPaint(ctx, paint);
+            nvgFill(ctx);
+        }
+    }
+    nvgRestore(ctx);
+}
+
+void Theme::drawShadow(NVGcontext *ctx, ChromeCache &cache, const Vector2i &pos,
+                       const Vector2i &size, int cornerRadius, int shadowSize,
+                       float pixelRatio) const {
+    Color shadow = get<Color>("/shadow"), transparent = get<Color>("/transparent");
+    int cr = cornerRadius, ds = shadowSize;
+
+    /* The gradient varies within ds outside of the rectangle and 2 * cr + ds inside */
+    drawChrome(ctx, cache, "shadow", { shadow, transparent }, { (float) cr, (float) ds },
+               pos - Vector2i::Constant(ds), size + Vector2i::Constant(2 * ds),
+               Vector2i::Constant(2 * ds + 2 * cr + 1), pixelRatio,
+               [=](NVGcontext *ctx, const Vector2i &extent) {
+        Vector2i inner = extent - Vector2i::Constant(2 * ds);
+        NVGpaint shadowPaint = nvgBoxGradient(ctx, ds, ds, inner.x(), inner.y(), cr * 2,
+                                              ds * 2, shadow, transparent);
+        nvgBeginPath(ctx);
+        nvgRect(ctx, 0, 0, extent.x(), extent.y());
+        nvgRoundedRect(ctx, ds, ds, inner.x(), inner.y(), cr);
+        nvgPathWinding(ctx, NVG_HOLE);
+        nvgFillPaint(ctx, shadowPaint);
+        nvgFill(ctx);
+    }, true);
+}
+
 NAMESPACE_END(nanogui)
@@ -13,18 +13,95 @@
 #include <nanogui/layout.h>
 #include <nanogui/theme.h>
 #include <nanogui/window.h>
+#include <nanogui/popup.h>
 #include <nanogui/opengl.h>
 #include <nanogui/screen.h>
 #include <nanogui/serializer/core.h>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <typeinfo>
 
 NAMESPACE_BEGIN(nanogui)
 
+namespace {
+    /* Snapshots of the children of all widgets whose draw() or mouseButtonEvent()
+       is in progress on this thread. Nested traversals append to the same buffer,
+       so no memory is allocated once it has grown to fit the widget tree. */
+    thread_local std::vector<Widget *> dispatchStack;
+
+    /* Widgets removed during a traversal are released after the outermost one
+       has finished, which keeps the snapshots valid without touching the
+       reference count of every child. In deferred destruction mode, and while
+       screens are drawn in parallel, they are kept until the next call to
+       Widget::reclaimRemoved() on the main thread. The queues are shared by
+       all threads, so removals made by drawing threads are not lost. */
+    thread_local int dispatchDepth = 0;
+    std::mutex releaseMutex;
+    std::vector<const Widget *> deferredReleases;
+    std::vector<const Widget *> quarantinedWidgets;
+    std::atomic<bool> deferredDestructionEnabled(false);
+    std::atomic<bool> removalChecksEnabled(false);
+
+    /* Intersection of the scissor rectangles of the widgets being drawn,
+       in integer frame coordinates, see Widget::setDrawClip() */
+    struct DrawClip {
+        Vector2i min = Vector2i::Zero(), max = Vector2i::Zero();
+        bool enabled = false;
+        float pixelRatio = 1.f;
+        Vector2i frameSize = Vector2i::Zero();
+    };
+    thread_local DrawClip drawClip;
+
+    bool deferReleases() {
+        return deferredDestructionEnabled || removalChecksEnabled || parallelDrawing();
+    }
+
+    /// Release the widgets in a queue guarded by \c releaseMutex
+    void releaseWidgets(std::vector<const Widget *> &widgets) {
+        std::vector<const Widget *> released;
+        while (true) {
+            {
+                std::lock_guard<std::mutex> guard(releaseMutex);
+                if (widgets.empty())
+                    return;
+                released.swap(widgets);
+            }
+            /* Destructors may remove further widgets, which end up in the queue again */
+            for (const Widget *widget : released)
+                widget->decRef();
+            released.clear();
+        }
+    }
+
+    class DispatchScope {
+    public:
+        DispatchScope(const std::vector<Widget *> &children)
+            : mBase(dispatchStack.size()), mSize(children.size()) {
+            dispatchStack.insert(dispatchStack.end(), children.begin(), children.end());
+            ++dispatchDepth;
+        }
+
+        ~DispatchScope() {
+            dispatchStack.resize(mBase);
+            if (--dispatchDepth == 0 && !deferReleases())
+                releaseWidgets(deferredReleases);
+        }
+
+        size_t size() const { return mSize; }
+        Widget *operator[](size_t i) const { return dispatchStack[mBase + i]; }
+
+    private:
+        size_t mBase, mSize;
+    };
+}
+
 Widget::Widget(Widget *parent)
     : mParent(nullptr), mTheme(nullptr), mLayout(nullptr),
       mPos(Vector2i::Zero()), mSize(Vector2i::Zero()),
       mFixedSize(Vector2i::Zero()), mVisible(true), mEnabled(true), mDraggable(true),
       mFocused(false), mMouseFocus(false), mTooltip(""), mFontSize(-1.0),
-      mCursor(Cursor::Arrow) {
+      mCursor(Cursor::Arrow), mRemoved(false) {
     if (parent)
         parent->addChild(this);
 }
@@ -89,26 +166,21 @@ Widget* Widget::findWidget(const Vector2i& p, std::function<bool(const Widget*)>
 }
 
 bool Widget::mouseButtonEvent(const Vector2i &p, int button, bool down, int modifiers) {
-    std::vector<Widget*> children(mChildren);
-    for (Widget * w : children)
-        w->incRef();
-    for (auto it = children.rbegin(); it != children.rend(); ++it) {
-        Widget *child = *it;
+    checkRemoved("mouseButtonEvent");
+    DispatchScope children(mChildren);
+    for (size_t i = children.size(); i-- > 0; ) {
+        Widget *child = children[i];
         if (child->visible() && child->contains(p - mPos) &&
-            child->mouseButtonEvent(p - mPos, button, down, modifiers)) {
-            for (Widget * w : children)
-                w->decRef();
+            child->mouseButtonEvent(p - mPos, button, down, modifiers))
             return true;
-        }
     }
     if (button == GLFW_MOUSE_BUTTON_1 && down)
         requestFocus();
-    for (Widget * w : children)
-        w->decRef();
     return false;
 }
 
 bool Widget::mouseMotionEvent(const Vector2i &p, const Vector2i &rel, int button, int modifiers) {
+    checkRemoved("mouseMotionEvent");
     for (auto it = mChildren.rbegin(); it != mChildren.rend(); ++it) {
         Widget *child = *it;
         if (!child->visible())
@@ -121,6 +193,7 @@ bool Widget::mouseMotionEvent(const Vector2i &p, const Vector2i &rel, int button
 }
 
 bool Widget::scrollEvent(const Vector2i &p, const Vector2f &rel) {
+    checkRemoved("scrollEvent");
     for (auto it = mChildren.rbegin(); it != mChildren.rend(); ++it) {
         Widget *child = *it;
         if (!child->visible())
@@ -137,11 +210,14 @@ bool Widget::mouseDragEvent(const Vector2i &, const Vector2i &, int, int) {
 
 bool Widget::mouseEnterEvent(const Vector2i &, bool enter) {
     mMouseFocus = enter;
+    markDirty();
     return false;
 }
 
 bool Widget::focusEvent(bool focused) {
+    checkRemoved("focusEvent");
     mFocused = focused;
+    markDirty();
     return false;
 }
 
@@ -157,6 +233,7 @@ void Widget::addChild(int index, Widget * widget) {
     assert(index <= childCount());
     mChildren.insert(mChildren.begin() + index, widget);
     widget->incRef();
+    widget->setRemoved(mRemoved);
     widget->setParent(this);
     widget->setTheme(mTheme);
 }
@@ -166,27 +243,38 @@ void Widget::addChild(Widget * widget) {
 }
 
 void Widget::removeChild(const Widget *widget) {
-    // Clear focus path if necessary
-    std::vector<Widget *>& focusPath = screen()->mFocusPath;    
-    if (std::find(focusPath.begin(), focusPath.end(), widget) != focusPath.end())
+    // Clear focus path if necessary, this also cancels focus updates in progress
+    Screen *screen = this->screen();
+    std::vector<Widget *>& focusPath = screen->mFocusPath;
+    if (std::find(focusPath.begin(), focusPath.end(), widget) != focusPath.end()) {
         focusPath.clear();
+        screen->mFocusGeneration++;
+    }
     // Clear mouse focus path if necessary
-    std::vector<Widget *>& mouseFocusPath = screen()->mMouseFocusPath;
-    if (std::find(mouseFocusPath.begin(), mouseFocusPath.end(), widget) != mouseFocusPath.end())
+    std::vector<Widget *>& mouseFocusPath = screen->mMouseFocusPath;
+    if (std::find(mouseFocusPath.begin(), mouseFocusPath.end(), widget) != mouseFocusPath.end()) {
         mouseFocusPath.clear();
+        screen->mMouseFocusGeneration++;
+    }
     // Reset the drag widget if it is a descendent of the widget marked for deletion
-    Widget *dragWidget = screen()->mDragWidget;
+    Widget *dragWidget = screen->mDragWidget;
     while (dragWidget){
         if(dragWidget==widget){
-            screen()->mDragWidget = nullptr;
-            screen()->mDragActive = false;
+            screen->mDragWidget = nullptr;
+            screen->mDragActive = false;
             break;
         }
         dragWidget=dragWidget->parent();
     }
 
     mChildren.erase(std::remove(mChildren.begin(), mChildren.end(), widget), mChildren.end());
-    widget->decRef();
+    const_cast<Widget *>(widget)->setRemoved(true);
+    if (dispatchDepth > 0 || deferReleases()) {
+        std::lock_guard<std::mutex> guard(releaseMutex);
+        deferredReleases.push_back(widget);
+    } else {
+        widget->decRef();
+    }
 }
 
 void Widget::removeChild(int index) {
@@ -233,6 +321,7 @@ const Screen* Widget::screen() const {
 }
 
 void Widget::requestFocus() {
+    checkRemoved("requestFocus");
     screen()->updateFocus(this);
 }
 
@@ -246,6 +335,7 @@ bool Widget::mouseFocus() const {
 }
 
 void Widget::draw(NVGcontext *ctx) {
+    checkRemoved("draw");
     #if NANOGUI_SHOW_WIDGET_BOUNDS
         nvgStrokeWidth(ctx, 1.0f);
         nvgBeginPath(ctx);
@@ -257,24 +347,126 @@ void Widget::draw(NVGcontext *ctx) {
     if (mChildren.empty())
         return;
 
-    std::vector<Widget*> children(mChildren);
-    for (Widget * w : children)
-        w->incRef();
+    DispatchScope children(mChildren);
+
+    /* Culling is limited to translations, which covers everything but
+       widgets that scale or rotate their contents */
+    float xform[6];
+    nvgCurrentTransform(ctx, xform);
+    bool cull = drawClip.enabled && xform[0] == 1.f && xform[1] == 0.f &&
+                xform[2] == 0.f && xform[3] == 1.f;
+    Vector2i offset = mPos + Vector2i((int) std::round(xform[4]),
+                                      (int) std::round(xform[5]));
+    const DrawClip parentClip = drawClip;
 
     nvgSave(ctx);
     nvgTranslate(ctx, mPos.x(), mPos.y());
-    for (auto child : children) {
-        if (child->visible()) {
-            nvgSave(ctx);
-            nvgIntersectScissor(ctx, child->mPos.x(), child->mPos.y(), child->mSize.x(), child->mSize.y());
-            child->draw(ctx);
-            nvgRestore(ctx);
+    for (size_t i = 0; i < children.size(); ++i) {
+        Widget *child = children[i];
+        if (!child->visible())
+            continue;
+        if (cull) {
+            Vector2i min, max;
+            child->drawBounds(min, max);
+            min = (offset + min).cwiseMax(parentClip.min);
+            max = (offset + max).cwiseMin(parentClip.max);
+            if (min.x() >= max.x() || min.y() >= max.y())
+                continue;
+            drawClip.min = min;
+            drawClip.max = max;
         }
+        nvgSave(ctx);
+        nvgIntersectScissor(ctx, child->mPos.x(), child->mPos.y(), child->mSize.x(), child->mSize.y());
+        child->draw(ctx);
+        nvgRestore(ctx);
     }
+    drawClip = parentClip;
     nvgRestore(ctx);
-    
-    for (Widget * w : children)
-        w->decRef();
+}
+
+void Widget::drawBounds(Vector2i &min, Vector2i &max) const {
+    min = mPos;
+    max = mPos + mSize;
+}
+
+void Widget::setDrawClip(const Vector2i &size, float pixelRatio) {
+    drawClip.min = Vector2i::Zero();
+    drawClip.max = size;
+    drawClip.enabled = size != Vector2i::Zero();
+    drawClip.pixelRatio = pixelRatio;
+    drawClip.frameSize = size;
+}
+
+float Widget::drawPixelRatio() {
+    return drawClip.pixelRatio;
+}
+
+Vector2i Widget::drawFrameSize() {
+    return drawClip.frameSize;
+}
+
+void Widget::markDirty() {
+    Widget *widget = this;
+    while (widget) {
+        Window *window = dynamic_cast<Window *>(widget);
+        if (window) {
+            window->mLayerDirty = true;
+            /* Popups mostly edit a widget of the window that opened them */
+            Popup *popup = dynamic_cast<Popup *>(window);
+            if (!popup)
+                return;
+            widget = popup->parentWindow();
+        } else {
+            widget = widget->parent();
+        }
+    }
+}
+
+void Widget::setDeferredDestruction(bool deferred) {
+    deferredDestructionEnabled = deferred;
+    if (!deferred && dispatchDepth == 0)
+        reclaimRemoved();
+}
+
+bool Widget::deferredDestruction() {
+    return deferredDestructionEnabled;
+}
+
+void Widget::setRemovalChecks(bool checks) {
+    removalChecksEnabled = checks;
+    if (!checks && dispatchDepth == 0)
+        reclaimRemoved();
+}
+
+bool Widget::removalChecks() {
+    return removalChecksEnabled;
+}
+
+void Widget::reclaimRemoved() {
+    if (dispatchDepth > 0)
+        throw std::runtime_error("Widget::reclaimRemoved(): called during a traversal!");
+    if (removalChecksEnabled) {
+        /* Quarantine the widgets, so that later uses can still be reported */
+        std::lock_guard<std::mutex> guard(releaseMutex);
+        quarantinedWidgets.insert(quarantinedWidgets.end(), deferredReleases.begin(),
+                                  deferredReleases.end());
+        deferredReleases.clear();
+        return;
+    }
+    releaseWidgets(quarantinedWidgets);
+    releaseWidgets(deferredReleases);
+}
+
+void Widget::checkRemoved(const char *operation) const {
+    if (mRemoved && removalChecksEnabled)
+        std::cerr << "Widget::" << operation << "(): use of removed widget " << this
+                  << " (" << typeid(*this).name() << ")" << std::endl;
+}
+
+void Widget::setRemoved(bool removed) {
+    mRemoved = removed;
+    for (Widget *child : mChildren)
+        child->setRemoved(removed);
 }
 
 void Widget::save(Serializer &s) const {
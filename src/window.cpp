@@ -13,14 +13,39 @@
 #include <nanogui/theme.h>
 #include <nanogui/opengl.h>
 #include <nanogui/screen.h>
+#include <nanogui/popup.h>
 #include <nanogui/layout.h>
+#include <nanogui/glutil.h>
+#include <nanogui/imagecache.h>
 #include <nanogui/serializer/core.h>
 
 NAMESPACE_BEGIN(nanogui)
 
+/// Offscreen copy of a window including its drop shadow
+class Window::Layer {
+public:
+    NVGcontext *context = nullptr;
+    /// Token of the image cache of \c context, which tells whether it is still alive
+    uint64_t token = 0;
+    GLFramebuffer framebuffer;
+    /// Extent in logical pixels (window plus shadow) and in framebuffer pixels
+    Vector2i extent = Vector2i::Zero(), size = Vector2i::Zero();
+    int image = 0;
+
+    ~Layer() {
+        /* NanoVG forgot about the image if the context has been destroyed */
+        if (image && ImageCache::find(context, token))
+            nvgDeleteImage(context, image);
+        if (framebuffer.ready())
+            framebuffer.free();
+    }
+};
+
 Window::Window(Widget *parent, const std::string &title)
     : Widget(parent), mTitle(title), mButtonPanel(nullptr), mModal(false), mDrag(false), mIsBackgroundWindow(false) { }
 
+Window::~Window() { }
+
 Vector2i Window::preferredSize(NVGcontext *ctx) const {
     if (mButtonPanel)
         mButtonPanel->setVisible(false);
@@ -28,8 +53,7 @@ Vector2i Window::preferredSize(NVGcontext *ctx) const {
     if (mButtonPanel)
         mButtonPanel->setVisible(true);
 
-    nvgFontSize(ctx, 18.0f);
-    nvgFontFace(ctx, "sans-bold");
+    mTheme->setFont(ctx, "sans-bold", 18.0f);
     float bounds[4];
     nvgTextBounds(ctx, 0, 0, mTitle.c_str(), nullptr, bounds);
 
@@ -61,12 +85,95 @@ void Window::performLayout(NVGcontext *ctx) {
         mButtonPanel->setPosition(Vector2i(width() - (mButtonPanel->preferredSize(ctx).x() + 5), 3));
         mButtonPanel->performLayout(ctx);
     }
+    markDirty();
+}
+
+void Window::updateLayer(NVGcontext *ctx, float pixelRatio) {
+    if (!mLayered || dynamic_cast<Popup *>(this)) {
+        releaseLayer();
+        return;
+    }
+    if (!mVisible)
+        return;
+
+    int ds = mTheme->prop("/window/shadow-size");
+    Vector2i extent = mSize + Vector2i::Constant(2 * ds);
+    Vector2i size = (extent.cast<float>() * pixelRatio).cast<int>();
+    if (size.minCoeff() <= 0)
+        return;
+
+    if (!mLayer || mLayer->context != ctx || mLayer->size != size ||
+        !ImageCache::find(ctx, mLayer->token)) {
+        releaseLayer();
+        mLayer.reset(new Layer());
+        mLayer->framebuffer.init(size, 0, true);
+        /* NanoVG renders premultiplied colors, and the layer is stored bottom-up */
+        mLayer->image = nvgCreateImageFromTexture(
+            ctx, mLayer->framebuffer.texture(), size.x(), size.y(),
+            NVG_IMAGE_FLIPY | NVG_IMAGE_PREMULTIPLIED);
+        mLayer->context = ctx;
+        mLayer->token = ImageCache::get(ctx)->token();
+        mLayer->size = size;
+        mLayerDirty = true;
+    }
+    mLayer->extent = extent;
+    if (!mLayerDirty)
+        return;
+
+    GLint framebuffer, viewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    mLayer->framebuffer.bind();
+    glViewport(0, 0, size.x(), size.y());
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    /* Widgets draw in absolute coordinates, shift the window into the layer */
+    nvgBeginFrame(ctx, extent.x(), extent.y(), pixelRatio);
+    nvgTranslate(ctx, ds - mPos.x(), ds - mPos.y());
+    mRenderingLayer = true;
+    setDrawClip(extent, pixelRatio);
+    draw(ctx);
+    setDrawClip(Vector2i::Zero());
+    mRenderingLayer = false;
+    nvgEndFrame(ctx);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, (GLuint) framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    mLayerDirty = false;
+}
+
+void Window::releaseLayer() {
+    mLayer.reset();
+    mLayerDirty = true;
+}
+
+void Window::drawBounds(Vector2i &min, Vector2i &max) const {
+    Vector2i ds = Vector2i::Constant(mTheme->get<int>("/window/shadow-size"));
+    min = mPos - ds;
+    max = mPos + mSize + ds;
 }
 
 void Window::draw(NVGcontext *ctx) {
     int ds = mTheme->prop("/window/shadow-size"), cr = mTheme->prop("/window/corner-radius");
     int hh = mTheme->prop("/window/header/height");
 
+    if (mLayered && mLayer && !mRenderingLayer) {
+        /* Composite the cached layer, which also contains the shadow */
+        Vector2f origin = (mPos - Vector2i::Constant(ds)).cast<float>();
+        Vector2f extent = mLayer->extent.cast<float>();
+        nvgSave(ctx);
+        nvgResetScissor(ctx);
+        nvgBeginPath(ctx);
+        nvgRect(ctx, origin.x(), origin.y(), extent.x(), extent.y());
+        nvgFillPaint(ctx, nvgImagePattern(ctx, origin.x(), origin.y(), extent.x(),
+                                          extent.y(), 0.f, mLayer->image, 1.f));
+        nvgFill(ctx);
+        nvgRestore(ctx);
+        return;
+    }
+
     /* Draw window */
     nvgSave(ctx);
     nvgBeginPath(ctx);
@@ -78,51 +185,48 @@ void Window::draw(NVGcontext *ctx) {
 
 
     /* Draw a drop shadow */
-    NVGpaint shadowPaint = nvgBoxGradient(
-        ctx, mPos.x(), mPos.y(), mSize.x(), mSize.y(), cr*2, ds*2,
-        mTheme->get<Color>("/shadow"), mTheme->get<Color>("/transparent"));
-
+    float pixelRatio = drawPixelRatio();
     nvgSave(ctx);
     nvgResetScissor(ctx);
-    nvgBeginPath(ctx);
-    nvgRect(ctx, mPos.x()-ds,mPos.y()-ds, mSize.x()+2*ds, mSize.y()+2*ds);
-    nvgRoundedRect(ctx, mPos.x(), mPos.y(), mSize.x(), mSize.y(), cr);
-    nvgPathWinding(ctx, NVG_HOLE);
-    nvgFillPaint(ctx, shadowPaint);
-    nvgFill(ctx);
+    mTheme->drawShadow(ctx, mShadowChrome, mPos, mSize, cr, ds, pixelRatio);
     nvgRestore(ctx);
 
     if (!mTitle.empty()) {
         /* Draw header */
-        NVGpaint headerPaint = nvgLinearGradient(
-            ctx, mPos.x(), mPos.y(), mPos.x(),
-            mPos.y() + hh,
-            mTheme->get<Color>("/window/header/grad-top"),
-            mTheme->get<Color>("/window/header/grad-bot"));
-
-        nvgBeginPath(ctx);
-        nvgRoundedRect(ctx, mPos.x(), mPos.y(), mSize.x(), hh, cr);
-
-        nvgFillPaint(ctx, headerPaint);
-        nvgFill(ctx);
-
-        nvgBeginPath(ctx);
-        nvgRoundedRect(ctx, mPos.x(), mPos.y(), mSize.x(), hh, cr);
-        nvgStrokeColor(ctx, mTheme->get<Color>("/window/header/sep-top"));
-
-        nvgSave(ctx);
-        nvgIntersectScissor(ctx, mPos.x(), mPos.y(), mSize.x(), 0.5f);
-        nvgStroke(ctx);
-        nvgRestore(ctx);
-
-        nvgBeginPath(ctx);
-        nvgMoveTo(ctx, mPos.x() + 0.5f, mPos.y() + hh - 1.5f);
-        nvgLineTo(ctx, mPos.x() + mSize.x() - 0.5f, mPos.y() + hh - 1.5);
-        nvgStrokeColor(ctx, mTheme->get<Color>("/window/header/sep-bot"));
-        nvgStroke(ctx);
-
-        nvgFontSize(ctx, 18.0f);
-        nvgFontFace(ctx, "sans-bold");
+        Color gradTop = mTheme->get<Color>("/window/header/grad-top");
+        Color gradBot = mTheme->get<Color>("/window/header/grad-bot");
+        Color sepTop = mTheme->get<Color>("/window/header/sep-top");
+        Color sepBot = mTheme->get<Color>("/window/header/sep-bot");
+
+        mTheme->drawChrome(ctx, mHeaderChrome, "window-header", { gradTop, gradBot, sepTop, sepBot },
+                           { (float) cr }, mPos, Vector2i(mSize.x(), hh), Vector2i(cr + 2, 0),
+                           pixelRatio,
+                           [=](NVGcontext *ctx, const Vector2i &size) {
+            NVGpaint headerPaint = nvgLinearGradient(ctx, 0, 0, 0, hh, gradTop, gradBot);
+
+            nvgBeginPath(ctx);
+            nvgRoundedRect(ctx, 0, 0, size.x(), hh, cr);
+
+            nvgFillPaint(ctx, headerPaint);
+            nvgFill(ctx);
+
+            nvgBeginPath(ctx);
+            nvgRoundedRect(ctx, 0, 0, size.x(), hh, cr);
+            nvgStrokeColor(ctx, sepTop);
+
+            nvgSave(ctx);
+            nvgIntersectScissor(ctx, 0, 0, size.x(), 0.5f);
+            nvgStroke(ctx);
+            nvgRestore(ctx);
+
+            nvgBeginPath(ctx);
+            nvgMoveTo(ctx, 0.5f, hh - 1.5f);
+            nvgLineTo(ctx, size.x() - 0.5f, hh - 1.5f);
+            nvgStrokeColor(ctx, sepBot);
+            nvgStroke(ctx);
+        });
+
+        mTheme->setFont(ctx, "sans-bold", 18.0f);
         nvgTextAlign(ctx, NVG_ALIGN_CENTER | NVG_ALIGN_MIDDLE);
 
         nvgFontBlur(ctx, 2);